@@ -0,0 +1,407 @@
+/**************************************************
+ * StarBench
+ *
+ * Times the firmware's per-sample code on Linux, and compares runs,
+ * so a change to it comes with numbers. The kernels are the
+ * firmware's own (CBench, Bench.h): StarBench links the
+ * StardustMaster_v2 sources, built for the production sensor set
+ * against the Arduino shim, fills every sensor with typical values
+ * and runs the suite. malloc, realloc and calloc are wrapped at link
+ * time (see the Makefile) to count the allocations each kernel makes.
+ *
+ * Usage:
+ *   StarBench [-o run.txt] [-t pct] [base.txt]
+ *                                 run the suite; compare with a saved run
+ *   StarBench -c capture          the results in a board's capture
+ *   StarBench -c [-t pct] base new   compare two saved runs or captures
+ *
+ * A run prints one line per kernel, as a RUN_BENCHMARKS build prints
+ * them over Serial,
+ *     BENCH,kernel,ops,ns_per_op,heap_bytes,allocs_per_op
+ * -o saves them, for the next run to compare with. allocs_per_op is
+ * blank in a board's capture, and captures from before it have no
+ * such column. In a capture the lines can be anywhere (a terminal
+ * program's timestamps in front are fine); other lines are skipped.
+ *
+ * One capture: each kernel's ns/op, and the ns/op less the Baseline
+ * kernel (the cost of the call and the timing loop).
+ *
+ * Compared: each kernel's ns/op in both and the change. A kernel
+ * more than -t percent slower (default 10), or whose heap_bytes or
+ * allocs_per_op went up, is flagged and StarBench exits with 1.
+ * Kernels in only one run are listed. Runs of different sensor sets
+ * don't compare GetLogLine for the sensors they don't share, and a
+ * board's ns/op don't compare with a Linux run's.
+ *************************************************/
+
+#include <map>
+#include <math.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "Bench.h"
+#include "MySensor.h"
+#include "SensorSet.h"
+#include "Config.h"
+
+extern CBrewmicroSD TheDisk;        // StardustMaster_v2.ino
+
+/*********************************************
+ * Allocation counting
+ * The firmware's references to malloc, realloc and calloc go to
+ * the __wrap_ functions (-Wl,--wrap). new goes through malloc.
+ */
+extern "C"
+{
+void *__real_malloc(size_t n);
+void *__real_realloc(void *p, size_t n);
+void *__real_calloc(size_t n, size_t size);
+
+void *__wrap_malloc(size_t n)
+{
+    HostShim.Allocs++;
+    return __real_malloc(n);
+}
+
+void *__wrap_realloc(void *p, size_t n)
+{
+    HostShim.Allocs++;
+    return __real_realloc(p, n);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    HostShim.Allocs++;
+    return __real_calloc(n, size);
+}
+}
+
+void *operator new(size_t n)
+{
+    void *p = malloc(n ? n : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t n)
+{
+    return operator new(n);
+}
+
+void operator delete(void *p) noexcept              { free(p); }
+void operator delete[](void *p) noexcept            { free(p); }
+void operator delete(void *p, size_t) noexcept      { free(p); }
+void operator delete[](void *p, size_t) noexcept    { free(p); }
+
+/*********************************************
+ * The sensors, ready with a fresh sample. Each channel gets a value
+ * as wide as its field (12345.67 for width 8, 2 decimals), within
+ * its rated range, so every field is formatted at its full width.
+ */
+struct SampleStep
+{
+    void operator()(CMySensor &sensor, int)
+        {
+        ChannelDesc desc;
+        for (int i = 0; i < sensor.NumChannels(); i++)
+            {
+            sensor.GetChannel(i, desc);
+            int digits = desc.Width - desc.Precision - (desc.Precision ? 1 : 0);
+            double value = 1.23456789 * pow(10.0, (digits > 1 ? digits : 1) - 1);
+            if ((desc.Min <= desc.Max) && (value > desc.Max))
+                value = desc.Max;
+            sensor.Values[i] = value;
+            }
+        sensor.SensorAvailable = true;
+        sensor.InitState = INIT_READY;
+        sensor.FreshSample = true;
+        sensor.ReadOK = true;
+        }
+};
+
+/*********************************************
+ * Results
+ */
+struct BenchResult
+{
+    unsigned long Ops;
+    unsigned long Nsec;         // per op
+    long HeapBytes;
+    double Allocs;              // per op, -1 if not counted
+};
+
+struct BenchRun
+{
+    std::string Path;
+    std::string SetName;        // from the BENCH,start line
+    std::vector<std::string> Order;     // kernels as they ran
+    std::map<std::string, BenchResult> Results;
+};
+
+static void Usage()
+{
+    fprintf(stderr, "usage: StarBench [-o run.txt] [-t pct] [base.txt]\n"
+                    "       StarBench -c capture\n"
+                    "       StarBench -c [-t pct] base new\n");
+    exit(2);
+}
+
+// Split at the commas, line end taken off
+static std::vector<std::string> SplitFields(const char *p)
+{
+    std::vector<std::string> fields;
+    std::string f;
+    for (; *p && *p != '\r' && *p != '\n'; p++)
+        {
+        if (*p == ',')
+            {
+            fields.push_back(f);
+            f.clear();
+            }
+        else
+            f += *p;
+        }
+    fields.push_back(f);
+    return fields;
+}
+
+static bool ReadRun(FILE *fp, const std::string &path, BenchRun &run)
+{
+    run.Path = path;
+    char line[512];
+    while (fgets(line, sizeof(line), fp))
+        {
+        const char *p = strstr(line, "BENCH,");
+        if (!p)
+            continue;
+        std::vector<std::string> f = SplitFields(p);
+        if (f.size() >= 3 && f[1] == "start")
+            {
+            // A second run in the same capture replaces the first
+            run.SetName = f[2];
+            run.Order.clear();
+            run.Results.clear();
+            continue;
+            }
+        if ((f.size() != 5 && f.size() != 6) || f[1] == "kernel")
+            continue;
+        char *end;
+        BenchResult r;
+        r.Ops = strtoul(f[2].c_str(), &end, 10);
+        if (*end || r.Ops == 0)
+            continue;           // cut short on the way out
+        r.Nsec = strtoul(f[3].c_str(), &end, 10);
+        if (*end)
+            continue;
+        r.HeapBytes = strtol(f[4].c_str(), &end, 10);
+        if (*end)
+            continue;
+        r.Allocs = -1.0;
+        if (f.size() == 6 && !f[5].empty())
+            {
+            r.Allocs = strtod(f[5].c_str(), &end);
+            if (*end)
+                continue;
+            }
+        if (!run.Results.count(f[1]))
+            run.Order.push_back(f[1]);
+        run.Results[f[1]] = r;
+        }
+    if (run.Results.empty())
+        {
+        fprintf(stderr, "%s: no BENCH results\n", path.c_str());
+        return false;
+        }
+    return true;
+}
+
+static bool ReadRun(const std::string &path, BenchRun &run)
+{
+    FILE *fp = fopen(path.c_str(), "r");
+    if (!fp)
+        {
+        perror(path.c_str());
+        return false;
+        }
+    bool ok = ReadRun(fp, path, run);
+    fclose(fp);
+    return ok;
+}
+
+static std::string AllocText(double allocs)
+{
+    char buf[20];
+    if (allocs < 0)
+        return "-";
+    snprintf(buf, sizeof(buf), "%.3f", allocs);
+    return buf;
+}
+
+static void Report(const BenchRun &run)
+{
+    auto base = run.Results.find("Baseline");
+    unsigned long overhead = (base != run.Results.end()) ? base->second.Nsec : 0;
+
+    printf("%s: %s\n", run.Path.c_str(), run.SetName.c_str());
+    printf("%-24s %10s %10s %10s %6s %8s\n", "kernel", "ops", "ns/op", "net ns/op", "heap", "allocs");
+    for (auto &name : run.Order)
+        {
+        const BenchResult &r = run.Results.at(name);
+        long net = (long)r.Nsec - (long)overhead;
+        printf("%-24s %10lu %10lu %10ld %6ld %8s\n", name.c_str(), r.Ops, r.Nsec,
+               (name == "Baseline") ? 0L : net, r.HeapBytes, AllocText(r.Allocs).c_str());
+        }
+}
+
+// Returns the number of regressions
+static int Compare(const BenchRun &base, const BenchRun &run, double threshold)
+{
+    int regressions = 0;
+
+    printf("base %s: %s\n", base.Path.c_str(), base.SetName.c_str());
+    printf("new  %s: %s\n", run.Path.c_str(), run.SetName.c_str());
+    printf("%-24s %10s %10s %8s %6s %8s\n", "kernel", "base ns", "new ns", "change", "heap", "allocs");
+    for (auto &name : run.Order)
+        {
+        const BenchResult &r = run.Results.at(name);
+        auto b = base.Results.find(name);
+        if (b == base.Results.end())
+            {
+            printf("%-24s %10s %10lu %8s %6ld %8s  new\n", name.c_str(), "-", r.Nsec, "", r.HeapBytes,
+                   AllocText(r.Allocs).c_str());
+            continue;
+            }
+        double change = b->second.Nsec ? 100.0 * ((double)r.Nsec - b->second.Nsec) / b->second.Nsec : 0.0;
+        const char *flag = "";
+        if (change > threshold)
+            flag = "  SLOWER";
+        else if (r.HeapBytes > b->second.HeapBytes)
+            flag = "  HEAP";
+        else if ((b->second.Allocs >= 0) && (r.Allocs > b->second.Allocs))
+            flag = "  ALLOCS";
+        if (*flag)
+            regressions++;
+        printf("%-24s %10lu %10lu %+7.1f%% %6ld %8s%s\n", name.c_str(), b->second.Nsec, r.Nsec, change,
+               r.HeapBytes, AllocText(r.Allocs).c_str(), flag);
+        }
+    for (auto &name : base.Order)
+        {
+        if (!run.Results.count(name))
+            printf("%-24s %10lu %10s %8s %6s %8s  gone\n", name.c_str(), base.Results.at(name).Nsec, "-", "", "", "");
+        }
+    return regressions;
+}
+
+// The suite on this machine; the BENCH lines, as the board prints them
+static FILE *RunSuite()
+{
+    FILE *out = tmpfile();
+    if (!out)
+        {
+        perror("tmpfile");
+        exit(2);
+        }
+    HostShim.SerialIn = NULL;
+    HostShim.SerialOut = NULL;      // the config's messages
+    MyConfig.Init(TheDisk);         // no card: the defaults
+
+    SampleStep sample;
+    ActiveSensors::ForEach(sample);
+
+    HostShim.SerialOut = out;
+    Bench.Run();
+    HostShim.SerialOut = NULL;
+    rewind(out);
+    return out;
+}
+
+static void CopyFile(FILE *from, FILE *to)
+{
+    char buf[512];
+    size_t n;
+
+    rewind(from);
+    while ((n = fread(buf, 1, sizeof(buf), from)) > 0)
+        fwrite(buf, 1, n, to);
+    rewind(from);
+}
+
+int main(int argc, char **argv)
+{
+    double threshold = 10.0;
+    bool captures = false;
+    std::string outPath;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++)
+        {
+        std::string a = argv[i];
+        if (a == "-t" && i+1 < argc)
+            threshold = atof(argv[++i]);
+        else if (a == "-o" && i+1 < argc)
+            outPath = argv[++i];
+        else if (a == "-c")
+            captures = true;
+        else if (a[0] == '-')
+            Usage();
+        else
+            paths.push_back(a);
+        }
+
+    std::vector<BenchRun> runs(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+        {
+        if (!ReadRun(paths[i], runs[i]))
+            return 2;
+        }
+
+    if (captures)
+        {
+        if (paths.empty() || paths.size() > 2 || !outPath.empty())
+            Usage();
+        if (runs.size() == 1)
+            {
+            Report(runs[0]);
+            return 0;
+            }
+        }
+    else
+        {
+        if (paths.size() > 1)
+            Usage();
+        FILE *out = RunSuite();
+        if (!outPath.empty())
+            {
+            FILE *fp = fopen(outPath.c_str(), "w");
+            if (!fp)
+                {
+                perror(outPath.c_str());
+                return 2;
+                }
+            CopyFile(out, fp);
+            fclose(fp);
+            }
+        if (runs.empty())
+            {   // no base: the results as they are
+            CopyFile(out, stdout);
+            fclose(out);
+            return 0;
+            }
+        runs.resize(2);
+        bool ok = ReadRun(out, "this run", runs[1]);
+        fclose(out);
+        if (!ok)
+            return 2;
+        }
+
+    int regressions = Compare(runs[0], runs[1], threshold);
+    if (regressions)
+        fprintf(stderr, "StarBench: %d kernels regressed (over %.1f%% slower, or more heap or allocations)\n",
+                regressions, threshold);
+    return regressions ? 1 : 0;
+}
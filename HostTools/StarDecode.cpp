@@ -0,0 +1,695 @@
+/**************************************************
+ * StarDecode
+ *
+ * Converts the "Star" data files from a flight into clean columnar
+ * output:
+ *   <out>.csv   one header line, trimmed fields, blank = missing
+ *   <out>.stc   binary columnar file (format below)
+ *
+ * Usage:
+ *   StarDecode [-o out] [-j threads] [-q mask] [-e errlog]... [--no-csv] [--no-stc] Star*.csv
+ *
+ * The data files are memory mapped and split on line boundaries;
+ * the pieces are parsed on all cores. Column names and types come
+ * from each file's header line (see CStarLayout); all files must
+ * come from the same sensor set. Rotated files are merged in order
+ * of their first timestamp.
+ *
+ * Files written with LOG_STREAMS (Timestamp,Elapsed Time,Block header)
+ * are split into one <out>_<sensor>.csv/.stc per stream, and the
+ * streams are aligned in time into <out>.csv/.stc.
+ *
+ * Error logs given with -e are merged the same way into
+ * <out>_events.csv (Timestamp,Message).
+ *
+ * Files with a Quality column (one hex digit per channel, QUAL_ flags)
+ * have the values whose digit has any flag in -q mask (hex, default
+ * 6: failed or unavailable) blanked; -q F keeps only fresh, in-range
+ * values, -q 0 keeps everything. The Quality column of the output
+ * is the flags of the whole row.
+ *
+ * Lines sealed by the firmware (see CheckStarRecord) lose their
+ * trailer; a sealed line whose CRC fails is dropped and counted as
+ * bad. StarScan salvages what it can from a damaged card.
+ *
+ * .stc format (little endian):
+ *   char[8]  "STARCOL1"
+ *   uint32   number of columns
+ *   uint64   number of rows
+ *   per column: uint8 type (EColType), uint16 name length, name
+ *   per column: rows values; int64 for COL_TIME/COL_MSEC,
+ *               float64 for COL_FLOAT, int8 for COL_FLAG/COL_QUALITY
+ *************************************************/
+
+#include "StarLog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <map>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+// LOG_STREAMS files: one stream per sensor (see StreamLog.h in the firmware)
+struct StreamDef
+{
+    std::string Name;
+    std::vector<std::string> Columns;
+};
+
+// Samples of one stream. Each row is AbsMsec, Timestamp, Sample Msec,
+// then Width values. AbsMsec (epoch msec, or Sample Msec if the RTC
+// time is unknown) is only used to align the streams.
+struct StreamRows
+{
+    size_t Width = 0;
+    size_t NumRows = 0;
+    std::vector<double> Rows;
+};
+
+// One piece of a data file, parsed by one worker
+struct Chunk
+{
+    int File;
+    size_t Begin, End;          // byte range in the mapped file
+    std::vector<double> Rows;   // NumRows * numCols values
+    size_t NumRows = 0;
+    size_t BadLines = 0;
+    size_t RowOffset = 0;       // first row in the merged output
+    bool HaveFirst = false;     // first line's Timestamp and Elapsed Time
+    int64_t FirstTime = -1;
+    double FirstMsec = 0;
+    std::map<int, StreamDef> Defs;          // stream mode only
+    std::map<int, StreamRows> Streams;
+};
+
+struct DataFile
+{
+    std::string Path;
+    CMappedFile Map;
+    CStarLayout Layout;
+    size_t BodyStart = 0;       // first byte after the header line
+    bool HaveFirst = false;     // first record seen
+    int64_t FirstTime = -1;
+    double FirstMsec = 0;
+};
+
+static void Usage()
+{
+    fprintf(stderr, "usage: StarDecode [-o out] [-j threads] [-q mask] [-e errlog]... [--no-csv] [--no-stc] datafile...\n");
+    exit(2);
+}
+
+// Run fn(i) for i in [0, n) on numThreads workers
+template <class F> static void ParallelFor(size_t n, int numThreads, F fn)
+{
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < numThreads; t++)
+        {
+        workers.emplace_back([&]()
+            {
+            size_t i;
+            while ((i = next++) < n)
+                fn(i);
+            });
+        }
+    for (auto &w : workers)
+        w.join();
+}
+
+static void ParseChunk(const DataFile &f, Chunk &c, int qualMask)
+{
+    size_t numCols = f.Layout.Columns.size();
+    const char *p = f.Map.Data + c.Begin;
+    const char *end = f.Map.Data + c.End;
+    std::vector<double> values(numCols);
+
+    while (p < end)
+        {
+        const char *nl = (const char *)memchr(p, '\n', end - p);
+        const char *lineEnd = nl ? nl : end;
+        if (lineEnd > p)
+            {
+            StarRecord rec;
+            EStarRecord state = CheckStarRecord(p, lineEnd, rec);
+            if (state == REC_BAD)
+                c.BadLines++;
+            else if (ParseStarLine(f.Layout, p, state == REC_GOOD ? rec.End : lineEnd, values.data(), qualMask))
+                {
+                if (!c.HaveFirst)
+                    {
+                    c.HaveFirst = true;
+                    c.FirstTime = (int64_t)values[0];
+                    c.FirstMsec = values[1];
+                    }
+                c.Rows.insert(c.Rows.end(), values.begin(), values.end());
+                c.NumRows++;
+                }
+            else if (strncmp(p, "Timestamp", 9) != 0)
+                c.BadLines++;       // repeated headers are fine
+            }
+        p = lineEnd + 1;
+        }
+}
+
+/****************************
+ * ParseStreamChunk
+ * 
+ * Stream mode lines, after Timestamp and Elapsed Time:
+ *   D,<stream>,<sensor name>,<column names...>
+ *   B,<stream>,<count>,<msec>,<values...>,<msec>,<values...>,...
+ */
+static void ParseStreamChunk(const DataFile &f, Chunk &c)
+{
+    const char *p = f.Map.Data + c.Begin;
+    const char *end = f.Map.Data + c.End;
+    std::vector<StarField> fields;
+
+    while (p < end)
+        {
+        const char *nl = (const char *)memchr(p, '\n', end - p);
+        const char *lineEnd = nl ? nl : end;
+        const char *next = lineEnd + 1;
+        if (lineEnd == p || strncmp(p, "Timestamp", 9) == 0)
+            {
+            p = next;
+            continue;
+            }
+        StarRecord rec;
+        EStarRecord state = CheckStarRecord(p, lineEnd, rec);
+        if (state == REC_BAD)
+            {
+            c.BadLines++;
+            p = next;
+            continue;
+            }
+        SplitStarFields(p, state == REC_GOOD ? rec.End : lineEnd, fields);
+        p = next;
+
+        bool good = false;
+        if (fields.size() >= 5 && (fields[2].second - fields[2].first) == 1)
+            {
+            int64_t ts = ParseStarTime(fields[0].first, fields[0].second);
+            double elapsed = ParseStarValue(fields[1].first, fields[1].second);
+            int stream = atoi(std::string(fields[3].first, fields[3].second).c_str());
+            char tag = *fields[2].first;
+
+            if (tag == 'D')
+                {
+                StreamDef &def = c.Defs[stream];
+                def.Name.assign(fields[4].first, fields[4].second);
+                def.Columns.clear();
+                for (size_t k = 5; k < fields.size(); k++)
+                    def.Columns.push_back(std::string(fields[k].first, fields[k].second));
+                good = true;
+                }
+            else if (tag == 'B' && !std::isnan(elapsed))
+                {
+                size_t count = atoi(std::string(fields[4].first, fields[4].second).c_str());
+                size_t rest = fields.size() - 5;
+                // The stream's entry is made only for a line that fits,
+                // so a chunk of bad lines can't leave a Width of 0
+                auto have = c.Streams.find(stream);
+                if (count > 0 && rest % count == 0 && rest / count >= 1 &&
+                    (have == c.Streams.end() || have->second.Width == rest / count - 1))
+                    {
+                    StreamRows &rows = c.Streams[stream];
+                    rows.Width = rest / count - 1;
+                    for (size_t k = 0; k < count; k++)
+                        {
+                        const StarField *rec = &fields[5 + k * (rows.Width + 1)];
+                        double msec = ParseStarValue(rec[0].first, rec[0].second);
+                        double absMsec = (ts >= 0) ? ts * 1000.0 + (msec - elapsed) : msec;
+                        rows.Rows.push_back(absMsec);
+                        rows.Rows.push_back(ts >= 0 ? floor(absMsec / 1000) : -1);
+                        rows.Rows.push_back(msec);
+                        for (size_t v = 1; v <= rows.Width; v++)
+                            rows.Rows.push_back(ParseStarValue(rec[v].first, rec[v].second));
+                        rows.NumRows++;
+                        }
+                    good = true;
+                    }
+                }
+            if (good && !c.HaveFirst)
+                {
+                c.HaveFirst = true;
+                c.FirstTime = ts;
+                c.FirstMsec = elapsed;
+                }
+            }
+        if (!good)
+            c.BadLines++;
+        }
+}
+
+static void FormatValue(char *buf, size_t len, EColType type, double v)
+{
+    if (type == COL_TIME)
+        FormatStarTime((int64_t)v, buf, len);
+    else if (type == COL_FLAG)
+        snprintf(buf, len, "%s", v > 0 ? "On" : (v == 0 ? "Off" : ""));
+    else if (type == COL_QUALITY)
+        {
+        if (v >= 0)
+            snprintf(buf, len, "%d", (int)v);
+        else
+            buf[0] = 0;
+        }
+    else if (std::isnan(v))
+        buf[0] = 0;
+    else
+        {   // shortest text that reads back as the same value
+        std::to_chars_result r = (type == COL_MSEC) ? std::to_chars(buf, buf + len - 1, (long long)v)
+                                                    : std::to_chars(buf, buf + len - 1, v, std::chars_format::fixed);
+        *r.ptr = 0;
+        }
+}
+
+static bool WriteCSV(const std::string &path, const CStarLayout &layout,
+                     const std::vector<Chunk> &chunks, int numThreads)
+{
+    FILE *fp = fopen(path.c_str(), "w");
+    if (!fp)
+        {
+        perror(path.c_str());
+        return false;
+        }
+    size_t numCols = layout.Columns.size();
+    for (size_t c = 0; c < numCols; c++)
+        fprintf(fp, "%s%s", c ? "," : "", layout.Columns[c].Name.c_str());
+    fputc('\n', fp);
+
+    // Format the chunks in parallel, write them in order
+    std::vector<std::string> text(chunks.size());
+    ParallelFor(chunks.size(), numThreads, [&](size_t i)
+        {
+        const Chunk &ch = chunks[i];
+        std::string &out = text[i];
+        char buf[40];
+        out.reserve(ch.NumRows * numCols * 10);
+        for (size_t r = 0; r < ch.NumRows; r++)
+            {
+            const double *row = &ch.Rows[r * numCols];
+            for (size_t c = 0; c < numCols; c++)
+                {
+                FormatValue(buf, sizeof(buf), layout.Columns[c].Type, row[c]);
+                if (c)
+                    out += ',';
+                out += buf;
+                }
+            out += '\n';
+            }
+        });
+    for (auto &t : text)
+        fwrite(t.data(), 1, t.size(), fp);
+    return fclose(fp) == 0;
+}
+
+static bool WriteSTC(const std::string &path, const CStarLayout &layout,
+                     const std::vector<Chunk> &chunks, size_t numRows, int numThreads)
+{
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (!fp)
+        {
+        perror(path.c_str());
+        return false;
+        }
+    uint32_t numCols = layout.Columns.size();
+    uint64_t rows = numRows;
+    fwrite("STARCOL1", 1, 8, fp);
+    fwrite(&numCols, sizeof(numCols), 1, fp);
+    fwrite(&rows, sizeof(rows), 1, fp);
+    for (auto &col : layout.Columns)
+        {
+        uint8_t type = col.Type;
+        uint16_t len = col.Name.size();
+        fwrite(&type, 1, 1, fp);
+        fwrite(&len, sizeof(len), 1, fp);
+        fwrite(col.Name.data(), 1, len, fp);
+        }
+
+    // Transpose one column at a time; the chunks fill their own slices
+    std::vector<char> colBuf;
+    for (uint32_t c = 0; c < numCols; c++)
+        {
+        EColType type = layout.Columns[c].Type;
+        size_t width = (type == COL_FLAG || type == COL_QUALITY) ? 1 : 8;
+        colBuf.resize(numRows * width);
+        ParallelFor(chunks.size(), numThreads, [&](size_t i)
+            {
+            const Chunk &ch = chunks[i];
+            char *dst = colBuf.data() + ch.RowOffset * width;
+            for (size_t r = 0; r < ch.NumRows; r++, dst += width)
+                {
+                double v = ch.Rows[r * numCols + c];
+                if (type == COL_FLOAT)
+                    memcpy(dst, &v, 8);
+                else if (type == COL_FLAG || type == COL_QUALITY)
+                    *dst = std::isnan(v) ? -1 : (int8_t)v;
+                else
+                    {
+                    int64_t iv = std::isnan(v) ? -1 : (int64_t)v;
+                    memcpy(dst, &iv, 8);
+                    }
+                }
+            });
+        fwrite(colBuf.data(), 1, colBuf.size(), fp);
+        }
+    return fclose(fp) == 0;
+}
+
+// Layout for a stream or aligned table: Timestamp, Sample Msec, columns
+static CStarLayout StreamLayout(const std::vector<std::string> &columns)
+{
+    std::string header = "Timestamp,Sample Msec";
+    for (auto &name : columns)
+        header += "," + name;
+    CStarLayout layout;
+    layout.Parse(header.data(), header.size());
+    return layout;
+}
+
+/****************************
+ * DecodeStreams
+ * 
+ * Writes each stream to <out>_<sensor>.csv/.stc, then aligns them
+ * into <out>.csv/.stc: one row per sample time of any stream, each
+ * stream showing its latest sample at or before that time.
+ */
+static bool DecodeStreams(const std::vector<Chunk> &chunks, const std::string &outBase,
+                          bool doCSV, bool doSTC, int numThreads, size_t &numRows)
+{
+    std::map<int, StreamDef> defs;
+    std::map<int, StreamRows> streams;
+    for (auto &c : chunks)
+        {
+        for (auto &d : c.Defs)
+            defs[d.first] = d.second;
+        for (auto &sr : c.Streams)
+            {
+            StreamRows &all = streams[sr.first];
+            if (all.NumRows > 0 && all.Width != sr.second.Width)
+                {   // the row stride is fixed by the first chunk
+                fprintf(stderr, "stream %d: %zu samples of width %zu skipped (expected %zu)\n",
+                        sr.first, sr.second.NumRows, sr.second.Width, all.Width);
+                continue;
+                }
+            all.Width = sr.second.Width;
+            all.NumRows += sr.second.NumRows;
+            all.Rows.insert(all.Rows.end(), sr.second.Rows.begin(), sr.second.Rows.end());
+            }
+        }
+
+    std::vector<std::string> alignedCols;
+    std::vector<const StreamRows *> order;
+    for (auto &sr : streams)
+        {
+        StreamDef &def = defs[sr.first];
+        if (def.Name.empty())
+            def.Name = "S" + std::to_string(sr.first);
+        while (def.Columns.size() < sr.second.Width)
+            def.Columns.push_back(def.Name + "_" + std::to_string(def.Columns.size() + 1));
+        def.Columns.resize(sr.second.Width);
+
+        // The stream on its own, without AbsMsec
+        size_t w = sr.second.Width + 3;
+        Chunk one;
+        one.NumRows = sr.second.NumRows;
+        for (size_t r = 0; r < one.NumRows; r++)
+            one.Rows.insert(one.Rows.end(), sr.second.Rows.begin() + r*w + 1, sr.second.Rows.begin() + (r+1)*w);
+        std::vector<Chunk> oneChunk(1);
+        oneChunk[0] = std::move(one);
+        CStarLayout layout = StreamLayout(def.Columns);
+        std::string base = outBase + "_" + def.Name;
+        if (doCSV && !WriteCSV(base + ".csv", layout, oneChunk, numThreads))
+            return false;
+        if (doSTC && !WriteSTC(base + ".stc", layout, oneChunk, oneChunk[0].NumRows, numThreads))
+            return false;
+
+        alignedCols.insert(alignedCols.end(), def.Columns.begin(), def.Columns.end());
+        order.push_back(&sr.second);
+        }
+
+    // Align: merge the streams by AbsMsec, holding each stream's last sample
+    size_t numCols = alignedCols.size() + 2;
+    std::vector<double> current(numCols, NAN);
+    std::vector<size_t> pos(order.size(), 0);
+    Chunk aligned;
+    while (true)
+        {
+        double t = INFINITY;
+        for (size_t k = 0; k < order.size(); k++)
+            {
+            if (pos[k] < order[k]->NumRows)
+                t = std::min(t, order[k]->Rows[pos[k] * (order[k]->Width + 3)]);
+            }
+        if (t == INFINITY)
+            break;
+        size_t col = 2;
+        for (size_t k = 0; k < order.size(); k++)
+            {
+            const StreamRows &sr = *order[k];
+            size_t w = sr.Width + 3;
+            while (pos[k] < sr.NumRows && sr.Rows[pos[k] * w] <= t)
+                {
+                const double *row = &sr.Rows[pos[k] * w];
+                current[0] = row[1];
+                current[1] = row[2];
+                std::copy(row + 3, row + w, current.begin() + col);
+                pos[k]++;
+                }
+            col += sr.Width;
+            }
+        aligned.Rows.insert(aligned.Rows.end(), current.begin(), current.end());
+        aligned.NumRows++;
+        }
+    numRows = aligned.NumRows;
+
+    std::vector<Chunk> alignedChunk(1);
+    alignedChunk[0] = std::move(aligned);
+    CStarLayout layout = StreamLayout(alignedCols);
+    if (doCSV && !WriteCSV(outBase + ".csv", layout, alignedChunk, numThreads))
+        return false;
+    if (doSTC && !WriteSTC(outBase + ".stc", layout, alignedChunk, numRows, numThreads))
+        return false;
+    return true;
+}
+
+// Error logs: merge lines by leading timestamp into Timestamp,Message
+static bool WriteEvents(const std::string &path, const std::vector<std::string> &logs, size_t &badLines)
+{
+    struct Event { int64_t Time; size_t Seq; std::string Msg; };
+    std::vector<Event> events;
+
+    for (auto &logPath : logs)
+        {
+        CMappedFile map;
+        std::string errMsg;
+        if (!map.Open(logPath, errMsg))
+            {
+            fprintf(stderr, "%s\n", errMsg.c_str());
+            return false;
+            }
+        const char *p = map.Data;
+        const char *end = p + map.Size;
+        while (p < end)
+            {
+            const char *nl = (const char *)memchr(p, '\n', end - p);
+            const char *lineEnd = nl ? nl : end;
+            while (lineEnd > p && lineEnd[-1] == '\r')
+                lineEnd--;
+            StarRecord rec;
+            EStarRecord state = CheckStarRecord(p, lineEnd, rec);
+            if (state == REC_GOOD)
+                lineEnd = rec.End;
+            if (state == REC_BAD)
+                badLines++;
+            else if (lineEnd > p)
+                {
+                // timestamp is the text up to the first comma, if any
+                const char *comma = (const char *)memchr(p, ',', lineEnd - p);
+                int64_t t = comma ? ParseStarTime(p, comma) : -1;
+                const char *msg = (t >= 0) ? comma + 1 : p;
+                while (msg < lineEnd && *msg == ' ')
+                    msg++;
+                events.push_back({t, events.size(), std::string(msg, lineEnd - msg)});
+                }
+            p = (nl ? nl : end) + 1;
+            }
+        }
+    // Untimed lines keep their place after the previous timed line
+    int64_t last = -1;
+    for (auto &e : events)
+        {
+        if (e.Time < 0)
+            e.Time = last;
+        last = e.Time;
+        }
+    std::stable_sort(events.begin(), events.end(),
+        [](const Event &a, const Event &b) { return a.Time < b.Time; });
+
+    FILE *fp = fopen(path.c_str(), "w");
+    if (!fp)
+        {
+        perror(path.c_str());
+        return false;
+        }
+    fprintf(fp, "Timestamp,Message\n");
+    char buf[40];
+    for (auto &e : events)
+        {
+        FormatStarTime(e.Time, buf, sizeof(buf));
+        std::string msg = e.Msg;
+        std::replace(msg.begin(), msg.end(), '"', '\'');
+        fprintf(fp, "%s,\"%s\"\n", buf, msg.c_str());
+        }
+    return fclose(fp) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string outBase = "flight";
+    std::vector<std::string> dataPaths, logPaths;
+    int numThreads = std::max(1u, std::thread::hardware_concurrency());
+    bool doCSV = true, doSTC = true;
+    int qualMask = QUAL_DEFAULT_MASK;
+
+    for (int i = 1; i < argc; i++)
+        {
+        std::string a = argv[i];
+        if (a == "-o" && i+1 < argc)
+            outBase = argv[++i];
+        else if (a == "-j" && i+1 < argc)
+            numThreads = std::max(1, atoi(argv[++i]));
+        else if (a == "-q" && i+1 < argc)
+            qualMask = (int)strtol(argv[++i], nullptr, 16);
+        else if (a == "-e" && i+1 < argc)
+            logPaths.push_back(argv[++i]);
+        else if (a == "--no-csv")
+            doCSV = false;
+        else if (a == "--no-stc")
+            doSTC = false;
+        else if (a[0] == '-')
+            Usage();
+        else
+            dataPaths.push_back(a);
+        }
+    if (dataPaths.empty() && logPaths.empty())
+        Usage();
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    // Map the files and read the headers
+    std::vector<DataFile> files(dataPaths.size());
+    size_t totalBytes = 0;
+    for (size_t i = 0; i < files.size(); i++)
+        {
+        DataFile &f = files[i];
+        std::string errMsg;
+        f.Path = dataPaths[i];
+        if (!f.Map.Open(f.Path, errMsg))
+            {
+            fprintf(stderr, "%s\n", errMsg.c_str());
+            return 1;
+            }
+        const char *nl = (const char *)memchr(f.Map.Data, '\n', f.Map.Size);
+        size_t hdrLen = nl ? nl - f.Map.Data : f.Map.Size;
+        if (!f.Layout.Parse(f.Map.Data, hdrLen))
+            {
+            fprintf(stderr, "%s: no Timestamp header line\n", f.Path.c_str());
+            return 1;
+            }
+        if (!f.Layout.SameAs(files[0].Layout))
+            {
+            fprintf(stderr, "%s: columns differ from %s (different sensor set?)\n",
+                    f.Path.c_str(), files[0].Path.c_str());
+            return 1;
+            }
+        f.BodyStart = nl ? hdrLen + 1 : f.Map.Size;
+        totalBytes += f.Map.Size;
+        }
+
+    // Split every file into pieces of roughly equal size and parse them all
+    std::vector<Chunk> chunks;
+    size_t pieceBytes = std::max((size_t)1 << 20, totalBytes / (numThreads * 4) + 1);
+    for (size_t i = 0; i < files.size(); i++)
+        {
+        DataFile &f = files[i];
+        int n = (int)((f.Map.Size - f.BodyStart) / pieceBytes) + 1;
+        std::vector<size_t> cuts = SplitLines(f.Map.Data, f.Map.Size, f.BodyStart, n);
+        for (int k = 0; k < n; k++)
+            {
+            Chunk c;
+            c.File = i;
+            c.Begin = cuts[k];
+            c.End = cuts[k+1];
+            chunks.push_back(std::move(c));
+            }
+        }
+    bool streamMode = !files.empty() && files[0].Layout.IsStreamLayout();
+    ParallelFor(chunks.size(), numThreads, [&](size_t i)
+        {
+        if (streamMode)
+            ParseStreamChunk(files[chunks[i].File], chunks[i]);
+        else
+            ParseChunk(files[chunks[i].File], chunks[i], qualMask);
+        });
+
+    // Order the files by their first record, keeping the chunks of a file together
+    size_t numCols = files.empty() ? 0 : files[0].Layout.Columns.size();
+    for (auto &c : chunks)
+        {
+        DataFile &f = files[c.File];
+        if (c.HaveFirst && !f.HaveFirst)
+            {
+            f.HaveFirst = true;
+            f.FirstTime = c.FirstTime;
+            f.FirstMsec = c.FirstMsec;
+            }
+        }
+    std::stable_sort(chunks.begin(), chunks.end(), [&](const Chunk &a, const Chunk &b)
+        {
+        const DataFile &fa = files[a.File];
+        const DataFile &fb = files[b.File];
+        int64_t ta = fa.FirstTime < 0 ? INT64_MAX : fa.FirstTime;
+        int64_t tb = fb.FirstTime < 0 ? INT64_MAX : fb.FirstTime;
+        if (ta != tb)
+            return ta < tb;
+        if (fa.FirstMsec != fb.FirstMsec)
+            return fa.FirstMsec < fb.FirstMsec;
+        return a.File < b.File;
+        });
+
+    size_t numRows = 0, badLines = 0;
+    for (auto &c : chunks)
+        {
+        c.RowOffset = numRows;
+        numRows += c.NumRows;
+        badLines += c.BadLines;
+        }
+
+    if (streamMode)
+        {
+        if (!DecodeStreams(chunks, outBase, doCSV, doSTC, numThreads, numRows))
+            return 1;
+        }
+    else if (!files.empty())
+        {
+        if (doCSV && !WriteCSV(outBase + ".csv", files[0].Layout, chunks, numThreads))
+            return 1;
+        if (doSTC && !WriteSTC(outBase + ".stc", files[0].Layout, chunks, numRows, numThreads))
+            return 1;
+        }
+    if (!logPaths.empty() && !WriteEvents(outBase + "_events.csv", logPaths, badLines))
+        return 1;
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    fprintf(stderr, "StarDecode: %zu files, %zu columns, %zu rows, %zu bad lines, %.1f MB in %.3f s (%d threads)\n",
+            files.size(), numCols, numRows, badLines, totalBytes / 1e6, secs, numThreads);
+    return 0;
+}
@@ -0,0 +1,418 @@
+/**************************************************
+ * StarLog
+ *
+ * Implementation of the host-side data file helpers.
+ * See StarLog.h
+ *************************************************/
+
+#include "StarLog.h"
+
+#include <charconv>
+#include <cmath>
+#include <ctime>
+#include <map>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**************************************
+ * CMappedFile
+ **************************************/
+CMappedFile::CMappedFile()
+{
+    Data = nullptr;
+    Size = 0;
+    Fd = -1;
+}
+
+CMappedFile::~CMappedFile()
+{
+    if (Data && Size)
+        munmap((void *)Data, Size);
+    if (Fd >= 0)
+        close(Fd);
+}
+
+bool CMappedFile::Open(const std::string &path, std::string &errMsg)
+{
+    Fd = open(path.c_str(), O_RDONLY);
+    if (Fd < 0)
+        {
+        errMsg = path + ": " + strerror(errno);
+        return false;
+        }
+    struct stat st;
+    if (fstat(Fd, &st) != 0)
+        {
+        errMsg = path + ": " + strerror(errno);
+        return false;
+        }
+    Size = st.st_size;
+    if (Size == 0)
+        return true;    // empty file, nothing to map
+
+    void *p = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, Fd, 0);
+    if (p == MAP_FAILED)
+        {
+        errMsg = path + ": mmap failed: " + strerror(errno);
+        Size = 0;
+        return false;
+        }
+    madvise(p, Size, MADV_SEQUENTIAL);
+    Data = (const char *)p;
+    return true;
+}
+
+/**************************************
+ * CStarLayout
+ **************************************/
+static void Trim(const char *&p, const char *&end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+        end--;
+}
+
+bool CStarLayout::Parse(const char *line, size_t len)
+{
+    const char *end = line + len;
+    std::map<std::string, int> seen;
+
+    Columns.clear();
+    while (line <= end)
+        {
+        const char *comma = (const char *)memchr(line, ',', end - line);
+        const char *fieldEnd = comma ? comma : end;
+        const char *p = line;
+        Trim(p, fieldEnd);
+
+        StarColumn col;
+        col.Name.assign(p, fieldEnd - p);
+        int n = ++seen[col.Name];
+        if (n > 1)
+            col.Name += "_" + std::to_string(n);
+
+        if (Columns.size() == 0)
+            col.Type = COL_TIME;            // Timestamp
+        else if (Columns.size() == 1)
+            col.Type = COL_MSEC;            // Elapsed Time
+        else if (strncmp(p, "HeaterOn", 8) == 0)
+            col.Type = COL_FLAG;            // On/Off text from the temperature sensors
+        else if (!comma && col.Name == "Quality")
+            col.Type = COL_QUALITY;         // per channel digits, always last
+        else
+            col.Type = COL_FLOAT;
+        Columns.push_back(col);
+
+        if (!comma)
+            break;
+        line = comma + 1;
+        }
+    QualityCol = (Columns.back().Type == COL_QUALITY) ? (int)Columns.size() - 1 : -1;
+    return (Columns.size() > 2) && (Columns[0].Name == "Timestamp");
+}
+
+bool CStarLayout::SameAs(const CStarLayout &other) const
+{
+    if (Columns.size() != other.Columns.size())
+        return false;
+    for (size_t i = 0; i < Columns.size(); i++)
+        {
+        if (Columns[i].Name != other.Columns[i].Name)
+            return false;
+        }
+    return true;
+}
+
+bool CStarLayout::IsStreamLayout() const
+{
+    return (Columns.size() == 3) && (Columns[2].Name == "Block");
+}
+
+/**************************************
+ * Timestamps
+ * 
+ * The timestamp text comes from the RTC through CLogger. Accept
+ * any six numbers in Y M D h m s or M D Y h m s order.
+ **************************************/
+int64_t ParseStarTime(const char *p, const char *end)
+{
+    int num[6];
+    int n = 0;
+
+    while (p < end && n < 6)
+        {
+        if (*p >= '0' && *p <= '9')
+            {
+            int v = 0;
+            while (p < end && *p >= '0' && *p <= '9')
+                v = v*10 + (*p++ - '0');
+            num[n++] = v;
+            }
+        else
+            p++;
+        }
+    if (n < 6)
+        return -1;
+
+    int year, mon, day;
+    if (num[0] > 31)
+        {   // Y M D
+        year = num[0]; mon = num[1]; day = num[2];
+        }
+    else
+        {   // M D Y
+        mon = num[0]; day = num[1]; year = num[2];
+        }
+    if (year < 100)
+        year += 2000;
+    if (mon < 1 || mon > 12 || day < 1 || day > 31)
+        return -1;
+
+    // Days since 1970-01-01 (civil calendar, no time zone lookup)
+    year -= (mon <= 2);
+    int era = year / 400;
+    int yoe = year - era * 400;
+    int doy = (153 * (mon + (mon > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe/4 - yoe/100 + doy;
+    int64_t days = (int64_t)era * 146097 + doe - 719468;
+    return days * 86400 + num[3] * 3600 + num[4] * 60 + num[5];
+}
+
+void FormatStarTime(int64_t t, char *buf, size_t len)
+{
+    if (t < 0)
+        {
+        buf[0] = 0;
+        return;
+        }
+    time_t tt = (time_t)t;
+    struct tm tmv;
+    gmtime_r(&tt, &tmv);
+    strftime(buf, len, "%Y-%m-%d %H:%M:%S", &tmv);
+}
+
+/**************************************
+ * ParseStarLine
+ **************************************/
+static int QualityDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+bool ParseStarLine(const CStarLayout &layout, const char *line, const char *end, double *values,
+                   int qualMask)
+{
+    size_t numCols = layout.Columns.size();
+    size_t col = 0;
+    const char *qual = nullptr, *qualEnd = nullptr;
+
+    while (true)
+        {
+        const char *comma = (const char *)memchr(line, ',', end - line);
+        const char *fieldEnd = comma ? comma : end;
+        if (col >= numCols)
+            return false;       // too many fields
+
+        const char *p = line;
+        Trim(p, fieldEnd);
+        double v = NAN;
+        switch (layout.Columns[col].Type)
+            {
+            case COL_TIME:
+                v = (double)ParseStarTime(p, fieldEnd);
+                break;
+            case COL_FLAG:
+                if (fieldEnd - p >= 2 && p[0] == 'O')
+                    v = (p[1] == 'n') ? 1 : 0;
+                else
+                    v = -1;
+                break;
+            case COL_QUALITY:
+                qual = p;
+                qualEnd = fieldEnd;
+                break;
+            default:
+                if (p < fieldEnd)
+                    {
+                    if (*p == '+')
+                        p++;
+                    std::from_chars_result r = std::from_chars(p, fieldEnd, v);
+                    if (r.ec != std::errc())
+                        v = NAN;
+                    }
+                if (layout.Columns[col].Type == COL_MSEC && std::isnan(v))
+                    return false;       // no Elapsed Time: not a data line
+                break;
+            }
+        values[col++] = v;
+
+        if (!comma)
+            break;
+        line = comma + 1;
+        }
+    if (col != numCols)
+        return false;
+
+    if (qual)
+        {   // digit k is channel k, the column after Timestamp and Elapsed Time
+        int rowFlags = 0;
+        size_t numChannels = layout.QualityCol - 2;
+        if ((size_t)(qualEnd - qual) != numChannels)
+            return false;
+        for (size_t k = 0; k < numChannels; k++)
+            {
+            int q = QualityDigit(qual[k]);
+            if (q < 0)
+                return false;
+            rowFlags |= q;
+            if (q & qualMask)
+                values[k + 2] = (layout.Columns[k + 2].Type == COL_FLAG) ? -1 : NAN;
+            }
+        values[layout.QualityCol] = rowFlags;
+        }
+    return true;
+}
+
+void SplitStarFields(const char *p, const char *end, std::vector<StarField> &fields)
+{
+    fields.clear();
+    while (true)
+        {
+        const char *comma = (const char *)memchr(p, ',', end - p);
+        const char *fieldEnd = comma ? comma : end;
+        const char *b = p;
+        Trim(b, fieldEnd);
+        fields.push_back(StarField(b, fieldEnd));
+        if (!comma)
+            break;
+        p = comma + 1;
+        }
+}
+
+double ParseStarValue(const char *p, const char *end)
+{
+    double v = NAN;
+    if (p >= end)
+        return v;
+    if (end - p >= 2 && p[0] == 'O')
+        return (p[1] == 'n') ? 1 : 0;       // HeaterOn flag
+    if (*p == '+')
+        p++;
+    std::from_chars_result r = std::from_chars(p, end, v);
+    if (r.ec != std::errc())
+        v = NAN;
+    return v;
+}
+
+/**************************************
+ * Record trailers
+ **************************************/
+struct CrcTable
+{
+    uint16_t Entry[256];
+
+    constexpr CrcTable() : Entry()
+        {
+        for (int i = 0; i < 256; i++)
+            {
+            uint16_t c = i << 8;
+            for (int k = 0; k < 8; k++)
+                c = (c & 0x8000) ? (c << 1) ^ 0x1021 : (c << 1);
+            Entry[i] = c;
+            }
+        }
+};
+static constexpr CrcTable Crc;
+
+uint16_t StarCrc16(const char *p, size_t len, uint16_t crc)
+{
+    while (len-- > 0)
+        crc = (crc << 8) ^ Crc.Entry[(uint8_t)((crc >> 8) ^ *p++)];
+    return crc;
+}
+
+static int HexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// Digits ending just before p, back to no further than begin
+static bool NumberBefore(const char *begin, const char *&p, uint64_t &v)
+{
+    const char *q = p;
+    while (q > begin && q[-1] >= '0' && q[-1] <= '9' && p - q < 10)
+        q--;
+    if (q == p)
+        return false;
+    v = 0;
+    for (const char *d = q; d < p; d++)
+        v = v*10 + (*d - '0');
+    p = q;
+    return true;
+}
+
+EStarRecord CheckStarRecord(const char *p, const char *end, StarRecord &rec)
+{
+    while (end > p && end[-1] == '\r')
+        end--;
+    if (end - p < 12 || end[-5] != '*')
+        return REC_UNSEALED;
+    int crc = 0;
+    for (const char *h = end - 4; h < end; h++)
+        {
+        int d = HexDigit(*h);
+        if (d < 0)
+            return REC_UNSEALED;
+        crc = (crc << 4) | d;
+        }
+
+    // Walk back over ,#K<seq>:<len>
+    const char *star = end - 5;
+    const char *t = star;
+    uint64_t len, seq;
+    if (!NumberBefore(p, t, len) || t - p < 5 || *--t != ':')
+        return REC_UNSEALED;
+    if (!NumberBefore(p, t, seq) || t - p < 3)
+        return REC_UNSEALED;
+    rec.Kind = *--t;
+    if ((rec.Kind != 'D' && rec.Kind != 'E') || *--t != '#' || *--t != ',')
+        return REC_UNSEALED;
+
+    rec.Seq = (uint32_t)seq;
+    rec.End = t;
+    if (len > (uint64_t)(t - p))
+        return REC_BAD;             // the front of the record is gone
+    rec.Begin = t - len;
+    if (StarCrc16(rec.Begin, star - rec.Begin) != crc)
+        return REC_BAD;
+    return REC_GOOD;
+}
+
+std::vector<size_t> SplitLines(const char *data, size_t size, size_t start, int n)
+{
+    std::vector<size_t> cuts;
+    cuts.push_back(start);
+    for (int i = 1; i < n; i++)
+        {
+        size_t pos = start + (size - start) * i / n;
+        if (pos < cuts.back())
+            pos = cuts.back();
+        const char *nl = (const char *)memchr(data + pos, '\n', size - pos);
+        pos = nl ? (nl - data) + 1 : size;
+        cuts.push_back(pos);
+        }
+    cuts.push_back(size);
+    return cuts;
+}
@@ -0,0 +1,143 @@
+#ifndef STARLOG_H
+#define STARLOG_H
+
+/**************************************************
+ * StarLog
+ *
+ * Host-side helpers for reading the Stardust data files:
+ * memory mapped input, the column layout rebuilt from the csv
+ * header written by WriteCSVHeader, and a record parser for the
+ * space padded fields written by the GetLogLine functions.
+ *
+ * Shared by the host tools in this directory. Plain C++17 + POSIX.
+ *************************************************/
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*********************************************
+ * CMappedFile
+ *
+ * Read-only memory map of a whole file.
+ */
+class CMappedFile
+{
+public:
+    CMappedFile();
+    ~CMappedFile();
+    CMappedFile(const CMappedFile &) = delete;
+    CMappedFile &operator=(const CMappedFile &) = delete;
+
+    bool Open(const std::string &path, std::string &errMsg);
+
+    const char *Data;
+    size_t Size;
+
+private:
+    int Fd;
+};
+
+// Column storage types, also used as the type codes of the .stc format
+enum EColType
+{
+    COL_TIME  = 1,      // int64 epoch seconds, -1 if unknown
+    COL_MSEC  = 2,      // int64 elapsed msec
+    COL_FLOAT = 3,      // float64, NaN if blank
+    COL_FLAG  = 4,      // int8 On=1 Off=0 blank=-1
+    COL_QUALITY = 5     // int8 QUAL_ flags of the whole row, -1 if none
+};
+
+// Sample quality flags, one hex digit per channel in the Quality
+// column (QUAL_ in the firmware's MySensor.h)
+#define QUAL_STALE          0x1
+#define QUAL_FAILED         0x2
+#define QUAL_UNAVAILABLE    0x4
+#define QUAL_RANGE          0x8
+#define QUAL_DEFAULT_MASK   (QUAL_FAILED | QUAL_UNAVAILABLE)
+
+struct StarColumn
+{
+    std::string Name;
+    EColType Type;
+};
+
+/*********************************************
+ * CStarLayout
+ *
+ * Column names and types rebuilt from a header line like
+ *   Timestamp,      Elapsed Time,Altitude,  Latitude, ...
+ * Names are trimmed. Repeated names (two sensors of the same
+ * class) get a _2, _3 ... suffix. A last column named Quality holds
+ * the per channel quality digits.
+ */
+class CStarLayout
+{
+public:
+    bool Parse(const char *line, size_t len);
+    bool SameAs(const CStarLayout &other) const;
+    bool IsStreamLayout() const;    // LOG_STREAMS file: Timestamp,Elapsed Time,Block
+
+    std::vector<StarColumn> Columns;
+    int QualityCol = -1;            // -1 if the file has no Quality column
+};
+
+/*********************************************
+ * Parsing helpers
+ */
+int64_t ParseStarTime(const char *p, const char *end);      // -1 if not a timestamp
+void FormatStarTime(int64_t t, char *buf, size_t len);      // YYYY-MM-DD HH:MM:SS
+
+// Parse one data line into values[0..numCols), every column as a
+// double: COL_TIME/COL_MSEC as integers, COL_FLAG as 1/0/-1 and
+// blank COL_FLOAT fields as NaN. A channel whose quality digit has
+// any of the qualMask flags is blanked too; the Quality column gets
+// the flags of the whole row. Returns false if the field count
+// doesn't match the layout.
+bool ParseStarLine(const CStarLayout &layout, const char *p, const char *end, double *values,
+                   int qualMask = QUAL_DEFAULT_MASK);
+
+// Split a line at the commas into trimmed [begin, end) fields
+typedef std::pair<const char *, const char *> StarField;
+void SplitStarFields(const char *p, const char *end, std::vector<StarField> &fields);
+
+// Number, On/Off flag (1/0), or NaN if blank or not a number
+double ParseStarValue(const char *p, const char *end);
+
+/*********************************************
+ * Record trailers
+ *
+ * The firmware seals each data and event line (RecordCrc.h):
+ *     <record>,#D<seq>:<len>*<crc>
+ * <len> is the length of <record>, <crc> the CRC-16/CCITT (poly
+ * 0x1021, init 0xFFFF) of <record> and the trailer up to the '*'.
+ * Lines from older firmware have no trailer.
+ */
+enum EStarRecord
+{
+    REC_UNSEALED,       // no trailer: header, older firmware, or trailer lost
+    REC_GOOD,           // trailer and CRC check
+    REC_BAD             // trailer found, record damaged
+};
+
+struct StarRecord
+{
+    char Kind;                  // 'D' data or 'E' event
+    uint32_t Seq;               // counts from 1 at each boot
+    const char *Begin;          // <record> (CLogger's prefix not included)
+    const char *End;            // the comma before the trailer
+};
+
+uint16_t StarCrc16(const char *p, size_t len, uint16_t crc = 0xFFFF);
+
+// Check the trailer of the line [p, end); a trailing \r is allowed.
+// Bytes before the record (CLogger's timestamp, or garbage) are not
+// covered.
+EStarRecord CheckStarRecord(const char *p, const char *end, StarRecord &rec);
+
+// Split [data, data+size) into about n pieces on line boundaries.
+// Returns n+1 offsets, first 0 and last size.
+std::vector<size_t> SplitLines(const char *data, size_t size, size_t start, int n);
+
+#endif
@@ -0,0 +1,99 @@
+/**************************************************
+ * StarReplay
+ *
+ * Replays a logged flight through the firmware on Linux: the
+ * StardustMaster_v2 sources built with REPLAY_SENSORS against the
+ * Arduino shim (shim/Arduino.h). The "Star" data file goes in as
+ * the board's Serial input, and setup() and loop() run until it is
+ * used up, with no sleeps, so a flight replays in seconds. See
+ * FlightReplay.h in the firmware for the stand-in sensors.
+ *
+ * Usage:
+ *   StarReplay [-o out.csv] [-e events.txt] [-v] flight.csv
+ *
+ *   -o   the data file the firmware writes (csv header and sealed
+ *        records, Timestamp and Elapsed Time in front as CLogger
+ *        writes them)
+ *   -e   the error/event log: units, fix found/lost, flight phase
+ *        changes, GPS aiding, the replay summary
+ *   -v   the firmware's Serial output on stderr
+ *
+ * Without -o or -e, that output is dropped. The RTC is fixed at
+ * the shim's time and the EEPROM starts blank.
+ *************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "FlightReplay.h"
+
+void setup();
+void loop();
+
+static void Usage()
+{
+    fprintf(stderr, "usage: StarReplay [-o out.csv] [-e events.txt] [-v] flight.csv\n");
+    exit(2);
+}
+
+static FILE *OpenOut(const std::string &path)
+{
+    FILE *fp = fopen(path.c_str(), "w");
+    if (!fp)
+        {
+        perror(path.c_str());
+        exit(2);
+        }
+    return fp;
+}
+
+int main(int argc, char **argv)
+{
+    std::string inPath, outPath, eventPath;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++)
+        {
+        std::string a = argv[i];
+        if (a == "-o" && i+1 < argc)
+            outPath = argv[++i];
+        else if (a == "-e" && i+1 < argc)
+            eventPath = argv[++i];
+        else if (a == "-v")
+            verbose = true;
+        else if (a[0] == '-' || !inPath.empty())
+            Usage();
+        else
+            inPath = a;
+        }
+    if (inPath.empty())
+        Usage();
+
+    HostShim.SerialIn = fopen(inPath.c_str(), "r");
+    if (!HostShim.SerialIn)
+        {
+        perror(inPath.c_str());
+        return 2;
+        }
+    HostShim.SerialOut = verbose ? stderr : NULL;
+    if (!outPath.empty())
+        HostShim.DataFile = OpenOut(outPath);
+    if (!eventPath.empty())
+        HostShim.EventFile = OpenOut(eventPath);
+
+    setup();
+    do
+        loop();
+    while (!FlightReplay.Finished && !feof(HostShim.SerialIn));
+
+    if (HostShim.DataFile)
+        fclose(HostShim.DataFile);
+    if (HostShim.EventFile)
+        fclose(HostShim.EventFile);
+    fclose(HostShim.SerialIn);
+    printf("%s: %ld records, %lu data lines written\n", inPath.c_str(),
+           FlightReplay.RecordCount, HostShim.DataLines);
+    return FlightReplay.RecordCount ? 0 : 1;
+}
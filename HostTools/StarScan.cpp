@@ -0,0 +1,372 @@
+/**************************************************
+ * StarScan
+ *
+ * Salvages the records from a damaged SD card: a raw card image
+ * (dd if=/dev/sdX) or a data or error log file that was cut short
+ * or scrambled. Every line the firmware sealed carries its own
+ * length, sequence number and CRC (see CheckStarRecord), so the
+ * scan needs no file system: it reads the lines, keeps each record
+ * whose CRC checks, and picks up again at the next good record
+ * after any damage.
+ *
+ * Usage:
+ *   StarScan [-o out] [-j threads] [-v] image...
+ *
+ * Writes
+ *   <out>_data.csv     the data records, with their csv header lines
+ *   <out>_events.csv   the error log records
+ * both with the trailers taken off, in the order they were found.
+ * <out>_data.csv reads straight into StarDecode.
+ *
+ * Reports to stderr the records kept and damaged, the damaged byte
+ * ranges, and for each kind the missing sequence numbers and the
+ * restarts (a new boot, or the next file in the image). With -v
+ * every range is listed, not just the first few.
+ *
+ * The images are memory mapped and split on line boundaries; the
+ * pieces are scanned on all cores.
+ *************************************************/
+
+#include "StarLog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#define MAX_LISTED  20      // ranges listed without -v
+
+// A line kept: a sealed record, or a csv header
+struct Kept
+{
+    char Kind;                  // 'D', 'E', or 'H' for a header
+    uint32_t Seq;
+    size_t Offset;              // of the line in the image
+    const char *Begin, *End;    // text to write, trailer taken off
+};
+
+// A run of damaged lines
+struct Damage
+{
+    size_t Begin, End;          // byte range in the image
+};
+
+// One piece of an image, scanned by one worker
+struct Piece
+{
+    int File;
+    size_t Begin, End;
+    std::vector<Kept> Lines;
+    std::vector<Damage> Damaged;
+    size_t Good = 0, Bad = 0, Unsealed = 0;
+};
+
+struct Image
+{
+    std::string Path;
+    CMappedFile Map;
+};
+
+static void Usage()
+{
+    fprintf(stderr, "usage: StarScan [-o out] [-j threads] [-v] image...\n");
+    exit(2);
+}
+
+// Run fn(i) for i in [0, n) on numThreads workers
+template <class F> static void ParallelFor(size_t n, int numThreads, F fn)
+{
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < numThreads; t++)
+        {
+        workers.emplace_back([&]()
+            {
+            size_t i;
+            while ((i = next++) < n)
+                fn(i);
+            });
+        }
+    for (auto &w : workers)
+        w.join();
+}
+
+// Erased flash, unused clusters and padding are not damage
+static bool IsBlank(const char *p, const char *end)
+{
+    for (; p < end; p++)
+        {
+        if (*p != 0 && *p != (char)0xFF && *p != ' ' && *p != '\r')
+            return false;
+        }
+    return true;
+}
+
+/****************************
+ * LineStart
+ *
+ * Where the salvaged line starts: the fields CLogger puts in front
+ * of the record (timestamp and elapsed time for data, timestamp for
+ * events), if they are there. Garbage in front of them, the end of a
+ * record cut short by a reset, is dropped.
+ */
+static const char *LineStart(const char *line, const StarRecord &rec)
+{
+    int fields = (rec.Kind == 'D') ? 2 : 1;
+    const char *p = rec.Begin;
+    if (p > line && p[-1] == ',')
+        p--;
+    for (int k = 0; k < fields; k++)
+        {
+        const char *comma = p;
+        while (comma > line && comma[-1] != ',')
+            comma--;
+        if (k == fields - 1)
+            {
+            // The first field must read as a timestamp
+            return (ParseStarTime(comma, p) >= 0) ? comma : rec.Begin;
+            }
+        if (comma == line)
+            return rec.Begin;
+        p = comma - 1;
+        }
+    return rec.Begin;
+}
+
+static void ScanPiece(const Image &img, Piece &pc)
+{
+    const char *data = img.Map.Data;
+    const char *p = data + pc.Begin;
+    const char *end = data + pc.End;
+    Damage run = {0, 0};
+
+    while (p < end)
+        {
+        const char *nl = (const char *)memchr(p, '\n', end - p);
+        const char *lineEnd = nl ? nl : end;
+        const char *next = lineEnd + 1;
+        bool damaged = false;
+
+        // A file starts a new cluster: skip the unused end of the last one
+        while (p < lineEnd && (*p == 0 || *p == (char)0xFF))
+            p++;
+
+        StarRecord rec;
+        EStarRecord state = CheckStarRecord(p, lineEnd, rec);
+        if (state == REC_GOOD)
+            {
+            pc.Lines.push_back({rec.Kind, rec.Seq, (size_t)(p - data), LineStart(p, rec), rec.End});
+            pc.Good++;
+            }
+        else if (state == REC_BAD)
+            {
+            damaged = true;
+            pc.Bad++;
+            }
+        else if (strncmp(p, "Timestamp", 9) == 0)
+            {
+            const char *e = lineEnd;
+            while (e > p && e[-1] == '\r')
+                e--;
+            pc.Lines.push_back({'H', 0, (size_t)(p - data), p, e});
+            }
+        else if (!IsBlank(p, lineEnd))
+            {
+            damaged = true;
+            pc.Unsealed++;
+            }
+
+        if (damaged)
+            {
+            if (run.End != (size_t)(p - data))
+                {
+                if (run.End > run.Begin)
+                    pc.Damaged.push_back(run);
+                run.Begin = p - data;
+                }
+            run.End = std::min(next, end) - data;
+            }
+        p = next;
+        }
+    if (run.End > run.Begin)
+        pc.Damaged.push_back(run);
+}
+
+// Missing sequence numbers and restarts of one kind of record, in image order
+static void ReportSequence(const std::vector<Piece> &pieces, const std::vector<Image> &images,
+                           char kind, const char *name, bool verbose)
+{
+    uint32_t last = 0;
+    size_t records = 0, missing = 0, gaps = 0, restarts = 0;
+    int lastFile = -1;
+
+    for (auto &pc : pieces)
+        {
+        for (auto &k : pc.Lines)
+            {
+            if (k.Kind != kind)
+                continue;
+            if (pc.File != lastFile)
+                last = 0;       // each image counts on its own
+            lastFile = pc.File;
+            records++;
+            if (last && k.Seq > last + 1)
+                {
+                gaps++;
+                missing += k.Seq - last - 1;
+                if (verbose || gaps <= MAX_LISTED)
+                    fprintf(stderr, "  %s: %s missing %u-%u (before byte %zu)\n", images[pc.File].Path.c_str(),
+                            name, last + 1, k.Seq - 1, k.Offset);
+                }
+            else if (last && k.Seq <= last)
+                {
+                restarts++;
+                if (verbose || restarts <= MAX_LISTED)
+                    fprintf(stderr, "  %s: %s restart %u -> %u at byte %zu\n", images[pc.File].Path.c_str(),
+                            name, last, k.Seq, k.Offset);
+                }
+            last = k.Seq;
+            }
+        }
+    fprintf(stderr, "StarScan: %zu %s records, %zu missing in %zu gaps, %zu restarts\n",
+            records, name, missing, gaps, restarts);
+}
+
+static bool WriteKept(const std::string &path, const std::vector<Piece> &pieces, bool data)
+{
+    FILE *fp = fopen(path.c_str(), "w");
+    if (!fp)
+        {
+        perror(path.c_str());
+        return false;
+        }
+    const Kept *header = nullptr;
+    for (auto &pc : pieces)
+        {
+        for (auto &k : pc.Lines)
+            {
+            if (k.Kind == 'H')
+                {
+                // Write a header once, and again only if the columns change
+                if (!data || (header && (header->End - header->Begin) == (k.End - k.Begin) &&
+                              memcmp(header->Begin, k.Begin, k.End - k.Begin) == 0))
+                    continue;
+                header = &k;
+                }
+            else if (k.Kind != (data ? 'D' : 'E'))
+                continue;
+            fwrite(k.Begin, 1, k.End - k.Begin, fp);
+            fputc('\n', fp);
+            }
+        }
+    return fclose(fp) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string outBase = "salvage";
+    std::vector<std::string> paths;
+    int numThreads = std::max(1u, std::thread::hardware_concurrency());
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++)
+        {
+        std::string a = argv[i];
+        if (a == "-o" && i+1 < argc)
+            outBase = argv[++i];
+        else if (a == "-j" && i+1 < argc)
+            numThreads = std::max(1, atoi(argv[++i]));
+        else if (a == "-v")
+            verbose = true;
+        else if (a[0] == '-')
+            Usage();
+        else
+            paths.push_back(a);
+        }
+    if (paths.empty())
+        Usage();
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    std::vector<Image> images(paths.size());
+    size_t totalBytes = 0;
+    for (size_t i = 0; i < images.size(); i++)
+        {
+        std::string errMsg;
+        images[i].Path = paths[i];
+        if (!images[i].Map.Open(paths[i], errMsg))
+            {
+            fprintf(stderr, "%s\n", errMsg.c_str());
+            return 1;
+            }
+        totalBytes += images[i].Map.Size;
+        }
+
+    // Pieces of about equal size, scanned in parallel and kept in image order
+    std::vector<Piece> pieces;
+    size_t pieceBytes = std::max((size_t)1 << 20, totalBytes / (numThreads * 4) + 1);
+    for (size_t i = 0; i < images.size(); i++)
+        {
+        const CMappedFile &map = images[i].Map;
+        int n = (int)(map.Size / pieceBytes) + 1;
+        std::vector<size_t> cuts = SplitLines(map.Data, map.Size, 0, n);
+        for (int k = 0; k < n; k++)
+            {
+            Piece pc;
+            pc.File = i;
+            pc.Begin = cuts[k];
+            pc.End = cuts[k+1];
+            pieces.push_back(std::move(pc));
+            }
+        }
+    ParallelFor(pieces.size(), numThreads, [&](size_t i)
+        {
+        ScanPiece(images[pieces[i].File], pieces[i]);
+        });
+
+    // Damaged ranges, joined across the piece boundaries
+    size_t good = 0, bad = 0, unsealed = 0;
+    std::vector<std::pair<int, Damage>> damaged;
+    for (auto &pc : pieces)
+        {
+        good += pc.Good;
+        bad += pc.Bad;
+        unsealed += pc.Unsealed;
+        for (auto &d : pc.Damaged)
+            {
+            if (!damaged.empty() && damaged.back().first == pc.File && damaged.back().second.End == d.Begin)
+                damaged.back().second.End = d.End;
+            else
+                damaged.push_back({pc.File, d});
+            }
+        }
+    size_t damagedBytes = 0;
+    for (size_t i = 0; i < damaged.size(); i++)
+        {
+        const Damage &d = damaged[i].second;
+        damagedBytes += d.End - d.Begin;
+        if (verbose || i < MAX_LISTED)
+            fprintf(stderr, "  %s: damaged bytes %zu-%zu (%zu)\n", images[damaged[i].first].Path.c_str(),
+                    d.Begin, d.End, d.End - d.Begin);
+        }
+    if (!verbose && damaged.size() > MAX_LISTED)
+        fprintf(stderr, "  ... %zu more damaged ranges (-v lists them all)\n", damaged.size() - MAX_LISTED);
+
+    ReportSequence(pieces, images, 'D', "data", verbose);
+    ReportSequence(pieces, images, 'E', "event", verbose);
+
+    if (!WriteKept(outBase + "_data.csv", pieces, true))
+        return 1;
+    if (!WriteKept(outBase + "_events.csv", pieces, false))
+        return 1;
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    fprintf(stderr, "StarScan: %zu records kept, %zu damaged, %zu unsealed lines, %zu damaged ranges (%zu bytes), "
+                    "%.1f MB in %.3f s, %.0f MB/s (%d threads)\n",
+            good, bad, unsealed, damaged.size(), damagedBytes, totalBytes / 1e6, secs,
+            secs > 0 ? totalBytes / 1e6 / secs : 0.0, numThreads);
+    return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef ADAFRUIT_BMP3XX_H
+#define ADAFRUIT_BMP3XX_H
+
+// Stand-in: no BMP388 on the bus
+#include <Wire.h>
+
+#define BMP3_OVERSAMPLING_2X    1
+#define BMP3_OVERSAMPLING_4X    2
+#define BMP3_OVERSAMPLING_8X    3
+#define BMP3_IIR_FILTER_COEFF_3 2
+#define BMP3_ODR_50_HZ          2
+
+class Adafruit_BMP3XX
+{
+public:
+    bool begin_I2C(uint8_t = 0x77, TwoWire * = &Wire)   { return(false); }
+    bool setTemperatureOversampling(uint8_t)    { return(false); }
+    bool setPressureOversampling(uint8_t)       { return(false); }
+    bool setIIRFilterCoeff(uint8_t)             { return(false); }
+    bool setOutputDataRate(uint8_t)             { return(false); }
+    bool performReading()                       { return(false); }
+    float readAltitude(float)                   { return(0); }
+    double pressure = 0, temperature = 0;
+};
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef ADAFRUIT_GPS_H
+#define ADAFRUIT_GPS_H
+
+// Nothing the firmware uses
+
+#endif
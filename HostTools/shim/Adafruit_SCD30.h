@@ -0,0 +1,18 @@
+#ifndef ADAFRUIT_SCD30_H
+#define ADAFRUIT_SCD30_H
+
+// Stand-in: no SCD30 on the bus
+#include <Wire.h>
+
+class Adafruit_SCD30
+{
+public:
+    bool begin(uint8_t = 0x61, TwoWire * = &Wire, int32_t = 0)    { return(false); }
+    bool setMeasurementInterval(uint16_t)       { return(false); }
+    uint16_t getMeasurementInterval()           { return(0); }
+    bool dataReady()                            { return(false); }
+    bool read()                                 { return(false); }
+    float CO2 = 0, temperature = 0, relative_humidity = 0;
+};
+
+#endif
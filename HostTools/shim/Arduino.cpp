@@ -0,0 +1,457 @@
+/**************************************************
+ * Arduino shim
+ *
+ * The core functions, String, Serial and HostShim.
+ * See Arduino.h
+ *************************************************/
+
+#include <time.h>
+#include "Arduino.h"
+#include <avr/eeprom.h>
+
+CHostShim::CHostShim()   // constructor
+{
+    SerialIn = stdin;
+    SerialOut = stdout;
+    RtcRunning = true;
+    RtcUnix = 1782475200;       // 2026-06-26 12:00:00
+    CardDir = NULL;
+    DataFile = NULL;
+    EventFile = NULL;
+    DataLines = 0;
+    SkewUsec = 0;
+    Allocs = 0;
+    EraseEeprom();
+}
+
+void CHostShim::EraseEeprom()
+{
+    memset(Eeprom, 0xFF, sizeof(Eeprom));
+}
+
+CHostShim HostShim;
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+
+/***************** pins, time, interrupts *******************/
+void pinMode(uint8_t, uint8_t)              { }
+void digitalWrite(uint8_t, uint8_t)         { }
+int digitalRead(uint8_t)                    { return(HIGH); }
+int analogRead(uint8_t)                     { return(0); }
+void analogReference(uint8_t)               { }
+void noInterrupts()                         { }
+void interrupts()                           { }
+void yield()                                { }
+int digitalPinToInterrupt(int)              { return(NOT_AN_INTERRUPT); }
+void attachInterrupt(int, void (*)(void), int)  { }
+void detachInterrupt(int)                   { }
+
+static uint64_t HostUsec()
+{
+    static uint64_t start = 0;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t usec = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    if (start == 0)
+        start = usec - 1;
+    return(usec - start);
+}
+
+// Both wrap at 32 bits like the board's
+unsigned long micros()
+{
+    return((uint32_t)(HostUsec() + HostShim.SkewUsec));
+}
+
+unsigned long millis()
+{
+    return((uint32_t)((HostUsec() + HostShim.SkewUsec) / 1000));
+}
+
+void delay(unsigned long ms)
+{
+    HostShim.SkewUsec += ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    HostShim.SkewUsec += us;
+}
+
+/***************** number formatting *******************/
+char *dtostrf(double val, signed char width, unsigned char prec, char *buf)
+{
+    sprintf(buf, "%*.*f", width, prec, val);
+    return(buf);
+}
+
+char *ultoa(unsigned long val, char *buf, int base)
+{
+    char tmp[34];
+    int n = 0;
+
+    do
+        {
+        int d = val % base;
+        tmp[n++] = d < 10 ? '0' + d : 'a' + d - 10;
+        val /= base;
+        } while (val);
+    for (int i = 0; i < n; i++)
+        buf[i] = tmp[n - 1 - i];
+    buf[n] = 0;
+    return(buf);
+}
+
+char *ltoa(long val, char *buf, int base)
+{
+    if ((val < 0) && (base == 10))
+        {
+        buf[0] = '-';
+        ultoa(-(unsigned long)val, buf + 1, base);
+        return(buf);
+        }
+    return(ultoa((unsigned long)val, buf, base));
+}
+
+char *utoa(unsigned int val, char *buf, int base)
+{
+    return(ultoa(val, buf, base));
+}
+
+char *itoa(int val, char *buf, int base)
+{
+    if (base != 10)
+        return(ultoa((unsigned int)val, buf, base));
+    return(ltoa(val, buf, base));
+}
+
+/***************** EEPROM, avr/eeprom.h *******************/
+void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+    memcpy(dst, HostShim.Eeprom + (size_t)src, n);
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+    memcpy(HostShim.Eeprom + (size_t)dst, src, n);
+}
+
+void eeprom_write_block(const void *src, void *dst, size_t n)
+{
+    memcpy(HostShim.Eeprom + (size_t)dst, src, n);
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr)
+{
+    return(HostShim.Eeprom[(size_t)addr]);
+}
+
+void eeprom_update_byte(uint8_t *addr, uint8_t val)
+{
+    HostShim.Eeprom[(size_t)addr] = val;
+}
+
+/*********************************************
+ * String
+ */
+String::String(const char *s)
+{
+    Buf = NULL;
+    Len = Capacity = 0;
+    Copy(s, strlen(s));
+}
+
+String::String(const String &s)
+{
+    Buf = NULL;
+    Len = Capacity = 0;
+    Copy(s.c_str(), s.Len);
+}
+
+String::String(const __FlashStringHelper *s)
+{
+    Buf = NULL;
+    Len = Capacity = 0;
+    Copy((const char *)s, strlen((const char *)s));
+}
+
+String::String(char c)
+{
+    Buf = NULL;
+    Len = Capacity = 0;
+    Copy(&c, 1);
+}
+
+String::String(int val, int base)
+{
+    char buf[34];
+    Buf = NULL;
+    Len = Capacity = 0;
+    itoa(val, buf, base);
+    Copy(buf, strlen(buf));
+}
+
+String::String(unsigned int val, int base)
+{
+    char buf[34];
+    Buf = NULL;
+    Len = Capacity = 0;
+    utoa(val, buf, base);
+    Copy(buf, strlen(buf));
+}
+
+String::String(long val, int base)
+{
+    char buf[34];
+    Buf = NULL;
+    Len = Capacity = 0;
+    ltoa(val, buf, base);
+    Copy(buf, strlen(buf));
+}
+
+String::String(unsigned long val, int base)
+{
+    char buf[34];
+    Buf = NULL;
+    Len = Capacity = 0;
+    ultoa(val, buf, base);
+    Copy(buf, strlen(buf));
+}
+
+String::String(double val, int prec)
+{
+    char buf[40];
+    Buf = NULL;
+    Len = Capacity = 0;
+    dtostrf(val, 1, prec, buf);
+    Copy(buf, strlen(buf));
+}
+
+String::~String()
+{
+    free(Buf);
+}
+
+String &String::operator=(const String &s)
+{
+    if (this != &s)
+        Copy(s.c_str(), s.Len);
+    return(*this);
+}
+
+String &String::operator=(const char *s)
+{
+    return(Copy(s, strlen(s)));
+}
+
+String &String::operator=(const __FlashStringHelper *s)
+{
+    return(operator=((const char *)s));
+}
+
+bool String::reserve(unsigned int size)
+{
+    if (Buf && (Capacity >= size))
+        return(true);
+    char *p = (char *)realloc(Buf, size + 1);
+    if (!p)
+        return(false);
+    if (!Buf)
+        p[0] = 0;
+    Buf = p;
+    Capacity = size;
+    return(true);
+}
+
+String &String::Copy(const char *s, unsigned int n)
+{
+    if (!reserve(n))
+        return(*this);
+    memmove(Buf, s, n);
+    Buf[n] = 0;
+    Len = n;
+    return(*this);
+}
+
+String &String::Append(const char *s, unsigned int n)
+{
+    if (n == 0)
+        return(*this);
+    if (!reserve(Len + n))
+        return(*this);
+    memmove(Buf + Len, s, n);
+    Len += n;
+    Buf[Len] = 0;
+    return(*this);
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+    for (unsigned int i = from; i < Len; i++)
+        {
+        if (Buf[i] == c)
+            return(i);
+        }
+    return(-1);
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+    String s;
+    if (to > Len)
+        to = Len;
+    if (from < to)
+        s.Copy(Buf + from, to - from);
+    return(s);
+}
+
+void String::trim()
+{
+    unsigned int start = 0;
+
+    if (!Buf)
+        return;
+    while ((start < Len) && isspace((unsigned char)Buf[start]))
+        start++;
+    while ((Len > start) && isspace((unsigned char)Buf[Len - 1]))
+        Len--;
+    memmove(Buf, Buf + start, Len - start);
+    Len -= start;
+    Buf[Len] = 0;
+}
+
+void String::toUpperCase()
+{
+    for (unsigned int i = 0; i < Len; i++)
+        Buf[i] = toupper((unsigned char)Buf[i]);
+}
+
+void String::toLowerCase()
+{
+    for (unsigned int i = 0; i < Len; i++)
+        Buf[i] = tolower((unsigned char)Buf[i]);
+}
+
+String operator+(const String &a, const String &b)
+{
+    String s(a);
+    s += b;
+    return(s);
+}
+
+String operator+(const String &a, const char *b)
+{
+    String s(a);
+    s += b;
+    return(s);
+}
+
+String operator+(const char *a, const String &b)
+{
+    String s(a);
+    s += b;
+    return(s);
+}
+
+/*********************************************
+ * Print, Stream
+ */
+size_t Print::write(const uint8_t *buf, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        write(buf[i]);
+    return(n);
+}
+
+size_t Print::print(long val, int base)
+{
+    char buf[34];
+    return(write(ltoa(val, buf, base)));
+}
+
+size_t Print::print(unsigned long val, int base)
+{
+    char buf[34];
+    return(write(ultoa(val, buf, base)));
+}
+
+size_t Print::print(double val, int prec)
+{
+    char buf[40];
+    return(write(dtostrf(val, 1, prec, buf)));
+}
+
+size_t Stream::readBytesUntil(char terminator, char *buf, size_t n)
+{
+    size_t len = 0;
+
+    while (len < n)
+        {
+        int c = read();
+        if ((c < 0) || (c == terminator))
+            break;
+        buf[len++] = c;
+        }
+    return(len);
+}
+
+size_t Stream::readBytes(char *buf, size_t n)
+{
+    size_t len = 0;
+
+    while (len < n)
+        {
+        int c = read();
+        if (c < 0)
+            break;
+        buf[len++] = c;
+        }
+    return(len);
+}
+
+/*********************************************
+ * HardwareSerial
+ * Serial1 (the u-blox UART, unused) has no files.
+ */
+void HardwareSerial::flush()
+{
+    if ((Port == 0) && HostShim.SerialOut)
+        fflush(HostShim.SerialOut);
+}
+
+int HardwareSerial::available()
+{
+    return(peek() >= 0 ? 1 : 0);
+}
+
+int HardwareSerial::read()
+{
+    if ((Port != 0) || !HostShim.SerialIn)
+        return(-1);
+    return(getc(HostShim.SerialIn));
+}
+
+int HardwareSerial::peek()
+{
+    if ((Port != 0) || !HostShim.SerialIn)
+        return(-1);
+    int c = getc(HostShim.SerialIn);
+    if (c >= 0)
+        ungetc(c, HostShim.SerialIn);
+    return(c);
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    if ((Port == 0) && HostShim.SerialOut)
+        putc(c, HostShim.SerialOut);
+    return(1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t n)
+{
+    if ((Port == 0) && HostShim.SerialOut)
+        fwrite(buf, 1, n, HostShim.SerialOut);
+    return(n);
+}
@@ -0,0 +1,255 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+/**************************************************
+ * Arduino shim
+ *
+ * Just enough of the Arduino core for the StardustMaster_v2 sources
+ * to build and run on Linux: the HostTools test, replay and bench
+ * programs link the firmware against it (see the Makefile). Builds
+ * are neither __AVR__ nor ARDUINO_ARCH_SAMD, and define HOST_BUILD.
+ *
+ *   - PROGMEM is ordinary memory; the _P functions are the plain ones
+ *   - millis()/micros() run from the host's monotonic clock; delay()
+ *     doesn't sleep, it moves the clock on
+ *   - Serial reads from HostShim.SerialIn (stdin) and writes to
+ *     HostShim.SerialOut (stdout, NULL to drop it)
+ *   - pins, interrupts and the ADC do nothing; digitalRead is HIGH
+ *   - String is a working one, on malloc like the core's
+ *
+ * The sensor libraries are stand-ins in this directory that find
+ * no hardware. The logger, RTC and SD card are in CACLogger.h and
+ * BrewmicroSD.h, controlled through HostShim (HostShim.h).
+ *************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+#include <stddef.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define A0 54
+#define A1 55
+#define A2 56
+#define A3 57
+#define A4 58
+#define A8 62
+#define A9 63
+#define HEX 16
+#define DEC 10
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define NOT_AN_INTERRUPT -1
+#define DEFAULT 1
+
+static const uint8_t SDA = 20;
+static const uint8_t SCL = 21;
+
+/***************** program memory *******************/
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define pgm_read_float(p) (*(const float *)(p))
+#define pgm_read_ptr(p) (*(void * const *)(p))
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define strcat_P strcat
+#define strncpy_P strncpy
+#define strncat_P strncat
+#define strncmp_P strncmp
+#define strcmp_P strcmp
+#define strcasecmp_P strcasecmp
+#define strstr_P strstr
+#define memcpy_P memcpy
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(PSTR(s)))
+
+/***************** pins, time, interrupts *******************/
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogReference(uint8_t mode);
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void noInterrupts();
+void interrupts();
+void yield();
+int digitalPinToInterrupt(int pin);
+void attachInterrupt(int irq, void (*isr)(void), int mode);
+void detachInterrupt(int irq);
+
+/***************** number formatting *******************/
+char *dtostrf(double val, signed char width, unsigned char prec, char *buf);
+char *ltoa(long val, char *buf, int base);
+char *ultoa(unsigned long val, char *buf, int base);
+char *utoa(unsigned int val, char *buf, int base);
+char *itoa(int val, char *buf, int base);
+
+template<class T> T constrain(T a, T l, T h)    { return(a < l ? l : (a > h ? h : a)); }
+#ifndef min
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#endif
+
+/*********************************************
+ * String
+ * The core's String: a heap buffer grown with realloc.
+ */
+class String
+{
+public:
+    String(const char *s = "");
+    String(const String &s);
+    String(const __FlashStringHelper *s);
+    explicit String(char c);
+    String(int val, int base = DEC);
+    String(unsigned int val, int base = DEC);
+    String(long val, int base = DEC);
+    String(unsigned long val, int base = DEC);
+    String(double val, int prec = 2);
+    ~String();
+
+    String &operator=(const String &s);
+    String &operator=(const char *s);
+    String &operator=(const __FlashStringHelper *s);
+    String &operator+=(const String &s)             { return(Append(s.Buf, s.Len)); }
+    String &operator+=(const char *s)               { return(Append(s, strlen(s))); }
+    String &operator+=(const __FlashStringHelper *s)    { return(operator+=((const char *)s)); }
+    String &operator+=(char c)                      { return(Append(&c, 1)); }
+    String &operator+=(int val)                     { return(operator+=(String(val))); }
+    String &operator+=(long val)                    { return(operator+=(String(val))); }
+    String &operator+=(unsigned long val)           { return(operator+=(String(val))); }
+    String &operator+=(double val)                  { return(operator+=(String(val))); }
+    bool concat(const String &s)                    { operator+=(s); return(true); }
+    bool concat(const char *s)                      { operator+=(s); return(true); }
+
+    bool operator==(const String &s) const          { return(strcmp(c_str(), s.c_str()) == 0); }
+    bool operator==(const char *s) const            { return(strcmp(c_str(), s) == 0); }
+    bool operator!=(const String &s) const          { return(!operator==(s)); }
+    bool operator!=(const char *s) const            { return(!operator==(s)); }
+    bool equals(const String &s) const              { return(operator==(s)); }
+    bool equalsIgnoreCase(const String &s) const    { return(strcasecmp(c_str(), s.c_str()) == 0); }
+    bool startsWith(const String &s) const          { return(strncmp(c_str(), s.c_str(), s.Len) == 0); }
+    char operator[](unsigned int i) const           { return(i < Len ? Buf[i] : 0); }
+    char charAt(unsigned int i) const               { return(operator[](i)); }
+
+    const char *c_str() const                       { return(Buf ? Buf : ""); }
+    unsigned int length() const                     { return(Len); }
+    bool reserve(unsigned int size);
+    int indexOf(char c, unsigned int from = 0) const;
+    String substring(unsigned int from, unsigned int to = (unsigned int)-1) const;
+    void trim();
+    void toUpperCase();
+    void toLowerCase();
+    long toInt() const                              { return(atol(c_str())); }
+    float toFloat() const                           { return((float)atof(c_str())); }
+    double toDouble() const                         { return(atof(c_str())); }
+
+private:
+    String &Append(const char *s, unsigned int n);
+    String &Copy(const char *s, unsigned int n);
+
+    char *Buf;
+    unsigned int Len;
+    unsigned int Capacity;
+};
+
+String operator+(const String &a, const String &b);
+String operator+(const String &a, const char *b);
+String operator+(const char *a, const String &b);
+
+/*********************************************
+ * Print, Stream
+ */
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t n);
+    size_t write(const char *s)                     { return(write((const uint8_t *)s, strlen(s))); }
+
+    size_t print(const char *s)                     { return(write(s)); }
+    size_t print(const String &s)                   { return(write(s.c_str())); }
+    size_t print(const __FlashStringHelper *s)      { return(write((const char *)s)); }
+    size_t print(char c)                            { return(write((uint8_t)c)); }
+    size_t print(unsigned char val, int base = DEC) { return(print((unsigned long)val, base)); }
+    size_t print(int val, int base = DEC)           { return(print((long)val, base)); }
+    size_t print(unsigned int val, int base = DEC)  { return(print((unsigned long)val, base)); }
+    size_t print(long val, int base = DEC);
+    size_t print(unsigned long val, int base = DEC);
+    size_t print(double val, int prec = 2);
+
+    size_t println()                                { return(write("\r\n")); }
+    template<class T> size_t println(const T &val)              { size_t n = print(val); return(n + println()); }
+    template<class T> size_t println(const T &val, int format)  { size_t n = print(val, format); return(n + println()); }
+    size_t println(const char *s)                   { size_t n = print(s); return(n + println()); }
+    size_t println(const __FlashStringHelper *s)    { size_t n = print(s); return(n + println()); }
+};
+
+class Stream : public Print
+{
+public:
+    Stream()                                        { Timeout = 1000; }
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    void setTimeout(unsigned long msec)             { Timeout = msec; }
+    size_t readBytesUntil(char terminator, char *buf, size_t n);
+    size_t readBytes(char *buf, size_t n);
+
+protected:
+    unsigned long Timeout;
+};
+
+/*********************************************
+ * HardwareSerial
+ * Input and output are files, see HostShim. A file has all its
+ * input at once: read() at its end is -1 without the timeout.
+ */
+class HardwareSerial : public Stream
+{
+public:
+    HardwareSerial(int port)                        { Port = port; }
+    void begin(unsigned long)                       { }
+    operator bool()                                 { return(true); }
+    int availableForWrite()                         { return(64); }
+    void flush();
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buf, size_t n);
+    using Print::write;
+
+private:
+    int Port;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#include "HostShim.h"
+
+#endif
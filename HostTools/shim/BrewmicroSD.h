@@ -0,0 +1,19 @@
+#ifndef BREWMICROSD_H
+#define BREWMICROSD_H
+
+/*********************************************
+ * CBrewmicroSD stand-in
+ * The card is the directory HostShim.CardDir; no CardDir, no card
+ * files. One file is open at a time, shared by every copy.
+ */
+#include <Arduino.h>
+
+class CBrewmicroSD
+{
+public:
+    char *Init();
+    char *OpenFile(char *name);
+    bool ReadLine(char *buf, int lim);      // trimmed; false at the end
+};
+
+#endif
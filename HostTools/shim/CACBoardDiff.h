@@ -0,0 +1,14 @@
+#ifndef CACBOARDDIFF_H
+#define CACBOARDDIFF_H
+
+// debug() prints a label and a value on Serial
+#include <Arduino.h>
+
+void debug(const char *msg);
+void debug(const char *msg, const char *val);
+void debug(const char *msg, String val);
+void debug(const char *msg, int val);
+void debug(const char *msg, long val);
+void debug(const char *msg, double val);
+
+#endif
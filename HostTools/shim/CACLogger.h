@@ -0,0 +1,43 @@
+#ifndef CACLOGGER_H
+#define CACLOGGER_H
+
+/*********************************************
+ * CACLogger stand-in
+ * CRTC is HostShim's RTC. CLogger writes the data lines to
+ * HostShim.DataFile and the messages to HostShim.EventFile, one
+ * per line, without the card's file rotation. Data lines get
+ * the RTC time and millis() in front like the real logger's.
+ */
+#include <Arduino.h>
+#include <BrewmicroSD.h>
+
+class DateTime
+{
+public:
+    DateTime(uint32_t secs = 0)                 { Unix = secs; }
+    uint32_t unixtime() const                   { return(Unix); }
+
+private:
+    uint32_t Unix;
+};
+
+class CRTC
+{
+public:
+    char *Init();
+    DateTime now();
+};
+
+class CLogger
+{
+public:
+    CLogger()                                   { MAXLOGLINELENGTH = 200; }
+    char *Init(long bump, char *prefix, CRTC &rtc, CBrewmicroSD &disk);
+    void LogMsg(char *msg);
+    void WriteDataHeader(char *header);
+    void WriteDataFile(char *line);
+
+    int MAXLOGLINELENGTH;
+};
+
+#endif
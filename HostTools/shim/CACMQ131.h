@@ -0,0 +1,6 @@
+#ifndef CACMQ131_H
+#define CACMQ131_H
+
+// Nothing the firmware uses
+
+#endif
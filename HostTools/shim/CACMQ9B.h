@@ -0,0 +1,6 @@
+#ifndef CACMQ9B_H
+#define CACMQ9B_H
+
+// Nothing the firmware uses
+
+#endif
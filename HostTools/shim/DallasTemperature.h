@@ -0,0 +1,24 @@
+#ifndef DALLASTEMPERATURE_H
+#define DALLASTEMPERATURE_H
+
+// Stand-in: no devices on the wire
+#include <OneWire.h>
+
+typedef uint8_t DeviceAddress[8];
+#define DEVICE_DISCONNECTED_C   -127
+
+class DallasTemperature
+{
+public:
+    DallasTemperature(OneWire *)                { }
+    void begin()                                { }
+    uint8_t getDeviceCount()                    { return(0); }
+    bool getAddress(uint8_t *, uint8_t)         { return(false); }
+    bool setResolution(const uint8_t *, uint8_t, bool = false)  { return(false); }
+    void setWaitForConversion(bool)             { }
+    void requestTemperatures()                  { }
+    bool isConversionComplete()                 { return(true); }
+    float getTempC(const uint8_t *)             { return(DEVICE_DISCONNECTED_C); }
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef HOSTSHIM_H
+#define HOSTSHIM_H
+
+/*********************************************
+ * CHostShim
+ *
+ * What the host programs set up before calling into the firmware:
+ * where Serial goes, the RTC, the SD card's files and the EEPROM.
+ * The defaults are a running RTC at a fixed time, no card files
+ * and a blank (0xFF) EEPROM.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define SHIM_EEPROM_SIZE    4096        // the Mega's
+
+class CHostShim
+{
+public:
+    CHostShim();
+
+    FILE *SerialIn;             // Serial input, default stdin
+    FILE *SerialOut;            // Serial output, default stdout; NULL drops it
+    bool RtcRunning;            // CRTC::Init works
+    uint32_t RtcUnix;           // the RTC's time, seconds since 1970
+    const char *CardDir;        // where CBrewmicroSD finds files (config), NULL: no card
+    FILE *DataFile;             // CLogger data lines, NULL drops them
+    FILE *EventFile;            // CLogger messages, NULL drops them
+    unsigned long DataLines;    // CLogger data lines written
+    uint8_t Eeprom[SHIM_EEPROM_SIZE];
+    unsigned long SkewUsec;     // delay() time added to the clock
+    unsigned long Allocs;       // malloc, realloc and calloc calls, counted by
+                                // a program that wraps them (StarBench)
+
+    void EraseEeprom();
+};
+
+extern CHostShim HostShim;
+
+#endif
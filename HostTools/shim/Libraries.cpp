@@ -0,0 +1,135 @@
+/**************************************************
+ * Library stand-ins
+ *
+ * The card, logger and RTC (BrewmicroSD.h, CACLogger.h),
+ * debug() (CACBoardDiff.h) and the Wire object.
+ *************************************************/
+
+#include <time.h>
+#include <Arduino.h>
+#include <Wire.h>
+#include <BrewmicroSD.h>
+#include <CACLogger.h>
+#include <CACBoardDiff.h>
+
+TwoWire Wire;
+
+/*********************************************
+ * CBrewmicroSD
+ */
+static FILE *CardFile = NULL;
+
+char *CBrewmicroSD::Init()
+{
+    return(NULL);
+}
+
+char *CBrewmicroSD::OpenFile(char *name)
+{
+    static char errMsg[] = "File open failed";
+    char path[512];
+
+    if (CardFile)
+        fclose(CardFile);
+    CardFile = NULL;
+    if (!HostShim.CardDir)
+        return(errMsg);
+    snprintf(path, sizeof(path), "%s/%s", HostShim.CardDir, name);
+    CardFile = fopen(path, "r");
+    return(CardFile ? NULL : errMsg);
+}
+
+bool CBrewmicroSD::ReadLine(char *buf, int lim)
+{
+    char line[512];
+
+    if (!CardFile || !fgets(line, sizeof(line), CardFile))
+        return(false);
+    String s(line);
+    s.trim();
+    strncpy(buf, s.c_str(), lim);
+    buf[lim] = 0;
+    return(true);
+}
+
+/*********************************************
+ * CRTC, CLogger
+ */
+char *CRTC::Init()
+{
+    static char errMsg[] = "RTC not running";
+    return(HostShim.RtcRunning ? NULL : errMsg);
+}
+
+DateTime CRTC::now()
+{
+    return(DateTime(HostShim.RtcUnix));
+}
+
+char *CLogger::Init(long, char *, CRTC &, CBrewmicroSD &)
+{
+    return(NULL);
+}
+
+void CLogger::LogMsg(char *msg)
+{
+    if (HostShim.EventFile)
+        fprintf(HostShim.EventFile, "%s\n", msg);
+}
+
+void CLogger::WriteDataHeader(char *header)
+{
+    if (HostShim.DataFile)
+        fprintf(HostShim.DataFile, "%s\n", header);
+}
+
+// Timestamp and Elapsed Time in front, as the card's logger writes them
+void CLogger::WriteDataFile(char *line)
+{
+    HostShim.DataLines++;
+    if (!HostShim.DataFile)
+        return;
+    time_t secs = HostShim.RtcUnix;
+    struct tm *t = gmtime(&secs);
+    fprintf(HostShim.DataFile, "%04d/%02d/%02d %02d:%02d:%02d,%lu,%s\n",
+            t->tm_year + 1900, t->tm_mon + 1, t->tm_mday, t->tm_hour, t->tm_min, t->tm_sec,
+            millis(), line);
+}
+
+/*********************************************
+ * debug
+ */
+void debug(const char *msg)
+{
+    Serial.println(msg);
+}
+
+void debug(const char *msg, const char *val)
+{
+    Serial.print(msg);
+    Serial.println(val);
+}
+
+void debug(const char *msg, String val)
+{
+    Serial.print(msg);
+    Serial.println(val);
+}
+
+void debug(const char *msg, int val)
+{
+    Serial.print(msg);
+    Serial.println(val);
+}
+
+void debug(const char *msg, long val)
+{
+    Serial.print(msg);
+    Serial.println(val);
+}
+
+void debug(const char *msg, double val)
+{
+    Serial.print(msg);
+    Serial.println(val);
+}
@@ -0,0 +1,6 @@
+#ifndef MEMORYFREE_H
+#define MEMORYFREE_H
+
+inline int freeMemory()     { return(0); }
+
+#endif
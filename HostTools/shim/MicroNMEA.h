@@ -0,0 +1,32 @@
+#ifndef MICRONMEA_H
+#define MICRONMEA_H
+
+/*********************************************
+ * Stand-in MicroNMEA: takes the characters and never has a fix.
+ * Build with MICRONMEA=<library src dir> (see the Makefile) to use
+ * the real parser instead; MICRONMEA_STANDIN says which one this is.
+ */
+#include <Arduino.h>
+
+#define MICRONMEA_STANDIN
+
+class MicroNMEA
+{
+public:
+    MicroNMEA(void *, uint8_t)                  { }
+    bool process(char)                          { return(false); }
+    bool isValid() const                        { return(false); }
+    long getLatitude() const                    { return(0); }
+    long getLongitude() const                   { return(0); }
+    bool getAltitude(long &alt) const           { alt = 0; return(false); }
+    uint16_t getYear() const                    { return(0); }
+    uint8_t getMonth() const                    { return(0); }
+    uint8_t getDay() const                      { return(0); }
+    uint8_t getHour() const                     { return(0); }
+    uint8_t getMinute() const                   { return(0); }
+    uint8_t getSecond() const                   { return(0); }
+    uint8_t getHundredths() const               { return(0); }
+    uint8_t getNumSatellites() const            { return(0); }
+};
+
+#endif
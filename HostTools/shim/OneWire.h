@@ -0,0 +1,12 @@
+#ifndef ONEWIRE_H
+#define ONEWIRE_H
+
+#include <Arduino.h>
+
+class OneWire
+{
+public:
+    OneWire(uint8_t)                            { }
+};
+
+#endif
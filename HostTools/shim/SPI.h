@@ -0,0 +1,6 @@
+#ifndef SPI_H
+#define SPI_H
+
+// Nothing the firmware uses
+
+#endif
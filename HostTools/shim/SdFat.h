@@ -0,0 +1,18 @@
+#ifndef SDFAT_H
+#define SDFAT_H
+
+// Stand-in: CBrewmicroSD (BrewmicroSD.h) is the card
+#include <stdint.h>
+
+#define O_RDONLY 0
+
+class SdFile
+{
+public:
+    bool open(const char *, int)                { return(false); }
+    uint32_t fileSize()                         { return(0); }
+    bool getModifyDateTime(uint16_t *, uint16_t *)  { return(false); }
+    bool close()                                { return(true); }
+};
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef SPARKFUN_VEML6075_ARDUINO_LIBRARY_H
+#define SPARKFUN_VEML6075_ARDUINO_LIBRARY_H
+
+// Stand-in: no VEML6075 on the bus
+#include <Wire.h>
+
+class VEML6075
+{
+public:
+    bool begin()                                { return(false); }
+    float uva()                                 { return(0); }
+    float uvb()                                 { return(0); }
+    float index()                               { return(0); }
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef SPARKFUN_UBLOX_GNSS_ARDUINO_LIBRARY_H
+#define SPARKFUN_UBLOX_GNSS_ARDUINO_LIBRARY_H
+
+// Stand-in: no receiver on the bus. processNMEA is the firmware's
+#include <Wire.h>
+
+#define COM_TYPE_UBX                1
+#define COM_TYPE_NMEA               2
+#define VAL_CFG_SUBSEC_IOPORT       0x00000001
+#define VAL_CFG_SUBSEC_NAVCONF      0x00000008
+#define SFE_UBLOX_FILTER_NMEA_ALL   0xff
+#define DYN_MODEL_AIRBORNE2g        7
+
+class SFE_UBLOX_GNSS
+{
+public:
+    bool begin(TwoWire & = Wire, uint8_t = 0x42, uint16_t = 1100, bool = false)  { return(false); }
+    bool isConnected(uint16_t = 1100)           { return(false); }
+    bool setI2COutput(uint8_t, uint16_t = 1100) { return(false); }
+    bool saveConfigSelective(uint32_t, uint16_t = 1100)     { return(false); }
+    bool saveConfiguration(uint16_t = 1100)     { return(false); }
+    void setProcessNMEAMask(uint8_t)            { }
+    bool checkUblox(uint8_t = 0)                { return(false); }
+    void processNMEA(char incoming);
+    uint8_t getFixType(uint16_t = 1100)         { return(0); }
+    uint32_t getTimeOfWeek(uint16_t = 1100)     { return(0); }
+    uint16_t getYear(uint16_t = 1100)           { return(0); }
+    uint8_t getMonth(uint16_t = 1100)           { return(0); }
+    uint8_t getDay(uint16_t = 1100)             { return(0); }
+    uint8_t getHour(uint16_t = 1100)            { return(0); }
+    uint8_t getMinute(uint16_t = 1100)          { return(0); }
+    uint8_t getSecond(uint16_t = 1100)          { return(0); }
+    bool getTimeValid(uint16_t = 1100)          { return(false); }
+    bool getDateValid(uint16_t = 1100)          { return(false); }
+    bool setDynamicModel(uint8_t, uint16_t = 1100)          { return(false); }
+    bool setAopCfg(uint8_t, uint16_t = 0, uint16_t = 1100)  { return(false); }
+    bool powerSaveMode(bool, uint16_t = 1100)   { return(false); }
+    size_t pushRawData(uint8_t *, size_t, bool = true)      { return(0); }
+    bool setUTCTimeAssistance(uint16_t, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t,
+                              uint32_t = 0, uint16_t = 0, uint32_t = 0, uint8_t = 0,
+                              uint16_t = 1100)  { return(false); }
+    bool setPositionAssistanceLLH(int32_t, int32_t, int32_t, uint32_t, uint16_t = 1100)    { return(false); }
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <Arduino.h>
+
+/*********************************************
+ * TwoWire
+ * An empty bus: every address NACKs and nothing is read back.
+ * No WIRE_HAS_TIMEOUT, like the SAMD core.
+ */
+class TwoWire : public Stream
+{
+public:
+    void begin()                                { }
+    void end()                                  { }
+    void setClock(uint32_t)                     { }
+    void beginTransmission(uint8_t)             { }
+    void beginTransmission(int)                 { }
+    uint8_t endTransmission(bool = true)        { return(2); }     // address NACK
+    uint8_t requestFrom(int, int)               { return(0); }
+    uint8_t requestFrom(uint8_t, uint8_t)       { return(0); }
+    size_t write(uint8_t)                       { return(1); }
+    using Print::write;
+    int available()                             { return(0); }
+    int read()                                  { return(-1); }
+    int peek()                                  { return(-1); }
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef EEPROM_H
+#define EEPROM_H
+
+// The EEPROM is HostShim.Eeprom; addresses are offsets into it
+#include <stdint.h>
+#include <stddef.h>
+
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+void eeprom_write_block(const void *src, void *dst, size_t n);
+uint8_t eeprom_read_byte(const uint8_t *addr);
+void eeprom_update_byte(uint8_t *addr, uint8_t val);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef BMP3_H
+#define BMP3_H
+
+// Nothing the firmware uses
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef BMP3_DEFS_H
+#define BMP3_DEFS_H
+
+// Nothing the firmware uses
+
+#endif
@@ -0,0 +1,18 @@
+#!/bin/sh
+# Joins the sketch's .ino files into one C++ file, as the Arduino
+# builder does: the main .ino first, then the rest in name order,
+# with prototypes for the functions defined at column 0.
+#   sketch.sh ../StardustMaster_v2 > Sketch.cpp
+dir=$1
+main=$dir/$(basename "$dir").ino
+inos="$main $(ls "$dir"/*.ino | grep -v "^$main\$" | sort)"
+
+echo '#include <Arduino.h>'
+cat $inos | awk '
+    prev ~ /^[A-Za-z_][A-Za-z0-9_ *&]*[ *&][A-Za-z_][A-Za-z0-9_]*\(.*\)[ \t]*$/ && $0 ~ /^[ \t]*\{/ \
+        { print prev ";" }
+    { prev = $0 }'
+for f in $inos; do
+    echo "#line 1 \"$f\""
+    cat "$f"
+done
@@ -0,0 +1,260 @@
+/**************************************************
+ * GpsAidingTest
+ *
+ * The GPS startup sequence (CGpsAiding, GpsAiding.h in the firmware)
+ * against a stand-in receiver: the steps Poll sends, one per call,
+ * what the saved record hands back after a reset, and the age check
+ * that keeps an old or undated record from being handed back.
+ * The record goes through the shim's EEPROM and the RTC is HostShim's.
+ *
+ * Built and run by "make test". Exits with 1 if a check fails.
+ *************************************************/
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "GpsAiding.h"
+#include "SystemParameters.h"
+
+extern bool RtcRunning;         // StardustMaster_v2.ino; set by setup()
+
+static int Failures = 0;
+
+#define CHECK(cond) Check((cond), #cond, __LINE__)
+
+static void Check(bool ok, const char *what, int line)
+{
+    if (ok)
+        return;
+    printf("  FAILED line %d: %s\n", line, what);
+    Failures++;
+}
+
+/*********************************************
+ * CTestReceiver
+ * Takes every command and remembers what it was sent.
+ */
+class CTestReceiver: public CGpsReceiver
+{
+public:
+    CTestReceiver(bool hasTime = false) { KeptTime = hasTime; }
+
+    bool EnableAop()
+        {
+        Sent.push_back("aop");
+        return true;
+        }
+    bool SaveConfig()
+        {
+        Sent.push_back("config");
+        return true;
+        }
+    bool HasTime()
+        {
+        Sent.push_back("hastime");
+        return KeptTime;
+        }
+    bool AidPosition(int32_t lat, int32_t lon, int32_t altCm, uint32_t accCm)
+        {
+        Sent.push_back("position");
+        Lat = lat;
+        Lon = lon;
+        AltCm = altCm;
+        AccCm = accCm;
+        return true;
+        }
+    bool AidTime(const GpsAidRecord &rec, uint16_t accSec)
+        {
+        Sent.push_back("time");
+        Time = rec;
+        TimeAccSec = accSec;
+        return true;
+        }
+
+    bool KeptTime;
+    std::vector<std::string> Sent;
+    int32_t Lat = 0, Lon = 0, AltCm = 0;
+    uint32_t AccCm = 0;
+    GpsAidRecord Time = {};
+    uint16_t TimeAccSec = 0;
+};
+
+#define T0  1782475200UL        // 2026-06-26 12:00:00, the RTC at the save
+
+// Runs the whole sequence; the number of Poll calls it took
+static int RunSequence(CGpsAiding &aiding, CGpsReceiver &receiver)
+{
+    int polls = 1;
+    while (!aiding.Poll(receiver) && polls < 20)
+        polls++;
+    return polls;
+}
+
+// A flight that got a fix at T0, saved to the EEPROM
+static void SaveFlight(uint8_t hour, uint8_t minute, uint8_t second)
+{
+    CGpsAiding flight;
+    CTestReceiver receiver;
+
+    HostShim.RtcUnix = T0;
+    flight.Start();
+    RunSequence(flight, receiver);
+    flight.Time(2026, 6, 26, hour, minute, second);
+    flight.Fix(407238620, -739885263, 1524370);     // first fix: saved
+}
+
+static void TestFirstBoot()
+{
+    printf("first boot, blank EEPROM\n");
+    HostShim.EraseEeprom();
+    HostShim.RtcUnix = T0;
+
+    CGpsAiding aiding;
+    CTestReceiver receiver;
+    aiding.Start();
+    CHECK(!aiding.Poll(receiver));      // one command per call
+    CHECK(receiver.Sent.size() == 1 && receiver.Sent[0] == "aop");
+    CHECK(!aiding.Poll(receiver));
+    CHECK(!aiding.Poll(receiver));
+    CHECK(aiding.Poll(receiver));
+    CHECK(aiding.Poll(receiver));       // done stays done
+    CHECK((receiver.Sent == std::vector<std::string>{"aop", "hastime", "config"}));
+    CHECK(aiding.Aided == GPS_AID_CONFIG);
+}
+
+static void TestWarmStart()
+{
+    printf("reset 10 min after the fix\n");
+    HostShim.EraseEeprom();
+    SaveFlight(12, 0, 0);
+    HostShim.RtcUnix = T0 + 600;
+
+    CGpsAiding aiding;
+    CTestReceiver receiver;
+    aiding.Start();
+    CHECK(RunSequence(aiding, receiver) == 4);
+    // Time before position; the config again, the receiver lost its RAM
+    CHECK((receiver.Sent == std::vector<std::string>{"aop", "hastime", "time", "config", "position"}));
+    CHECK(receiver.Time.Hour == 12 && receiver.Time.Minute == 10 && receiver.Time.Second == 0);
+    CHECK(receiver.TimeAccSec == GPS_AID_TIME_ACC_SEC);
+    CHECK(receiver.Lat == 407238620 && receiver.Lon == -739885263 && receiver.AltCm == 1524370);
+    CHECK(receiver.AccCm == GPS_AID_POS_ACC_CM + 600 * GPS_AID_DRIFT_CMS);
+    CHECK(aiding.Aided == (GPS_AID_FIX | GPS_AID_TIME | GPS_AID_CONFIG));
+}
+
+static void TestReceiverKeptTime()
+{
+    printf("receiver kept its time and config\n");
+    HostShim.EraseEeprom();
+    SaveFlight(12, 0, 0);
+    HostShim.RtcUnix = T0 + 60;
+
+    CGpsAiding aiding;
+    CTestReceiver receiver(true);
+    aiding.Start();
+    RunSequence(aiding, receiver);
+    CHECK((receiver.Sent == std::vector<std::string>{"aop", "hastime", "position"}));
+    CHECK(aiding.Aided == (GPS_AID_FIX | GPS_AID_RX_TIME));
+}
+
+static void TestMidnight()
+{
+    printf("time aiding across midnight\n");
+    HostShim.EraseEeprom();
+    SaveFlight(23, 59, 50);
+    HostShim.RtcUnix = T0 + 600;
+
+    CGpsAiding aiding;
+    CTestReceiver receiver;
+    aiding.Start();
+    RunSequence(aiding, receiver);
+    CHECK(receiver.Time.Year == 2026 && receiver.Time.Month == 6 && receiver.Time.Day == 27);
+    CHECK(receiver.Time.Hour == 0 && receiver.Time.Minute == 9 && receiver.Time.Second == 50);
+}
+
+// A record that mustn't be handed back: no time or position aiding
+static void CheckStale(const char *what, uint32_t rtcNow, bool rtcRunning)
+{
+    printf("%s\n", what);
+    HostShim.EraseEeprom();
+    SaveFlight(12, 0, 0);
+    HostShim.RtcUnix = rtcNow;
+    RtcRunning = rtcRunning;
+
+    CGpsAiding aiding;
+    CTestReceiver receiver;
+    aiding.Start();
+    RunSequence(aiding, receiver);
+    RtcRunning = true;
+    CHECK((receiver.Sent == std::vector<std::string>{"aop", "hastime", "config"}));
+    CHECK(aiding.Aided == (GPS_AID_STALE | GPS_AID_CONFIG));
+}
+
+static void TestAgeCheck()
+{
+    printf("record at the age limit\n");
+    HostShim.EraseEeprom();
+    SaveFlight(12, 0, 0);
+    HostShim.RtcUnix = T0 + GPS_AID_MAX_AGE_SEC;
+
+    CGpsAiding aiding;
+    CTestReceiver receiver;
+    aiding.Start();
+    RunSequence(aiding, receiver);
+    CHECK(aiding.Aided == (GPS_AID_FIX | GPS_AID_TIME | GPS_AID_CONFIG));
+    CHECK(receiver.AccCm == GPS_AID_POS_ACC_CM + GPS_AID_MAX_AGE_SEC * GPS_AID_DRIFT_CMS);
+
+    CheckStale("record over the age limit", T0 + GPS_AID_MAX_AGE_SEC + 1, true);
+    CheckStale("RTC behind the record", T0 - 10, true);
+    CheckStale("RTC not running", T0 + 60, false);
+}
+
+static void TestUndatedSave()
+{
+    printf("saved with the RTC not running\n");
+    HostShim.EraseEeprom();
+    RtcRunning = false;
+    SaveFlight(12, 0, 0);
+    RtcRunning = true;
+    HostShim.RtcUnix = T0 + 60;
+
+    CGpsAiding aiding;
+    CTestReceiver receiver;
+    aiding.Start();
+    RunSequence(aiding, receiver);
+    CHECK(!(aiding.Aided & (GPS_AID_FIX | GPS_AID_TIME)));
+    CHECK(aiding.Aided & GPS_AID_STALE);
+}
+
+static void TestCorruptRecord()
+{
+    printf("record with a bad CRC\n");
+    HostShim.EraseEeprom();
+    SaveFlight(12, 0, 0);
+    HostShim.Eeprom[EEPROM_GPS_ADDR + 5] ^= 0x40;      // a bit of the latitude
+    HostShim.RtcUnix = T0 + 60;
+
+    CGpsAiding aiding;
+    CTestReceiver receiver;
+    aiding.Start();
+    RunSequence(aiding, receiver);
+    CHECK(aiding.Aided == GPS_AID_CONFIG);      // like a blank EEPROM
+}
+
+int main()
+{
+    HostShim.SerialOut = NULL;
+    RtcRunning = true;
+
+    TestFirstBoot();
+    TestWarmStart();
+    TestReceiverKeptTime();
+    TestMidnight();
+    TestAgeCheck();
+    TestUndatedSave();
+    TestCorruptRecord();
+
+    printf("GpsAidingTest: %s\n", Failures ? "FAILED" : "passed");
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+/**************************************************
+ * ReplayTest
+ *
+ * Replays test/data/Flight.csv, a flight logged with the
+ * production sensor set (Quality column and record trailers),
+ * through the firmware built with REPLAY_SENSORS: setup() once,
+ * then loop() per record as StarReplay runs it. Checks that every
+ * record is replayed and logged again with the replayed values,
+ * and that the GPS fix tracking and the flight phase detector see
+ * the flight: no fix on the pad, a dropout on the way up, then
+ * ascent, burst, descent and landing.
+ *
+ * Built and run by "make test". Exits with 1 if a check fails.
+ *************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include "FlightReplay.h"
+
+void setup();
+void loop();
+
+static int Failures = 0;
+
+#define CHECK(cond) Check((cond), #cond, __LINE__)
+
+static void Check(bool ok, const char *what, int line)
+{
+    if (ok)
+        return;
+    printf("  FAILED line %d: %s\n", line, what);
+    Failures++;
+}
+
+// The lines of a file, without the line ends
+static std::vector<std::string> ReadLines(FILE *fp)
+{
+    std::vector<std::string> lines;
+    char buf[512];
+
+    rewind(fp);
+    while (fgets(buf, sizeof(buf), fp))
+        {
+        std::string s = buf;
+        while (!s.empty() && ((s.back() == '\n') || (s.back() == '\r')))
+            s.pop_back();
+        lines.push_back(s);
+        }
+    return lines;
+}
+
+static std::vector<std::string> Split(const std::string &line)
+{
+    std::vector<std::string> fields;
+    size_t start = 0, comma;
+
+    while ((comma = line.find(',', start)) != std::string::npos)
+        {
+        fields.push_back(line.substr(start, comma - start));
+        start = comma + 1;
+        }
+    fields.push_back(line.substr(start));
+    return fields;
+}
+
+static int CountEvents(const std::vector<std::string> &events, const char *text)
+{
+    int n = 0;
+    for (const std::string &e : events)
+        {
+        if (e.find(text) != std::string::npos)
+            n++;
+        }
+    return n;
+}
+
+// Columns of the production set (see the header of Flight.csv)
+#define COL_LAT      3
+#define COL_CO2OLD   5
+#define COL_CO2NEW   8
+#define COL_HPA      11
+#define COL_BMPALT   12
+#define COL_UVA      14
+#define COL_QUALITY  24
+
+static void CheckRecords(const std::vector<std::string> &in, const std::vector<std::string> &out)
+{
+    printf("every record replayed and logged\n");
+    CHECK(FlightReplay.Finished);
+    CHECK(FlightReplay.RecordCount == (long)in.size() - 1);
+    CHECK(HostShim.DataLines == in.size() - 1);
+    CHECK(out.size() == in.size());     // header and one line per record
+    if (out.size() != in.size())
+        return;
+    CHECK(out[0] == in[0]);
+
+    printf("replayed values logged unchanged\n");
+    int checked = 0, gpsChecked = 0;
+    for (size_t i = 1; i < in.size(); i++)
+        {
+        std::vector<std::string> a = Split(in[i]);
+        std::vector<std::string> b = Split(out[i]);
+        if ((a.size() != b.size()) || (a.size() <= COL_QUALITY + 1))
+            {
+            CHECK(a.size() == b.size());
+            continue;
+            }
+        static const int cols[] = {COL_CO2OLD, COL_CO2NEW, COL_HPA, COL_BMPALT, COL_UVA};
+        for (int c : cols)
+            {
+            if (fabs(atof(a[c].c_str()) - atof(b[c].c_str())) > 0.005)
+                {
+                printf("  record %zu column %d: %s logged as %s\n", i, c, a[c].c_str(), b[c].c_str());
+                CHECK(false);
+                }
+            }
+        checked++;
+        if (a[COL_QUALITY][COL_LAT - 2] == '0')
+            {   // fresh fix: the position goes through
+            CHECK(fabs(atof(a[COL_LAT].c_str()) - atof(b[COL_LAT].c_str())) < 0.0000005);
+            gpsChecked++;
+            }
+        std::string seq = ",#D" + std::to_string(i) + ":";
+        CHECK(out[i].find(seq) != std::string::npos);
+        }
+    CHECK(checked == (int)in.size() - 1);
+    CHECK(gpsChecked > 0);
+}
+
+static void CheckEvents(const std::vector<std::string> &events)
+{
+    printf("header matches the sensor set\n");
+    CHECK(CountEvents(events, "columns, sensor set has") == 0);
+    CHECK(CountEvents(events, "Replay: no") == 0);
+
+    printf("fix found on the pad, lost and found again on the way up\n");
+    CHECK(CountEvents(events, "Established fix") == 2);
+    CHECK(CountEvents(events, "Lost fix") == 1);
+
+    printf("flight phases in order\n");
+    std::vector<std::string> phases;
+    for (const std::string &e : events)
+        {
+        if (e.compare(0, 13, "Flight phase ") == 0)
+            phases.push_back(e.substr(13, e.find(" at ") - 13));
+        }
+    CHECK((phases == std::vector<std::string>{"PAD -> ASCENT", "ASCENT -> BURST",
+                                              "BURST -> DESCENT", "DESCENT -> PAD"}));
+    CHECK(CountEvents(events, "Replay: ") == 1);
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = (argc > 1) ? argv[1] : "test/data/Flight.csv";
+
+    FILE *flight = fopen(path, "r");
+    if (!flight)
+        {
+        perror(path);
+        return 1;
+        }
+    std::vector<std::string> in = ReadLines(flight);
+    rewind(flight);
+
+    HostShim.SerialIn = flight;
+    HostShim.SerialOut = NULL;
+    HostShim.DataFile = tmpfile();
+    HostShim.EventFile = tmpfile();
+
+    printf("replaying %s\n", path);
+    setup();
+    do
+        loop();
+    while (!FlightReplay.Finished && !feof(HostShim.SerialIn));
+
+    std::vector<std::string> out = ReadLines(HostShim.DataFile);
+    std::vector<std::string> events = ReadLines(HostShim.EventFile);
+    CheckRecords(in, out);
+    CheckEvents(events);
+
+    fclose(flight);
+    printf("ReplayTest: %s\n", Failures ? "FAILED" : "passed");
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+/**************************************************
+ * AdcEngine
+ *
+ * Implementation of CAdcEngine, the background
+ * oversampling ADC. See AdcEngine.h
+ *************************************************/
+
+#include "AdcEngine.h"
+
+CAdcEngine::CAdcEngine()   // constructor
+{
+    for (int i=0; i < ADC_MAX_CHANNELS; i++)
+        {
+        Pins[i] = -1;
+        Values[i] = 0;
+        Seqs[i] = 0;
+        }
+    NumChannels = 0;
+    Current = 0;
+    Count = 0;
+    Discard = true;
+    Sum = 0;
+}
+
+int CAdcEngine::AddChannel(int pin)
+{
+    int n = NumChannels;
+
+    for (int i=0; i < n; i++)
+        {
+        if (Pins[i] == pin)
+            return(i);          // two sensors on one pin share it
+        }
+    if (n >= ADC_MAX_CHANNELS) return(-1);
+
+    pinMode(pin, INPUT);
+    Pins[n] = pin;
+    NumChannels = n + 1;        // the ISR picks it up on its next round
+    if (n > 0) return(n);
+
+    // First channel: start converting
+    Current = 0;
+    Count = 0;
+    Sum = 0;
+    Discard = true;
+#ifdef __AVR__
+    Select(0);
+    ADCSRA = _BV(ADEN) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);   // prescaler 128
+    ADCSRA |= _BV(ADSC);
+#elif defined(ARDUINO_ARCH_SAMD)
+    analogReadResolution(ADC_BITS);
+#endif
+    return(n);
+}
+
+void CAdcEngine::Select(int channel)
+{
+#ifdef __AVR__
+    uint8_t ch = (Pins[channel] >= A0) ? Pins[channel] - A0 : Pins[channel];
+#ifdef MUX5
+    if (ch & 8)
+        ADCSRB |= _BV(MUX5);    // A8..A15 on the Mega
+    else
+        ADCSRB &= ~_BV(MUX5);
+#endif
+    ADMUX = _BV(REFS0) | (ch & 7);
+#endif
+}
+
+/****************************
+ * Conversion
+ * Sums ADC_OVERSAMPLE readings, then stores the decimated value
+ * and moves to the next channel.
+ */
+void CAdcEngine::Conversion(uint16_t rdg)
+{
+    if (Discard)
+        {
+        Discard = false;
+        return;
+        }
+    Sum += rdg;
+    if (++Count < ADC_OVERSAMPLE) return;
+
+    Values[Current] = Sum >> ADC_EXTRA_BITS;
+    uint8_t seq = Seqs[Current] + 1;
+    Seqs[Current] = seq ? seq : 1;
+    Sum = 0;
+    Count = 0;
+    if (NumChannels > 1)
+        {
+        Current = (Current + 1) % NumChannels;
+        Select(Current);
+        Discard = true;
+        }
+}
+
+bool CAdcEngine::Latest(int channel, double &fraction, uint8_t &seq)
+{
+    if ((channel < 0) || (channel >= NumChannels)) return(false);
+
+    noInterrupts();         // the value is two bytes on AVR
+    uint16_t value = Values[channel];
+    seq = Seqs[channel];
+    interrupts();
+    if (seq == 0) return(false);
+    fraction = (double)value / ADC_FULL_SCALE;
+    return(true);
+}
+
+void CAdcEngine::Service()
+{
+#ifndef __AVR__
+    if (NumChannels == 0) return;
+    Conversion(analogRead(Pins[Current]));
+#endif
+}
+
+#ifdef __AVR__
+ISR(ADC_vect)
+{
+    AdcEngine.Conversion(ADC);
+    ADCSRA |= _BV(ADSC);        // next conversion, on the channel Conversion selected
+}
+#endif
+
+CAdcEngine AdcEngine;
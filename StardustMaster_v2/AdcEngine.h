@@ -0,0 +1,68 @@
+#ifndef ADCENGINE_H
+#define ADCENGINE_H
+
+#include <Arduino.h>
+
+/*********************************************
+ * CAdcEngine
+ *
+ * Background acquisition for the analog channels (battery voltages,
+ * and the analog gas sensors when they come back). analogRead()
+ * waits out each ~110 usec conversion; here the conversions run on
+ * their own and a sensor read is a lookup of the latest value.
+ *
+ * The channels are converted round robin. Each channel gets
+ * ADC_OVERSAMPLE conversions in a row, summed and decimated by
+ * ADC_EXTRA_BITS: 16 samples give 2 bits more than the ADC has, and
+ * average out the noise. The first conversion after switching the
+ * mux is thrown away (the sample and hold is still settling).
+ *
+ * On AVR the ADC interrupt chains the conversions: each one reads
+ * the result and starts the next, at the ADC's own pace (prescaler
+ * 128, ~104 usec at 16 MHz, ~9600 interrupts a second). Nothing else
+ * may call analogRead() once a channel is added. Other boards call
+ * Service() from the main loop and the idle sleep, one conversion a
+ * call.
+ *
+ * Latest() gives the value as a fraction of full scale; each sensor
+ * applies its own calibration (reference, divider, offset) on top.
+ */
+
+#define ADC_MAX_CHANNELS    6
+#define ADC_OVERSAMPLE      16      // conversions per decimated value
+#define ADC_EXTRA_BITS      2       // log4(ADC_OVERSAMPLE)
+#ifdef __AVR__
+#define ADC_BITS            10
+#define ADC_REF_VOLTS       5.0     // AVcc, the default reference
+#else
+#define ADC_BITS            12      // analogReadResolution
+#define ADC_REF_VOLTS       3.3
+#endif
+#define ADC_FULL_SCALE      (1L << (ADC_BITS + ADC_EXTRA_BITS))
+
+class CAdcEngine
+{
+public:
+    CAdcEngine();
+
+    int  AddChannel(int pin);       // channel number, -1 if full; starts the conversions
+    bool Latest(int channel, double &fraction, uint8_t &seq); // false until the first value
+    void Service();                 // one conversion; no-op if interrupt driven
+    void Conversion(uint16_t rdg);  // a conversion finished, from the ISR
+
+private:
+    void Select(int channel);
+
+    int  Pins[ADC_MAX_CHANNELS];
+    volatile uint16_t Values[ADC_MAX_CHANNELS];     // decimated, ADC_FULL_SCALE counts
+    volatile uint8_t  Seqs[ADC_MAX_CHANNELS];       // bumped with each new value; 0 = none yet
+    volatile uint8_t  NumChannels;
+    uint8_t  Current;               // channel being converted
+    uint8_t  Count;                 // conversions summed so far
+    bool     Discard;               // first conversion after a mux switch
+    uint16_t Sum;
+};
+
+extern CAdcEngine AdcEngine;
+
+#endif
@@ -0,0 +1,240 @@
+/**************************************************
+ * AltitudeFilter
+ *
+ * Implementation of CAltitudeFilter, the fixed point
+ * baro/GPS altitude and vertical rate filter, and of
+ * CFusionSensor, which logs its output.
+ * See AltitudeFilter.h
+ *************************************************/
+
+#include "AltitudeFilter.h"
+#include "MySensor.h"
+
+// Q16.16 helpers
+#define Q16(x)       ((int32_t)((x) * 65536.0))
+#define Q16_MAX      Q16(30000.0)       // cap on covariance terms (m^2)
+
+static inline int32_t QMul(int32_t a, int32_t b)
+{
+    return (int32_t)(((int64_t)a * b + 32768) >> 16);
+}
+
+static inline int32_t Sat(int64_t a)
+{
+    if (a > Q16_MAX) return Q16_MAX;
+    if (a < -Q16_MAX) return -Q16_MAX;
+    return (int32_t)a;
+}
+
+CAltitudeFilter::CAltitudeFilter()   // constructor
+{
+    Valid = false;
+    AltMm = 0;
+    RateMmSec = 0;
+    BiasMm = 0;
+    GpsRejects = 0;
+    LastMsec = 0;
+    memset(P, 0, sizeof(P));
+}
+
+/****************************
+ * Start
+ * First measurement: start at it with a wide covariance.
+ * The measurement itself is applied by Correct.
+ */
+void CAltitudeFilter::Start(int32_t zMm, unsigned long msec)
+{
+    AltMm = zMm;
+    RateMmSec = 0;
+    BiasMm = 0;
+    memset(P, 0, sizeof(P));
+    P[0][0] = Q16(FUSION_INIT_ALT_SIGMA * FUSION_INIT_ALT_SIGMA);
+    P[1][1] = Q16(FUSION_INIT_RATE_SIGMA * FUSION_INIT_RATE_SIGMA);
+    P[2][2] = Q16(FUSION_INIT_ALT_SIGMA * FUSION_INIT_ALT_SIGMA);
+    LastMsec = msec;
+    Valid = true;
+}
+
+/****************************
+ * Predict
+ * Constant velocity: h += v dt. P = F P F' + Q, with Q from
+ * white acceleration noise and a random walk on the baro bias.
+ */
+void CAltitudeFilter::Predict(unsigned long msec)
+{
+    unsigned long dtMsec = msec - LastMsec;
+    if ((long)dtMsec <= 0) return;      // same time or out of order
+    LastMsec = msec;
+    if (dtMsec > FUSION_MAX_DT_MSEC)
+        dtMsec = FUSION_MAX_DT_MSEC;
+
+    AltMm += (int32_t)((int32_t)RateMmSec * (int32_t)dtMsec / 1000);
+
+    int32_t dt = (int32_t)((dtMsec << 16) / 1000);     // seconds, Q16.16
+    int32_t dt2 = QMul(dt, dt);
+    int32_t dt3 = QMul(dt2, dt);
+    const int32_t qa = Q16(FUSION_ACCEL_SIGMA * FUSION_ACCEL_SIGMA);
+
+    // F P F' (P[1][1], P[1][2], P[2][2] are unchanged by F)
+    int64_t p00 = (int64_t)P[0][0] + 2 * (int64_t)QMul(dt, P[0][1]) + QMul(dt2, P[1][1]);
+    int64_t p01 = (int64_t)P[0][1] + QMul(dt, P[1][1]);
+    int64_t p02 = (int64_t)P[0][2] + QMul(dt, P[1][2]);
+
+    // + Q
+    p00 += QMul(qa, dt3) / 3;
+    p01 += QMul(qa, dt2) / 2;
+    P[1][1] = Sat((int64_t)P[1][1] + QMul(qa, dt));
+    P[2][2] = Sat((int64_t)P[2][2] + QMul(Q16(FUSION_BIAS_DRIFT), dt));
+
+    P[0][0] = Sat(p00);
+    P[0][1] = P[1][0] = Sat(p01);
+    P[0][2] = P[2][0] = Sat(p02);
+}
+
+/****************************
+ * Correct
+ * Measurement update. Baro sees h + b, GPS sees h.
+ * r is the measurement variance (Q16.16 m^2). If gate > 0, an
+ * innovation more than gate sigma off is rejected.
+ */
+bool CAltitudeFilter::Correct(int32_t zMm, bool baro, int32_t r, int gate)
+{
+    int64_t pht[3];         // P H'
+    int64_t s;              // H P H' + R
+    int32_t y;              // innovation, mm
+
+    if (baro)
+        {
+        for (int i=0; i < 3; i++)
+            pht[i] = (int64_t)P[i][0] + P[i][2];
+        s = pht[0] + pht[2] + r;
+        y = zMm - (AltMm + BiasMm);
+        }
+    else
+        {
+        for (int i=0; i < 3; i++)
+            pht[i] = P[i][0];
+        s = pht[0] + r;
+        y = zMm - AltMm;
+        }
+    if (s <= 0) return(false);
+
+    if (gate > 0)
+        {   // (y/1000)^2 > gate^2 * s, in Q16.16 m^2
+        int64_t y2 = ((int64_t)y * y * 65536) / 1000000;
+        if (y2 > (int64_t)gate * gate * s)
+            return(false);
+        }
+
+    int32_t k[3];           // gain, Q16.16
+    for (int i=0; i < 3; i++)
+        k[i] = (int32_t)((pht[i] << 16) / s);
+
+    AltMm     += (int32_t)(((int64_t)k[0] * y) >> 16);
+    RateMmSec += (int32_t)(((int64_t)k[1] * y) >> 16);
+    BiasMm    += (int32_t)(((int64_t)k[2] * y) >> 16);
+
+    // P -= K (P H')'
+    for (int i=0; i < 3; i++)
+        {
+        for (int j=i; j < 3; j++)
+            {
+            int64_t kp = ((int64_t)k[i] * pht[j]) >> 16;
+            P[i][j] = Sat((int64_t)P[i][j] - kp);
+            P[j][i] = P[i][j];
+            }
+        }
+    Clamp();
+    return(true);
+}
+
+// Keep the variances positive after rounding
+void CAltitudeFilter::Clamp()
+{
+    for (int i=0; i < 3; i++)
+        {
+        if (P[i][i] < 1)
+            P[i][i] = 1;
+        }
+}
+
+void CAltitudeFilter::BaroUpdate(unsigned long msec, double altMeters)
+{
+    int32_t z = (int32_t)(altMeters * 1000.0);
+
+    if (!Valid)
+        Start(z, msec);
+    Predict(msec);
+    Correct(z, true, Q16(FUSION_BARO_SIGMA * FUSION_BARO_SIGMA), 0);
+}
+
+void CAltitudeFilter::GpsUpdate(unsigned long msec, double altMeters)
+{
+    int32_t z = (int32_t)(altMeters * 1000.0);
+
+    if (!Valid)
+        Start(z, msec);
+    Predict(msec);
+    if (!Correct(z, false, Q16(FUSION_GPS_SIGMA * FUSION_GPS_SIGMA), FUSION_GPS_GATE))
+        GpsRejects++;
+}
+
+double CAltitudeFilter::Altitude()
+{
+    return (AltMm / 1000.0);
+}
+
+double CAltitudeFilter::VertRate()
+{
+    return (RateMmSec / 1000.0);
+}
+
+double CAltitudeFilter::AltSigma()
+{
+    return sqrt(P[0][0] / 65536.0);
+}
+
+double CAltitudeFilter::RateSigma()
+{
+    return sqrt(P[1][1] / 65536.0);
+}
+
+CAltitudeFilter AltFilter;
+
+
+/**************************************
+ * Fusion "sensor"
+ * Logs the filter output like any other sensor. The baro and GPS
+ * sensors feed the filter from their ReadSensor, so this one goes
+ * after them in the set.
+ **************************************/
+void CFusionSensor::InitSensor()
+{
+    BasePeriodMsec = BMP388_PERIOD_MSEC;
+}
+
+bool CFusionSensor::ReadSensor()
+{
+    ErrMsg = "";
+    Values[CH_FUSE_ALT] = AltFilter.Altitude();
+    Values[CH_FUSE_RATE] = AltFilter.VertRate();
+    Values[CH_FUSE_ALTSIG] = AltFilter.AltSigma();
+    Values[CH_FUSE_RATESIG] = AltFilter.RateSigma();
+    return(AltFilter.Valid);
+}
+
+const ChannelDesc FusionChannels[4] PROGMEM =
+    {
+    {"FuseAlt",  "m",   CHT_NUMBER, 8, 2, NO_RANGE},
+    {"VertRate", "m/s", CHT_NUMBER, 8, 2, NO_RANGE},
+    {"AltSig",   "m",   CHT_NUMBER, 8, 2, NO_RANGE},
+    {"RateSig",  "m/s", CHT_NUMBER, 8, 2, NO_RANGE},
+    };
+
+// No measurements yet: the filter output means nothing
+uint8_t CFusionSensor::SampleQuality()
+{
+    if (!AltFilter.Valid || !SensorAvailable)
+        return(QUAL_UNAVAILABLE);
+    return(QUAL_FRESH);
+}
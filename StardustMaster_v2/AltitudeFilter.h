@@ -0,0 +1,63 @@
+#ifndef ALTITUDEFILTER_H
+#define ALTITUDEFILTER_H
+
+#include <Arduino.h>
+
+/*********************************************
+ * CAltitudeFilter
+ *
+ * Kalman filter fusing the BMP388 pressure altitude with the GPS
+ * altitude into altitude and vertical rate, with their uncertainty.
+ *
+ * State: altitude h (mm), vertical rate v (mm/s) and the baro bias
+ * b (mm). The baro measures h + b at a high rate; the GPS measures h
+ * whenever it has a fix, which pins down the bias. Constant velocity
+ * model driven by acceleration noise.
+ *
+ * All fixed point so an update is cheap on the 16 MHz AVR: the state
+ * is int32, the covariance is Q16.16 in m, m/s units, and only the
+ * products use 64 bit intermediates. The doubles are only for the
+ * sensor inputs and the log outputs.
+ */
+
+#define FUSION_MAX_DT_MSEC    10000   // longer gaps are clamped
+#define FUSION_BARO_SIGMA     0.5     // m, BMP388 altitude noise with IIR filter
+#define FUSION_GPS_SIGMA      5.0     // m, GPS vertical noise
+#define FUSION_ACCEL_SIGMA    0.5     // m/s^2, unmodelled vertical acceleration
+#define FUSION_BIAS_DRIFT     0.1     // m^2/s, baro bias random walk
+#define FUSION_INIT_ALT_SIGMA 150.0   // m
+#define FUSION_INIT_RATE_SIGMA 10.0   // m/s
+#define FUSION_GPS_GATE       5       // reject GPS more than this many sigma off
+
+class CAltitudeFilter
+{
+public:
+    CAltitudeFilter();
+
+    void BaroUpdate(unsigned long msec, double altMeters);
+    void GpsUpdate(unsigned long msec, double altMeters);
+
+    double Altitude();      // m
+    double VertRate();      // m/s, positive up
+    double AltSigma();      // m
+    double RateSigma();     // m/s
+
+    bool Valid;             // at least one measurement in
+    int32_t AltMm;          // state
+    int32_t RateMmSec;
+    int32_t BiasMm;         // baro minus true altitude
+    unsigned int GpsRejects;    // GPS updates failing the gate
+
+private:
+    void Start(int32_t zMm, unsigned long msec);
+    void Predict(unsigned long msec);
+    bool Correct(int32_t zMm, bool baro, int32_t r, int gate);
+    void Clamp();
+
+    int32_t P[3][3];        // covariance, Q16.16
+    unsigned long LastMsec;
+};
+
+extern CAltitudeFilter AltFilter;
+
+#endif
@@ -0,0 +1,11 @@
+/**************************************************
+ * Arena
+ *
+ * The statically sized log buffers. See Arena.h.
+ * The RAM budget check is with the sensor sets,
+ * near the end of MySensor.cpp
+ *************************************************/
+
+#include "Arena.h"
+
+CArena Arena;
@@ -0,0 +1,60 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "MySensor.h"
+#include "StreamLog.h"
+#include "RecordCrc.h"
+
+/*********************************************
+ * CArena
+ *
+ * The working buffers whose size depends on the sensor set, sized
+ * at compile time from NUM_SENSORS (MySensor.h) instead of as
+ * variable length arrays on the stack:
+ *   - LineBuf, the csv header or data line. Shared by
+ *     WriteCSVHeader and LogDisk, which never overlap.
+ * The drivers the sensors own (OneWire, DallasTemperature, DHT) are
+ * built inside the sensor objects (see DRIVER_STORAGE), so nothing
+ * comes from the heap.
+ *
+ * RAM_BUDGET_BYTES caps the static RAM that grows with the sensor set:
+ * the sensor objects, the arena and, with LOG_STREAMS, the stream
+ * blocks. MySensor.cpp checks it next to the sensor set, so a sensor
+ * that doesn't fit fails the build instead of running the stack into
+ * the heap in flight. The rest of the chip is for the libraries
+ * (SD, GPS, Serial buffers) and the stack.
+ */
+
+// Log line sizes (chars)
+#define LOG_SENSOR_LENGTH   30      // per sensor: 3 values, each 8 chars, plus 3 commas
+#define LOG_QUALITY_LENGTH  (NUM_SENSORS * MAX_SENSOR_CHANNELS + 1)        // one digit per channel, comma
+#define LOG_LINE_LENGTH     ((NUM_SENSORS + 1) * LOG_SENSOR_LENGTH + LOG_QUALITY_LENGTH + 20)    // +1 for timestamps, +20 fudge
+
+#ifdef LOG_STREAMS
+// Stream block lines are at most STREAM_BLOCK_LENGTH plus the B,n,count prefix
+#define MAX_LINE_LENGTH     (LOG_LINE_LENGTH > STREAM_BLOCK_LENGTH + 12 ? LOG_LINE_LENGTH : STREAM_BLOCK_LENGTH + 12)
+#else
+#define MAX_LINE_LENGTH     LOG_LINE_LENGTH
+#endif
+
+#ifdef __AVR__
+#define RAM_BUDGET_BYTES    3072    // of the Mega's 8K
+#else
+#define RAM_BUDGET_BYTES    16384   // of the SAMD21's 32K
+#endif
+
+class CArena
+{
+public:
+    char LineBuf[MAX_LINE_LENGTH + RECORD_TRAILER_LENGTH + 1];     // room to seal it
+};
+
+extern CArena Arena;
+
+#ifdef LOG_STREAMS
+#define ARENA_RAM_BYTES     (sizeof(CArena) + sizeof(CStreamLogger))
+#else
+#define ARENA_RAM_BYTES     (sizeof(CArena))
+#endif
+
+#endif
@@ -0,0 +1,246 @@
+/**************************************************
+ * Bench
+ *
+ * Implementation of CBench, the on-board timing
+ * of the per-sample code. See Bench.h
+ *************************************************/
+
+#include "Bench.h"
+#include "MySensor.h"
+#include "SensorSet.h"
+#include "Config.h"
+#include "Arena.h"
+#include "RecordCrc.h"
+#include <MicroNMEA.h>
+
+#ifdef __AVR__
+extern char __heap_start;
+extern char *__brkval;
+#elif defined(HOST_BUILD)
+#include <unistd.h>
+#else
+extern "C" char *sbrk(int incr);
+#endif
+
+extern MicroNMEA nmea;          // GPSSensor.cpp
+
+// A fix at float altitude, as the SAM-M8Q sends it
+static const char NmeaGGA[] PROGMEM =
+    "$GNGGA,172814.00,4043.4372,N,07359.3158,W,1,08,1.02,15243.7,M,-34.2,M,,*7A\r\n";
+static const char NmeaRMC[] PROGMEM =
+    "$GNRMC,172814.00,A,4043.4372,N,07359.3158,W,12.410,48.52,190626,,,A*6A\r\n";
+
+// Kernel state. The kernels take no arguments
+static int  BenchKey = 0;                       // ConfigLine
+static int  BenchKeys = 0;
+static char BenchField[LOG_FIELD_LENGTH+1];
+static char BenchKeyLines[BENCH_CONFIG_KEYS][CFG_NAME_LENGTH + 20];     // "KEY = value"
+static char BenchLine[CFG_NAME_LENGTH + 20];
+static const char BenchText[] = " 1013.25,  -12.50,   45.0";     // a typical field
+
+static void KBaseline()
+{
+}
+
+// One sensor's fields, the way BuildDataLine formats them. One
+// kernel per sensor class; Sensor is the one being timed
+template<class T> struct KGetLogLine
+{
+    static T *Sensor;
+    static void Run()       { GetLogLine(*Sensor, BenchField); }
+};
+
+template<class T> T *KGetLogLine<T>::Sensor;
+
+static void KBuildDataLine()
+{
+    BuildDataLine(Arena.LineBuf);
+}
+
+static void KDataRecord()
+{
+    BuildDataLine(Arena.LineBuf);
+    RecordCrc.Seal(Arena.LineBuf, sizeof(Arena.LineBuf), RECORD_DATA);
+}
+
+static void KMstrcpy()
+{
+    Mstrcpy(BenchField, (char *)BenchText, sizeof(BenchField));
+}
+
+static void KMstrcat()
+{
+    BenchField[0] = ',';
+    BenchField[1] = 0;
+    Mstrcat(BenchField, (char *)BenchText, sizeof(BenchField));
+}
+
+// LoadThisLine cuts the line up, so each op copies it first,
+// as each ReadLine from the file does
+static void KConfigLine()
+{
+    strcpy(BenchLine, BenchKeyLines[BenchKey]);
+    MyConfig.LoadThisLine(BenchLine);
+    if (++BenchKey >= BenchKeys)
+        BenchKey = 0;
+}
+
+static void Sentence(PGM_P p)
+{
+    char c;
+    while ((c = pgm_read_byte(p++)) != 0)
+        nmea.process(c);
+}
+
+static void KNmeaGGA()
+{
+    Sentence(NmeaGGA);
+}
+
+static void KNmeaRMC()
+{
+    Sentence(NmeaRMC);
+}
+
+CBench::CBench()   // constructor
+{
+    Running = false;
+}
+
+/****************************
+ * GetLogLine kernels
+ * Sensor names are padded for the csv header; the kernel
+ * name drops the padding.
+ */
+struct CBench::LogLineStep
+{
+    template<class T> void operator()(T &sensor, int)
+        {
+        KGetLogLine<T>::Sensor = &sensor;
+        Time(sensor, KGetLogLine<T>::Run);
+        }
+    void Time(CMySensor &sensor, BenchKernel kernel);
+};
+
+void CBench::LogLineStep::Time(CMySensor &sensor, BenchKernel kernel)
+{
+    char name[BENCH_NAME_LENGTH+1];
+    char sensorName[BENCH_NAME_LENGTH+1];
+    char *p = sensorName;
+
+    strncpy_P(sensorName, (PGM_P)sensor.SensorName, BENCH_NAME_LENGTH);
+    sensorName[BENCH_NAME_LENGTH] = 0;
+    while (*p == ' ')
+        p++;
+    strcpy_P(name, PSTR("GetLogLine "));
+    Mstrcat(name, p, sizeof(name));
+    Bench.Time(name, kernel);
+}
+
+void CBench::Run()
+{
+    LogLineStep logLine;
+
+    Serial.print(F("BENCH,start,")); Serial.println(F(SENSOR_SET_NAME));
+    Serial.println(F("BENCH,kernel,ops,ns_per_op,heap_bytes,allocs_per_op"));
+    Time(F("Baseline"), KBaseline);
+    ActiveSensors::ForEach(logLine);
+    Time(F("BuildDataLine"), KBuildDataLine);
+    Time(F("DataRecord"), KDataRecord);
+    Time(F("Mstrcpy"), KMstrcpy);
+    Time(F("Mstrcat"), KMstrcat);
+    BenchKeys = min(MyConfig.NumKeys(), BENCH_CONFIG_KEYS);
+    for (BenchKey = 0; BenchKey < BenchKeys; BenchKey++)
+        MyConfig.FormatKey(BenchKey, BenchKeyLines[BenchKey], sizeof(BenchKeyLines[0]));
+    BenchKey = 0;
+    Time(F("ConfigLine"), KConfigLine);
+#ifdef MICRONMEA_STANDIN
+    // HostTools without the library: nothing of the parser to time
+    Serial.println(F("BENCH,skipped,NmeaGGA NmeaRMC,stand-in MicroNMEA"));
+#else
+    Time(F("NmeaGGA"), KNmeaGGA);
+    Time(F("NmeaRMC"), KNmeaRMC);
+#endif
+    Serial.println(F("BENCH,end"));
+    Serial.flush();
+}
+
+void CBench::Time(const __FlashStringHelper *name, BenchKernel kernel)
+{
+    char buf[BENCH_NAME_LENGTH+1];
+
+    Fstrcpy(buf, name, sizeof(buf));
+    Time(buf, kernel);
+}
+
+/****************************
+ * Time
+ * One op first, to warm up whatever the kernel sets up on first
+ * use, then batches of 1, 2, 4 ... ops until BENCH_MIN_USEC, split
+ * over BENCH_ROUNDS rounds. The fastest round's ns/op is reported.
+ */
+void CBench::Time(const char *name, BenchKernel kernel)
+{
+    unsigned long ops = 0;
+    unsigned long bestNsec = 0;
+
+    Serial.flush();             // no transmit interrupts while timing
+    Running = true;
+    kernel();
+    char *heapStart = HeapTop();
+#ifdef HOST_BUILD
+    unsigned long allocStart = HostShim.Allocs;
+#endif
+    for (int round=0; round < BENCH_ROUNDS; round++)
+        {
+        unsigned long roundOps = 0;
+        unsigned long batch = 1;
+        unsigned long elapsed = 0;
+        unsigned long start = micros();
+        while (elapsed < BENCH_MIN_USEC / BENCH_ROUNDS)
+            {
+            for (unsigned long i=0; i < batch; i++)
+                kernel();
+            roundOps += batch;
+            batch *= 2;
+            elapsed = micros() - start;
+            }
+        // elapsed is under 3 * BENCH_MIN_USEC, so usec * 1000 fits
+        unsigned long nsec = (elapsed * 1000 + roundOps / 2) / roundOps;
+        if ((round == 0) || (nsec < bestNsec))
+            bestNsec = nsec;
+        ops += roundOps;
+        }
+    int heapBytes = HeapTop() - heapStart;
+#ifdef HOST_BUILD
+    unsigned long allocs = HostShim.Allocs - allocStart;
+#endif
+    Running = false;
+
+    Serial.print(F("BENCH,"));
+    Serial.print(name);
+    Serial.print(',');
+    Serial.print(ops);
+    Serial.print(',');
+    Serial.print(bestNsec);
+    Serial.print(',');
+    Serial.print(heapBytes);
+    Serial.print(',');
+#ifdef HOST_BUILD
+    Serial.print((double)allocs / ops, 3);
+#endif
+    Serial.println();
+}
+
+char *CBench::HeapTop()
+{
+#ifdef __AVR__
+    return(__brkval ? __brkval : &__heap_start);
+#elif defined(HOST_BUILD)
+    return((char *)sbrk(0));
+#else
+    return(sbrk(0));
+#endif
+}
+
+CBench Bench;
@@ -0,0 +1,74 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <Arduino.h>
+
+/*********************************************
+ * CBench
+ *
+ * Times the formatting, parsing and logging code that runs every
+ * sample, so a change to it comes with numbers. Two ways to run it:
+ *   - on the board: built with RUN_BENCHMARKS (MySensor.h), setup()
+ *     waits for every sensor, reads them once so there are real
+ *     values to format, runs the suite and stops. Not a flight build.
+ *   - on Linux: HostTools/StarBench links these sources against the
+ *     Arduino shim, fills the sensors with typical values and runs
+ *     the same suite, counting the allocations too.
+ *
+ * Kernels:
+ *   Baseline            an empty call: the loop overhead in every row
+ *   GetLogLine <name>   one sensor's log fields, each sensor in the set
+ *   BuildDataLine       the whole csv row and Quality column (LogDisk)
+ *   DataRecord          BuildDataLine and the RecordCrc seal, no write
+ *   Mstrcpy, Mstrcat    one log field
+ *   ConfigLine          LoadThisLine, every key in turn, current values
+ *   NmeaGGA, NmeaRMC    one sentence through the MicroNMEA parser;
+ *                       skipped with the shim's stand-in MicroNMEA
+ *
+ * Each kernel runs in batches, doubling, until BENCH_MIN_USEC has
+ * gone by. On Linux that is split into BENCH_ROUNDS rounds and the
+ * fastest round's ns/op is the result, so the other programs on the
+ * machine don't show up as regressions. The Serial output is
+ * flushed first so its interrupts stay out of the timing. The ADC,
+ * PPS and timer interrupts still run, as in flight. Events the kernels log (ConfigLine) are sealed but not
+ * written: the card isn't what is being timed.
+ *
+ * Results go to Serial, one csv line per kernel:
+ *   BENCH,kernel,ops,ns_per_op,heap_bytes,allocs_per_op
+ * heap_bytes is how far the top of the heap moved up during the
+ * kernel's run; anything but 0 is a leak or fragmentation.
+ * allocs_per_op is the malloc/realloc/calloc calls per op, on Linux
+ * only (HostShim.Allocs); the cores have no malloc hook, so it is
+ * blank on the board. Compare runs with HostTools/StarBench.
+ */
+
+#define BENCH_MIN_USEC      250000L     // time each kernel runs for
+#ifdef HOST_BUILD
+#define BENCH_ROUNDS        10          // a shared machine: the fastest round counts
+#else
+#define BENCH_ROUNDS        1
+#endif
+#define BENCH_NAME_LENGTH   24
+#define BENCH_CONFIG_KEYS   8           // config lines timed
+
+typedef void (*BenchKernel)();
+
+class CBench
+{
+public:
+    CBench();
+
+    void Run();                     // the whole suite
+
+    bool Running;                   // a kernel is being timed
+
+private:
+    struct LogLineStep;
+    void Time(const char *name, BenchKernel kernel);
+    void Time(const __FlashStringHelper *name, BenchKernel kernel);
+    char *HeapTop();
+};
+
+extern CBench Bench;
+
+#endif
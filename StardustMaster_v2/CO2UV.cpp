@@ -1,5 +1,6 @@
 
 #include "MySensor.h"
+#include "I2CBus.h"
 
 /***************** SCD30 stuff *******************/
 Adafruit_SCD30  scd30;            // I2C 0x61
@@ -17,27 +18,65 @@ VEML6075 uv;
  *************************************/  
 void CCO2Sensor::InitSensor()
 {
+    // Can set longer measurement interval (default 2 sec) to save some power
+    BasePeriodMsec = SCD30_INTERVAL_SEC * 1000L;
+}
+
+// The SCD30 setup is begin(), the measurement interval, then one
+// measurement interval until its first reading; don't log the zeros
+// in the meantime. StartInit talks to nothing; PollInit does one
+// step per call, so loop() keeps sampling the others.
+void CCO2Sensor::StartInit()
+{
+    InitStartMsec = millis();
+    InitErrCode = CO2_NOT_FOUND;
+    InitSensor();
+    SensorAvailable = false;    // until the first measurement is in
+    InitStep = SCD30_INIT_BEGIN;
+    InitState = INIT_WAITING;
+}
+
+bool CCO2Sensor::PollInit()
+{
+    if (InitState != INIT_WAITING) return(true);
+
+    I2CBus.Begin(I2C_DEV_SCD30);
     if (MuxPort != NO_MUX)
         EnableMuxPort(MuxPort);
-        
-    // CO2SENSOR_ADDRESS  is 61
-    if (!scd30.begin()) 
+    switch (InitStep)
         {
-        ErrMsg = "SCD30 CO2 sensor failed to begin";
-        FailSensor(CO2_NOT_FOUND);
-        return;
+        case SCD30_INIT_BEGIN:
+            // CO2SENSOR_ADDRESS  is 61
+            if (scd30.begin())
+                InitStep = SCD30_INIT_INTERVAL;
+            else
+                {
+                ErrMsg = F("SCD30 CO2 sensor failed to begin");
+                FailSensor(CO2_NOT_FOUND);
+                }
+            break;
+        case SCD30_INIT_INTERVAL:
+            if (!scd30.setMeasurementInterval(SCD30_INTERVAL_SEC))
+                {
+                Serial.println(F("SCD30 Failed to set measurement interval"));
+                }
+            //Serial.print(F("Measurement Interval: ")); 
+            //Serial.print(scd30.getMeasurementInterval()); 
+            //Serial.println(F(" seconds"));    
+            InitStep = SCD30_INIT_FIRST;
+            break;
+        case SCD30_INIT_FIRST:
+            if (scd30.dataReady())
+                {
+                SensorAvailable = true;
+                InitState = INIT_READY;
+                }
+            break;
         }
-    // Can set longer measurement interval (default 2 sec) to save some power
-     if (!scd30.setMeasurementInterval(5)){
-         Serial.println("SCD30 Failed to set measurement interval");
-    //   while(1){ delay(10);}
-     }
-    //Serial.print("Measurement Interval: "); 
-    //Serial.print(scd30.getMeasurementInterval()); 
-    //Serial.println(" seconds");    
-
     if (MuxPort != NO_MUX)
         DisableMuxPort(MuxPort);
+    I2CBus.End();
+    return (InitState != INIT_WAITING);
 }
     
 bool CCO2Sensor::ReadSensor()
@@ -46,6 +85,12 @@ bool CCO2Sensor::ReadSensor()
 
     if (!SensorAvailable) return(readOK);
     
+    if (!I2CBus.Begin(I2C_DEV_SCD30))
+        {   // backed off after I2C failures; keep the last values
+        ErrMsg = "";
+        FreshSample = false;
+        return(false);
+        }
     if (MuxPort != NO_MUX)
         EnableMuxPort(MuxPort);
         
@@ -54,50 +99,39 @@ bool CCO2Sensor::ReadSensor()
         { //Data available!
         if (!scd30.read())          
             { 
-            ErrMsg = "Error reading SCD30 CO2 sensor data"; 
+            ErrMsg = F("Error reading SCD30 CO2 sensor data"); 
             readOK = false; 
             }
         else
             { // data should be good
-            scd30Temp = scd30.temperature;    // deg C
-            scd30RH = scd30.relative_humidity;    // %
-            Value =  scd30.CO2;        // in ppm
+            Values[CH_CO2_TEMP] = scd30.temperature;
+            Values[CH_CO2_RH] = scd30.relative_humidity;
+            Values[CH_CO2_PPM] = scd30.CO2;
             } 
         }
     else 
-        {   // no data. Leave data as prev read
-        
+        {   // no data. Leave data as prev read; logged as stale
+        FreshSample = false;
         }
 
     if (MuxPort != NO_MUX)
         DisableMuxPort(MuxPort);
+    if (!I2CBus.End(readOK) && readOK)
+        {
+        ErrMsg = SensorName;
+        ErrMsg += F(" I2C timeout");
+        readOK = false;
+        }
     return (readOK);
 }
 
-void CCO2Sensor::GetHeader(char *buf)
-{
-    strcpy(buf, "  CO2ppm, SCDTemp,   SCDRH");
-}
-
-void CCO2Sensor::GetLogLine(char *buf)
-{
-    char buf2[15];
-    
-    if ((strcmp(ErrMsg.c_str() , "") != 0) || !SensorAvailable)
-        { // err - return empty string
-        strcpy(buf, "        ,        ,        ");  
-        }
-    else
-        { // good read
-        dtostrf(Value,8,2,buf);
-        Mstrcat(buf,",",TheLogger.MAXLOGLINELENGTH);
-        dtostrf(scd30Temp,8,2,buf2);
-        Mstrcat(buf, buf2,TheLogger.MAXLOGLINELENGTH);
-        Mstrcat(buf,",",TheLogger.MAXLOGLINELENGTH);
-        dtostrf(scd30RH,8,2,buf2);
-        Mstrcat(buf, buf2,TheLogger.MAXLOGLINELENGTH);
-        }
-}
+// SCD30 data sheet: 0..40000 ppm, -40..70 degC, 0..100 %RH
+const ChannelDesc CO2Channels[3] PROGMEM =
+    {
+    {"CO2ppm",  "ppm",  CHT_NUMBER, 8, 2, 0.0, 40000.0},
+    {"SCDTemp", "degC", CHT_NUMBER, 8, 2, -40.0, 70.0},
+    {"SCDRH",   "%",    CHT_NUMBER, 8, 2, 0.0, 100.0},
+    };
 
 
 
@@ -106,15 +140,17 @@ void CCO2Sensor::GetLogLine(char *buf)
  **************************************/  
 void CUVSensor::InitSensor()
 {
+    I2CBus.Begin(I2C_DEV_VEML6075);
     if (MuxPort != NO_MUX)
         EnableMuxPort(MuxPort);
         
-    Wire.begin();
-    
     if (! uv.begin()) 
         {
-        ErrMsg = "VEML 6075 sensor failed to initialize";
+        ErrMsg = F("VEML 6075 sensor failed to initialize");
         FailSensor(UV_NOT_FOUND);
+        if (MuxPort != NO_MUX)
+            DisableMuxPort(MuxPort);
+        I2CBus.End();
         return;
         }
     /* Set the integration constant
@@ -139,6 +175,7 @@ void CUVSensor::InitSensor()
     //uv.setAutoForce(veml6075_af_t af);
     if (MuxPort != NO_MUX)
         DisableMuxPort(MuxPort);
+    I2CBus.End();
 }
     
 bool CUVSensor::ReadSensor()
@@ -147,44 +184,38 @@ bool CUVSensor::ReadSensor()
 
     if (!SensorAvailable) return(readOK);
     
+    if (!I2CBus.Begin(I2C_DEV_VEML6075))
+        {   // backed off after I2C failures; keep the last values
+        ErrMsg = "";
+        FreshSample = false;
+        return(false);
+        }
     if (MuxPort != NO_MUX)
         EnableMuxPort(MuxPort);
         
     ErrMsg="";
     
-    UVindex = uv.index();
-    Value = uv.uva();
-    UVB = uv.uvb();
-    //Serial.print("uva,b,i is "); Serial.print(Value,2);Serial.print(UVB,2);Serial.println(UVindex,2);
+    Values[CH_UV_INDEX] = uv.index();
+    Values[CH_UV_UVA] = uv.uva();
+    Values[CH_UV_UVB] = uv.uvb();
 
     if (MuxPort != NO_MUX)
         DisableMuxPort(MuxPort);
+    if (!I2CBus.End(readOK) && readOK)
+        {
+        ErrMsg = SensorName;
+        ErrMsg += F(" I2C timeout");
+        readOK = false;
+        }
     return (readOK);
 }
 
 
-void CUVSensor::GetHeader(char *buf)
-{
-    strcpy(buf, "     UVA,     UVB, UVindex");
-}
-
-void CUVSensor::GetLogLine(char *buf)
-{
-    char buf2[25];
-    
-    if ((strcmp(ErrMsg.c_str() , "") != 0) || !SensorAvailable)
-        { // err - return empty string
-        strcpy(buf, "        ,        ,        ");  
-        }
-    else
-        { // good read
-        dtostrf(Value,8,2,buf);
-        Mstrcat(buf,",",TheLogger.MAXLOGLINELENGTH);
-        dtostrf(UVB,8,2,buf2);
-        Mstrcat(buf,buf2,TheLogger.MAXLOGLINELENGTH);
-        Mstrcat(buf,",",TheLogger.MAXLOGLINELENGTH);
-        dtostrf(UVindex,8,2,buf2);
-        Mstrcat(buf,buf2,TheLogger.MAXLOGLINELENGTH);
-        }
-    
-}
+// The VEML6075 counts can't go negative; a negative value is the
+// library's compensation running off the end
+const ChannelDesc UVChannels[3] PROGMEM =
+    {
+    {"UVA",     "",     CHT_NUMBER, 8, 2, 0.0, 1.0e30},
+    {"UVB",     "",     CHT_NUMBER, 8, 2, 0.0, 1.0e30},
+    {"UVindex", "",     CHT_NUMBER, 8, 2, 0.0, 1.0e30},
+    };
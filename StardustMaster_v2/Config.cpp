@@ -9,6 +9,11 @@
 #include <SdFat.h>
 
 #include "Config.h"
+#include "SystemParameters.h"
+#include "RecordCrc.h"          // Crc16
+#ifdef __AVR__
+#include <avr/eeprom.h>
+#endif
 
 #define DEFAULTSEALEVELPRESSURE_HPA (1013.25)   // if we can't get from Config.txt
 #define DEFAULTDATAFILEMSECBUMP (600000)        // if we can't get from Config.txt
@@ -17,22 +22,42 @@
 
 void CStardustConfig::Init(CBrewmicroSD TheDisk)
 {
+    ConfigStamp stamp;
+    
     SetDefaults();
+    Source = CFG_SOURCE_DEFAULTS;
+    FileKeys = 0;
+
+    // An unchanged file, or no file at all, comes from the cache
+    bool haveFile = StampFile(stamp);
+    if (LoadCache(haveFile ? &stamp : NULL))
+        {
+        Source = CFG_SOURCE_CACHE;
+        if (haveFile)
+            LogMsgF(F("Config:  from EEPROM cache, StardustConfig.txt unchanged"));
+        else
+            LogMsgF(F("Config:  no StardustConfig.txt, from EEPROM cache"));
+        return;
+        }
 
     // load the file
     char *errMsg = TheDisk.OpenFile(CONFIGFILE);
     if (errMsg)
         {
-        TheLogger.LogMsg(errMsg);
+        LogEvent(errMsg);
+        LogMsgF(F("Config:  no StardustConfig.txt or cache, using defaults"));
         }
     else
         { // open OK, read the file
         char line[201];
-        TheLogger.LogMsg("Loading StardustConfig.txt file");
+        LogMsgF(F("Loading StardustConfig.txt file"));
         while (TheDisk.ReadLine(line, 200))   // line is trimmed
             {
             LoadThisLine(line);
             }
+        Source = CFG_SOURCE_FILE;
+        if (haveFile)
+            SaveCache(stamp);
         }
 }
 
@@ -40,53 +65,232 @@ void CStardustConfig::SetDefaults()
 {
     SeaLevelPressure = DEFAULTSEALEVELPRESSURE_HPA;
     DataFileMsecBump = DEFAULTDATAFILEMSECBUMP;
+    PhasePeriodMsec[FLIGHT_PAD] = DEFAULT_PAD_PERIOD;
+    PhasePeriodMsec[FLIGHT_ASCENT] = DEFAULT_ASCENT_PERIOD;
+    PhasePeriodMsec[FLIGHT_FLOAT] = DEFAULT_FLOAT_PERIOD;
+    PhasePeriodMsec[FLIGHT_BURST] = DEFAULT_BURST_PERIOD;
+    PhasePeriodMsec[FLIGHT_DESCENT] = DEFAULT_DESCENT_PERIOD;
 }
 
 
+// Every key, for the file and the console. Names in upper case
+static const ConfigKey ConfigKeys[] PROGMEM =
+    {
+    {SEALEVELPRESSURE, CFG_DOUBLE, &MyConfig.SeaLevelPressure, 0},
+    {DATAFILEMSECBUMP, CFG_LONG, &MyConfig.DataFileMsecBump, 1000},
+    {"PADPERIOD",      CFG_LONG, &MyConfig.PhasePeriodMsec[FLIGHT_PAD], 100},       // keep the loop sane
+    {"ASCENTPERIOD",   CFG_LONG, &MyConfig.PhasePeriodMsec[FLIGHT_ASCENT], 100},
+    {"FLOATPERIOD",    CFG_LONG, &MyConfig.PhasePeriodMsec[FLIGHT_FLOAT], 100},
+    {"BURSTPERIOD",    CFG_LONG, &MyConfig.PhasePeriodMsec[FLIGHT_BURST], 100},
+    {"DESCENTPERIOD",  CFG_LONG, &MyConfig.PhasePeriodMsec[FLIGHT_DESCENT], 100},
+    };
+#define NUM_CONFIG_KEYS   (sizeof(ConfigKeys) / sizeof(ConfigKeys[0]))
+static_assert(NUM_CONFIG_KEYS <= 16, "FileKeys has a bit per config key");
+
 void CStardustConfig::LoadThisLine(char *buf)
 {
-    char logBuf[100];
     if (strlen(buf) == 0)
         return;
     if (buf[0] == '#')
         return;
     
     // OK, we might have a line like SeaLevelPressure  =  101.34
-    String d = strtok(buf, "=");
+    char *key = strtok(buf, "=");
+    char *value = strtok(NULL, "=");
+    if (value)
+        Set(key, value, true);
+}
+
+/****************************
+ * Set
+ * key is trimmed and matched without regard to case. The new
+ * value is logged; the sensors pick up a phase period at the next
+ * loop (FlightPhase::ApplyProfile).
+ */
+int CStardustConfig::Set(char *key, char *value, bool fromFile)
+{
+    String d = key;
     d.trim();
     d.toUpperCase();
-    //debug("d is ",d);
-    if (d == SEALEVELPRESSURE) 
+
+    for (int i=0; i < NUM_CONFIG_KEYS; i++)
         {
-        d = strtok(NULL, "=");
-        SeaLevelPressure = d.toFloat();
+        ConfigKey k;
+        memcpy_P(&k, &ConfigKeys[i], sizeof(k));
+        if (strcmp(d.c_str(), k.Name) != 0) continue;
+        
+        if (k.Type == CFG_DOUBLE)
+            *(double *)k.Value = atof(value);
+        else
+            *(long *)k.Value = max(atol(value), k.Min);
+        if (fromFile)
+            FileKeys |= 1U << i;
 
         // display/log message
-        strcpy(logBuf,"Config:  Loaded ");
-        strcat(logBuf, SEALEVELPRESSURE);
-        strcat(logBuf, " with ");
+        char logBuf[60];
         char tempbuf[15];
-        dtostrf(SeaLevelPressure,8,2,tempbuf);
+        strcpy_P(logBuf, fromFile ? PSTR("Config:  Loaded ") : PSTR("Console: Set "));
+        strcat(logBuf, k.Name);
+        strcat_P(logBuf, PSTR(" with "));
+        FormatValue(k, tempbuf);
         strcat(logBuf, tempbuf);
-        TheLogger.LogMsg(logBuf);
+        LogEvent(logBuf);
+        return(i);
+        }
+    return(-1);
+}
+
+int CStardustConfig::NumKeys()
+{
+    return(NUM_CONFIG_KEYS);
+}
+
+void CStardustConfig::FormatKey(int i, char *buf, int tarLim)
+{
+    ConfigKey k;
+    char tempbuf[15];
+    
+    memcpy_P(&k, &ConfigKeys[i], sizeof(k));
+    Mstrcpy(buf, k.Name, tarLim);
+    Fstrcat(buf, F(" = "), tarLim);
+    FormatValue(k, tempbuf);
+    Mstrcat(buf, tempbuf, tarLim);
+}
+
+void CStardustConfig::FormatValue(const ConfigKey &key, char *buf)
+{
+    if (key.Type == CFG_DOUBLE)
+        dtostrf(*(double *)key.Value, 1, 2, buf);
+    else
+        ltoa(*(long *)key.Value, buf, 10);
+}
+
+
+/****************************
+ * Config cache
+ * Header, then each key's value in table order (sizeof its type),
+ * then the CRC of all of it. Only the FileKeys values are taken back.
+ */
+struct ConfigCacheHeader
+{
+    uint16_t Magic;
+    uint8_t Version;
+    uint8_t NumKeys;
+    uint16_t KeysCrc;               // key names, types and minimums
+    uint16_t FileKeys;              // keys the file set, the ones cached
+    ConfigStamp Stamp;
+};
+#define CFG_CACHE_BYTES  (sizeof(ConfigCacheHeader) + NUM_CONFIG_KEYS * sizeof(double) + 2)
+static_assert(CFG_CACHE_BYTES <= EEPROM_CONFIG_SIZE, "Config cache is over EEPROM_CONFIG_SIZE");
+
+static int ValueSize(const ConfigKey &k)
+{
+    return((k.Type == CFG_DOUBLE) ? sizeof(double) : sizeof(long));
+}
+
+// Stamp from the directory entry, without reading the file
+bool CStardustConfig::StampFile(ConfigStamp &stamp)
+{
+    SdFile file;
+    
+    if (!file.open(CONFIGFILE, O_RDONLY))
+        return(false);
+    stamp.Size = file.fileSize();
+    if (!file.getModifyDateTime(&stamp.Date, &stamp.Time))
+        stamp.Date = stamp.Time = 0;
+    file.close();
+    return(true);
+}
+
+// A cache made from a different key table (names, types or
+// minimums) doesn't load
+uint16_t CStardustConfig::KeysCrc()
+{
+    uint16_t crc = 0xFFFF;
+    
+    for (int i=0; i < NUM_CONFIG_KEYS; i++)
+        {
+        ConfigKey k;
+        memcpy_P(&k, &ConfigKeys[i], sizeof(k));
+        crc = RecordCrc.Crc16(k.Name, strlen(k.Name) + 1, crc);
+        crc = RecordCrc.Crc16((char *)&k.Type, 1, crc);
+        crc = RecordCrc.Crc16((char *)&k.Min, sizeof(k.Min), crc);
         }
-    // OK, we might have a line like DataFileMSecBump  =  600000
-    else if (d == DATAFILEMSECBUMP) 
+    return(crc);
+}
+
+bool CStardustConfig::LoadCache(const ConfigStamp *stamp)
+{
+#ifdef __AVR__
+    uint8_t blob[CFG_CACHE_BYTES];
+    ConfigCacheHeader hdr;
+    
+    eeprom_read_block(&hdr, (const void *)EEPROM_CONFIG_ADDR, sizeof(hdr));
+    if ((hdr.Magic != CFG_CACHE_MAGIC) || (hdr.Version != CFG_CACHE_VERSION) ||
+        (hdr.NumKeys != NUM_CONFIG_KEYS) || (hdr.KeysCrc != KeysCrc()))
+        return(false);
+    if (stamp && ((hdr.Stamp.Size != stamp->Size) || (hdr.Stamp.Date != stamp->Date) ||
+                  (hdr.Stamp.Time != stamp->Time)))
+        return(false);
+
+    // Check the whole block before taking any value from it
+    eeprom_read_block(blob, (const void *)EEPROM_CONFIG_ADDR, sizeof(blob));
+    uint16_t crc;
+    memcpy(&crc, blob + sizeof(blob) - 2, 2);
+    if (RecordCrc.Crc16((char *)blob, sizeof(blob) - 2) != crc)
+        return(false);
+
+    uint8_t *p = blob + sizeof(hdr);
+    for (int i=0; i < NUM_CONFIG_KEYS; i++)
         {
-        d = strtok(NULL, "=");
-        DataFileMsecBump = d.toInt();
+        ConfigKey k;
+        memcpy_P(&k, &ConfigKeys[i], sizeof(k));
+        if (hdr.FileKeys & (1U << i))
+            {
+            memcpy(k.Value, p, ValueSize(k));
+            if (k.Type == CFG_LONG)
+                *(long *)k.Value = max(*(long *)k.Value, k.Min);
+            }
+        p += sizeof(double);
+        }
+    FileKeys = hdr.FileKeys;
+    return(true);
+#else
+    return(false);
+#endif
+}
 
-        // display/log message
-        strcpy(logBuf,"Config:  Loaded ");
-        strcat(logBuf, DATAFILEMSECBUMP);
-        strcat(logBuf, " with ");
-        char tempbuf[15];
-        ltoa(DataFileMsecBump,tempbuf,15);
-        strcat(logBuf, tempbuf);
-        TheLogger.LogMsg(logBuf);
+// eeprom_update_block only writes the bytes that changed
+void CStardustConfig::SaveCache(const ConfigStamp &stamp)
+{
+#ifdef __AVR__
+    uint8_t blob[CFG_CACHE_BYTES];
+    ConfigCacheHeader hdr;
+    
+    memset(blob, 0, sizeof(blob));
+    hdr.Magic = CFG_CACHE_MAGIC;
+    hdr.Version = CFG_CACHE_VERSION;
+    hdr.NumKeys = NUM_CONFIG_KEYS;
+    hdr.KeysCrc = KeysCrc();
+    hdr.FileKeys = FileKeys;
+    hdr.Stamp = stamp;
+    memcpy(blob, &hdr, sizeof(hdr));
+
+    uint8_t *p = blob + sizeof(hdr);
+    for (int i=0; i < NUM_CONFIG_KEYS; i++)
+        {
+        ConfigKey k;
+        memcpy_P(&k, &ConfigKeys[i], sizeof(k));
+        memcpy(p, k.Value, ValueSize(k));
+        p += sizeof(double);
         }
+    uint16_t crc = RecordCrc.Crc16((char *)blob, sizeof(blob) - 2);
+    memcpy(blob + sizeof(blob) - 2, &crc, 2);
+    eeprom_update_block(blob, (void *)EEPROM_CONFIG_ADDR, sizeof(blob));
+    LogMsgF(F("Config:  cached in EEPROM"));
+#endif
 }
 
 
 
-CStardustConfig MyConfig;
+CStardustConfig MyConfig;
@@ -4,34 +4,90 @@
 #include <CACLogger.h>
 extern CLogger TheLogger;
 #include <CACBoardDiff.h>
+#include "FlightPhase.h"
 
 /*************************************************
  * Config class
  *  
  *  This holds various configuration parameters for the
  *  system. These parameters are loaded from the file
- *  Config.txt on the micro-SD disk. If this is missing,
+ *  StardustConfig.txt on the micro-SD disk. If this is missing,
  *  defaults are used.
+ *
+ *  The keys are in one table (ConfigKeys, Config.cpp), shared by
+ *  the file and the serial console's set command (see Console.h).
+ *
+ *  On AVR the parsed values are cached in EEPROM (EEPROM_CONFIG_ADDR,
+ *  SystemParameters.h) with the file's size and modify time, the
+ *  layout version, a CRC of the key table and a CRC of the whole
+ *  block. Only the keys the file set are cached; the rest keep the
+ *  compiled defaults, so a firmware update that changes a default
+ *  takes effect. At boot, if the file's size and time match, the values
+ *  come from the cache and the file isn't parsed. With no file (or
+ *  no card) a valid cache is used rather than the defaults. Where
+ *  the config came from is logged. Console sets aren't cached.
+ *  SAMD has no EEPROM; there the file is parsed every boot.
  */
 
 // define Config tokens here
 // Need to be Upper case
 #define SEALEVELPRESSURE "SEALEVELPRESSURE"
 #define DATAFILEMSECBUMP "DATAFILEMSECBUMP"
+// Phase periods are the phase name + PERIOD, like ASCENTPERIOD
+
+#define CFG_DOUBLE      0
+#define CFG_LONG        1
+#define CFG_NAME_LENGTH 18
+
+#define CFG_CACHE_MAGIC     0x5343    // "SC"
+#define CFG_CACHE_VERSION   2         // bump if the cache layout changes
+
+// Config sources, as logged
+#define CFG_SOURCE_DEFAULTS 0
+#define CFG_SOURCE_FILE     1
+#define CFG_SOURCE_CACHE    2
+
+// Which StardustConfig.txt the cache was made from
+struct ConfigStamp
+{
+    uint32_t Size;
+    uint16_t Date;                  // FAT modify date and time
+    uint16_t Time;
+};
+
+struct ConfigKey
+{
+    char Name[CFG_NAME_LENGTH];     // upper case
+    uint8_t Type;                   // CFG_DOUBLE or CFG_LONG
+    void *Value;
+    long Min;                       // CFG_LONG values are kept at least this
+};
 
 
 class CStardustConfig
 {
     public:
       void Init(CBrewmicroSD TheDisk);     // loads from the file
+      int  Set(char *key, char *value, bool fromFile);   // key's index, -1 if there is no such key
+      int  NumKeys();
+      void FormatKey(int i, char *buf, int tarLim);     // "KEY = value"
+      void LoadThisLine(char *buf);     // one line of the file; cuts buf up
 
       double SeaLevelPressure;
       long DataFileMsecBump;
+      long PhasePeriodMsec[NUM_FLIGHT_PHASES];   // sample period for each flight phase
+      int  Source;                  // CFG_SOURCE_DEFAULTS ..
 
     private:
       void SetDefaults();           // Set defaults before loading file
-      void LoadThisLine(char *buf);
+      bool StampFile(ConfigStamp &stamp);         // false if there is no file
+      bool LoadCache(const ConfigStamp *stamp);   // NULL takes any valid cache
+      void SaveCache(const ConfigStamp &stamp);
+      uint16_t KeysCrc();
+      void FormatValue(const ConfigKey &key, char *buf);
+
+      uint16_t FileKeys;            // keys set by the file, one bit each
 };
 
 extern CStardustConfig MyConfig;
-#endif
+#endif
@@ -0,0 +1,382 @@
+/**************************************************
+ * Console
+ *
+ * Implementation of CConsole, the serial command
+ * interpreter. See Console.h
+ *************************************************/
+
+#include "Console.h"
+#include "SensorSet.h"
+#include "Config.h"
+#include "FlightPhase.h"
+#include "I2CBus.h"
+#include "I2CMux.h"
+#include "IdleSleep.h"
+#include "MemMonitor.h"
+#include "Timebase.h"
+#include "RecordCrc.h"
+#include <Wire.h>
+
+static const char HelpLines[][48] PROGMEM =
+    {
+    "help, sensors, health, timing, config",
+    "set KEY=value   change a config key",
+    "rotate          start the next data file",
+    "scan            I2C devices, direct and mux",
+    };
+#define NUM_HELP_LINES   (sizeof(HelpLines) / sizeof(HelpLines[0]))
+
+static const char InitStateNames[4][8] PROGMEM =
+    {"idle", "waiting", "ready", "failed"};
+
+CConsole::CConsole()   // constructor
+{
+    LoopMicros = 0;
+    LoopMaxMicros = 0;
+    LoopAvgMicros = 0;
+    Loops = 0;
+    RotatePending = false;
+    InLen = 0;
+    OutPos = 0;
+    OutLen = 0;
+    Job = JOB_NONE;
+    JobStep = 0;
+    SliceStart = 0;
+    ScanPort = -1;
+    ScanAddr = 0;
+    LoopStartMicros = 0;
+}
+
+/****************************
+ * Poll
+ * Output first: nothing new starts until the last line is out.
+ */
+void CConsole::Poll()
+{
+#ifdef REPLAY_SENSORS
+    return;         // Serial carries the replayed flight
+#endif
+    SliceStart = micros();
+    while (micros() - SliceStart < CONSOLE_SLICE_USEC)
+        {
+        if (!Drain())
+            return;             // transmit buffer full, go on next time
+        if (Job != JOB_NONE)
+            {
+            if (!NextLine())
+                Job = JOB_NONE;
+            continue;
+            }
+        if (Serial.available() <= 0)
+            return;
+
+        char c = Serial.read();
+        if ((c == '\r') || (c == '\n'))
+            {
+            if (InLen == 0) continue;
+            In[InLen] = 0;
+            InLen = 0;
+            Execute(In);
+            }
+        else if (InLen < CONSOLE_LINE_LENGTH)
+            In[InLen++] = c;
+        }
+}
+
+void CConsole::StartLoop()
+{
+    LoopStartMicros = micros();
+}
+
+void CConsole::EndLoop()
+{
+    LoopMicros = micros() - LoopStartMicros;
+    if (LoopMicros > LoopMaxMicros)
+        LoopMaxMicros = LoopMicros;
+    if (Loops == 0)
+        LoopAvgMicros = LoopMicros;
+    else
+        LoopAvgMicros = (LoopAvgMicros * 15 + LoopMicros) / 16;
+    Loops++;
+}
+
+bool CConsole::Drain()
+{
+    while (OutPos < OutLen)
+        {
+        int room = Serial.availableForWrite();
+        if (room <= 0)
+            return(false);
+        int n = min(room, OutLen - OutPos);
+        Serial.write((const uint8_t *)Out + OutPos, n);
+        OutPos += n;
+        }
+    return(true);
+}
+
+// One line of output from flash
+void CConsole::Say(const __FlashStringHelper *msg)
+{
+    Fstrcpy(Out, msg, CONSOLE_OUT_LENGTH);
+}
+
+void CConsole::Execute(char *cmd)
+{
+    char *word = strtok(cmd, " \t=");
+    char *rest = strtok(NULL, "");
+
+    OutLen = 0;
+    OutPos = 0;
+    Out[0] = 0;
+    if (word == NULL)
+        return;
+    if ((strcasecmp_P(word, PSTR("help")) == 0) || (strcmp_P(word, PSTR("?")) == 0))
+        StartJob(JOB_HELP);
+    else if (strcasecmp_P(word, PSTR("sensors")) == 0)
+        StartJob(JOB_SENSORS);
+    else if (strcasecmp_P(word, PSTR("health")) == 0)
+        StartJob(JOB_HEALTH);
+    else if (strcasecmp_P(word, PSTR("timing")) == 0)
+        StartJob(JOB_TIMING);
+    else if (strcasecmp_P(word, PSTR("config")) == 0)
+        StartJob(JOB_CONFIG);
+    else if (strcasecmp_P(word, PSTR("scan")) == 0)
+        StartJob(JOB_SCAN);
+    else if (strcasecmp_P(word, PSTR("set")) == 0)
+        {   // set KEY=value or set KEY value
+        char *key = rest ? strtok(rest, " \t=") : NULL;
+        char *value = key ? strtok(NULL, " \t=") : NULL;
+        int i = value ? MyConfig.Set(key, value, false) : -1;
+        if (value == NULL)
+            Say(F("usage: set KEY=value"));
+        else if (i >= 0)
+            MyConfig.FormatKey(i, Out, CONSOLE_OUT_LENGTH);
+        else
+            Say(F("no such key, see config"));
+        }
+    else if (strcasecmp_P(word, PSTR("rotate")) == 0)
+        {
+        RotatePending = true;
+        Say(F("next data file starts after this sample"));
+        }
+    else
+        Say(F("unknown command, try help"));
+
+    if (Job == JOB_NONE)
+        {
+        strcat_P(Out, PSTR("\r\n"));
+        OutLen = strlen(Out);
+        }
+}
+
+void CConsole::StartJob(int job)
+{
+    Job = job;
+    JobStep = 0;
+    if (job == JOB_SCAN)
+        {
+        ScanPort = -1;
+        ScanAddr = CONSOLE_SCAN_FIRST;
+        memset(DirectSeen, 0, sizeof(DirectSeen));
+        I2CMux.Deselect();
+        }
+}
+
+// One sensors-job line for the sensor in Column: its name and header,
+// or (Second) its init state, values and Quality
+struct CConsole::SensorLineStep
+{
+    CConsole *Console;
+    int Column;
+    bool Second;
+    
+    template<class T> void operator()(T &sensor, int column)
+        {
+        char values[LOG_FIELD_LENGTH+1];
+        char quality[MAX_SENSOR_CHANNELS+1];
+        
+        if (column != Column) return;
+        if (Second)
+            {
+            GetLogLine(sensor, values);
+            GetQuality(sensor, quality);
+            }
+        Format(sensor, values, quality);
+        }
+    
+    void Format(CMySensor &sensor, char *values, char *quality);
+};
+
+void CConsole::SensorLineStep::Format(CMySensor &sensor, char *values, char *quality)
+{
+    char *out = Console->Out;
+    char buf[LOG_FIELD_LENGTH+1];
+    
+    if (!Second)
+        {
+        strcpy_P(out, (PGM_P)sensor.SensorName);
+        strcat_P(out, PSTR("  "));
+        sensor.GetHeader(buf);
+        Mstrcat(out, buf, CONSOLE_OUT_LENGTH);
+        return;
+        }
+    strcpy_P(out, InitStateNames[sensor.InitState & 3]);
+    while (strlen(out) < 10)
+        strcat_P(out, PSTR(" "));
+    Mstrcat(out, values, CONSOLE_OUT_LENGTH);
+    strcat_P(out, PSTR("  q"));
+    Mstrcat(out, quality, CONSOLE_OUT_LENGTH);
+}
+
+/****************************
+ * NextLine
+ * Puts the job's next line in Out. Returns false when the job
+ * is done.
+ */
+bool CConsole::NextLine()
+{
+    char buf[LOG_FIELD_LENGTH+1];
+    int step = JobStep++;
+
+    Out[0] = 0;
+    switch (Job)
+        {
+        case JOB_HELP:
+            if (step >= NUM_HELP_LINES) return(false);
+            strcpy_P(Out, HelpLines[step]);
+            break;
+
+        case JOB_SENSORS:
+            {   // two lines a sensor: name and header, then state, values and Quality
+            SensorLineStep line;
+            line.Console = this;
+            line.Column = step / 2;
+            line.Second = (step % 2) != 0;
+            if (line.Column >= MaxSensors) return(false);
+            ActiveSensors::ForEach(line);
+            break;
+            }
+
+        case JOB_HEALTH:
+            switch (step)
+                {
+                case 0:
+                    sprintf_P(Out, PSTR("I2C: %u timeouts, %u recoveries, %u back-offs; mux %lu selects, %u retries"),
+                              I2CBus.Timeouts, I2CBus.Recoveries, I2CBus.BackOffs,
+                              I2CMux.SelectOps, I2CMux.Retries);
+                    break;
+                case 1:
+                    MemMonitor.ScanStack();
+                    sprintf_P(Out, PSTR("Mem: stack %u max, %u free; heap %d%% frag"),
+                              MemMonitor.StackMax, MemMonitor.StackFree, MemMonitor.HeapFragPercent);
+                    break;
+                case 2:
+                    strcpy_P(Out, PSTR("Clock: "));
+                    Timebase.FormatUtc(buf);
+                    if (Timebase.Synced)
+                        strcat(Out, buf);
+                    else
+                        strcat_P(Out, PSTR("no GPS time"));
+                    sprintf_P(Out + strlen(Out), PSTR(", offset %ld usec, %u steps"),
+                              Timebase.LastOffsetUsec, Timebase.Steps);
+                    break;
+                case 3:
+                    sprintf_P(Out, PSTR("Records: %lu data, %lu events; phase "),
+                              RecordCrc.DataSeq, RecordCrc.EventSeq);
+                    strcat_P(Out, (PGM_P)FlightPhase.PhaseName(FlightPhase.Phase));
+                    break;
+                default:
+                    return(false);
+                }
+            break;
+
+        case JOB_TIMING:
+            switch (step)
+                {
+                case 0:
+                    sprintf_P(Out, PSTR("Loop: %lu usec last, %lu avg, %lu max, %lu loops"),
+                              LoopMicros, LoopAvgMicros, LoopMaxMicros, Loops);
+                    break;
+                case 1:
+                    sprintf_P(Out, PSTR("Sample period %lu msec, asleep %d%%"),
+                              FlightPhase.SamplePeriodMsec(), IdleSleep.PercentAsleep);
+                    break;
+                case 2:
+                    sprintf_P(Out, PSTR("I2C: %lu usec a loop, %lu saved by fast mode"),
+                              I2CBus.LoopBusMicros, I2CBus.LoopSavedMicros);
+                    break;
+                default:
+                    return(false);
+                }
+            break;
+
+        case JOB_CONFIG:
+            if (step >= MyConfig.NumKeys()) return(false);
+            MyConfig.FormatKey(step, Out, CONSOLE_OUT_LENGTH);
+            break;
+
+        case JOB_SCAN:
+            if (!NextScanLine()) return(false);
+            if (Out[0] == 0) return(true);      // nothing found in this slice
+            break;
+
+        default:
+            return(false);
+        }
+    strcat_P(Out, PSTR("\r\n"));
+    OutPos = 0;
+    OutLen = strlen(Out);
+    return(true);
+}
+
+/****************************
+ * NextScanLine
+ * Probes addresses until one answers or the slice is used up.
+ * Addresses on the direct bus answer on every port too; a port
+ * only lists what is new.
+ */
+bool CConsole::NextScanLine()
+{
+    while (micros() - SliceStart < CONSOLE_SLICE_USEC)
+        {
+        if (ScanPort >= CONSOLE_MUX_PORTS)
+            return(false);      // "scan done" went out
+        if (ScanAddr > CONSOLE_SCAN_LAST)
+            {   // next port
+            ScanAddr = CONSOLE_SCAN_FIRST;
+            if (++ScanPort >= CONSOLE_MUX_PORTS)
+                {
+                I2CMux.Deselect();
+                Say(F("scan done"));
+                return(true);
+                }
+            continue;
+            }
+
+        if (!I2CBus.Begin(I2C_DEV_MUX))
+            {   // backed off; skip the rest of this port
+            ScanAddr = CONSOLE_SCAN_LAST + 1;
+            continue;
+            }
+        if (ScanPort >= 0)
+            I2CMux.Select(ScanPort);
+        uint8_t addr = ScanAddr++;
+        Wire.beginTransmission(addr);
+        bool found = (Wire.endTransmission() == 0);
+        I2CBus.End();
+
+        if (!found) continue;
+        if (ScanPort < 0)
+            DirectSeen[addr / 8] |= 1 << (addr % 8);
+        else if (DirectSeen[addr / 8] & (1 << (addr % 8)))
+            continue;
+        if (ScanPort < 0)
+            sprintf_P(Out, PSTR("direct: 0x%02X"), addr);
+        else
+            sprintf_P(Out, PSTR("port %d: 0x%02X"), ScanPort, addr);
+        return(true);
+        }
+    return(true);
+}
+
+CConsole Console;
@@ -0,0 +1,93 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <Arduino.h>
+
+/*********************************************
+ * CConsole
+ *
+ * Command interpreter on Serial for the bench and pre-flight checks,
+ * 115200 baud, one command per line:
+ *   help                 list the commands
+ *   sensors              latest log fields and Quality digits of each sensor
+ *   health               I2C, mux, memory, clock and record counters
+ *   timing               loop time, sleep and I2C bus time
+ *   config               every config key and its value
+ *   set KEY=value        change a config key, like set ascentperiod=1000
+ *   rotate               start the next data file
+ *   scan                 list the I2C devices on the bus and each mux port
+ *
+ * Poll() never waits. It runs from loop() and from the idle sleep, and
+ * returns within CONSOLE_SLICE_USEC: it takes what has arrived on
+ * Serial, and writes only what the Serial transmit buffer has room
+ * for. Commands that print several lines, and the scan, run as a job,
+ * a line (or a few addresses) at a time, so acquisition never stalls
+ * behind the console.
+ *
+ * rotate only asks for the next data file; loop() starts it between
+ * samples (file creation and the csv header are card writes).
+ *
+ * set goes through the same key table as StardustConfig.txt (see
+ * Config.h), and is logged in the error log like a loaded key.
+ *
+ * With REPLAY_SENSORS, Serial carries the replayed flight; the
+ * console is off.
+ */
+
+#define CONSOLE_LINE_LENGTH   60      // longest command
+#define CONSOLE_OUT_LENGTH    100     // one line of output
+#define CONSOLE_SLICE_USEC    500     // longest one Poll may take
+#define CONSOLE_SCAN_FIRST    0x08    // I2C addresses scanned
+#define CONSOLE_SCAN_LAST     0x77
+#define CONSOLE_MUX_PORTS     8       // TCA9548A
+
+// Commands that print more than one line run as a job
+#define JOB_NONE        0
+#define JOB_HELP        1
+#define JOB_SENSORS     2
+#define JOB_HEALTH      3
+#define JOB_TIMING      4
+#define JOB_CONFIG      5
+#define JOB_SCAN        6
+
+class CConsole
+{
+public:
+    CConsole();
+
+    void Poll();                    // read, run and answer, within CONSOLE_SLICE_USEC
+    void StartLoop();               // loop() timing, at the top of loop()
+    void EndLoop();                 // and before it sleeps
+
+    unsigned long LoopMicros;       // last loop's work
+    unsigned long LoopMaxMicros;    // longest since boot
+    unsigned long LoopAvgMicros;    // running average
+    unsigned long Loops;
+    bool RotatePending;             // rotate asked for; loop() starts the next file
+
+private:
+    void Execute(char *cmd);
+    void StartJob(int job);
+    bool NextLine();                // next line of the job into Out; false when done
+    bool NextScanLine();
+    bool Drain();                   // true once all of Out is written
+    void Say(const __FlashStringHelper *msg);
+    struct SensorLineStep;
+
+    char In[CONSOLE_LINE_LENGTH+1];
+    int  InLen;
+    char Out[CONSOLE_OUT_LENGTH+3]; // room for \r\n
+    int  OutPos;
+    int  OutLen;
+    int  Job;
+    int  JobStep;
+    unsigned long SliceStart;       // micros() when this Poll started
+    int  ScanPort;                  // -1 is the direct bus
+    uint8_t ScanAddr;
+    uint8_t DirectSeen[16];         // addresses on the direct bus, one bit each
+    unsigned long LoopStartMicros;
+};
+
+extern CConsole Console;
+
+#endif
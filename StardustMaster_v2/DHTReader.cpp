@@ -0,0 +1,140 @@
+/**************************************************
+ * DHTReader
+ *
+ * Implementation of CDHTReader, the interrupt
+ * driven DHT22 frame decoder. See DHTReader.h
+ *************************************************/
+
+#include "DHTReader.h"
+
+static CDHTReader *ActiveReader = NULL;     // the reader whose frame is coming
+
+static void DhtIsr()
+{
+    if (ActiveReader)
+        ActiveReader->Edge();
+}
+
+/****************************
+ * ClearPendingEdge
+ * The edge flag latches while the interrupt is off, and AVR
+ * attachInterrupt doesn't clear it: our own start signal pull-down
+ * would be taken as the first edge and shift every bit by one.
+ * The Mega's interrupt numbers aren't its INTn numbers.
+ */
+static void ClearPendingEdge(uint8_t irq)
+{
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+    static const uint8_t flags[] = {INTF4, INTF5, INTF0, INTF1, INTF2, INTF3};
+    if (irq < sizeof(flags))
+        EIFR = _BV(flags[irq]);
+#elif defined(EIFR)
+    if (irq < 2)
+        EIFR = _BV(irq);        // INT0, INT1
+#endif
+}
+
+CDHTReader::CDHTReader()   // constructor
+{
+    Temperature = 0.0;
+    Humidity = 0.0;
+    Failures = 0;
+    Pin = -1;
+    Running = false;
+    StartMsec = 0;
+    Edges = 0;
+    LastEdgeMicros = 0;
+    for (int i=0; i < 5; i++)
+        Data[i] = 0;
+}
+
+bool CDHTReader::Begin(int pin)
+{
+    if (digitalPinToInterrupt(pin) == NOT_AN_INTERRUPT)
+        return(false);
+    Pin = pin;
+    pinMode(Pin, INPUT_PULLUP);     // idle high
+    StartMsec = millis() - DHT_MIN_PERIOD_MSEC;
+    return(true);
+}
+
+bool CDHTReader::Due()
+{
+    return(!Running && (millis() - StartMsec >= DHT_MIN_PERIOD_MSEC));
+}
+
+/****************************
+ * Start
+ * The only wait is the start signal, with interrupts on. The edge
+ * interrupt is armed, with the start signal's own edge cleared,
+ * before the line is let go: the sensor answers 20-40 usec after.
+ */
+bool CDHTReader::Start()
+{
+    if ((Pin < 0) || !Due() || (ActiveReader != NULL)) return(false);
+
+    Edges = 0;
+    for (int i=0; i < 5; i++)
+        Data[i] = 0;
+    ActiveReader = this;
+    Running = true;
+    StartMsec = millis();
+
+    digitalWrite(Pin, LOW);
+    pinMode(Pin, OUTPUT);
+    delayMicroseconds(DHT_START_USEC);
+    LastEdgeMicros = micros();
+    ClearPendingEdge(digitalPinToInterrupt(Pin));
+    attachInterrupt(digitalPinToInterrupt(Pin), DhtIsr, FALLING);
+    pinMode(Pin, INPUT_PULLUP);
+    return(true);
+}
+
+/****************************
+ * Edge
+ * Falling edge: the gap since the last one is a data bit once
+ * the response is past. Edges after the frame are ignored.
+ */
+void CDHTReader::Edge()
+{
+    unsigned long now = micros();
+    uint8_t n = Edges;
+
+    if (n >= DHT_FRAME_EDGES) return;
+    if (n >= 2)
+        {
+        uint8_t bit = n - 2;
+        if (now - LastEdgeMicros > DHT_ONE_USEC)
+            Data[bit / 8] |= 0x80 >> (bit % 8);
+        }
+    LastEdgeMicros = now;
+    Edges = n + 1;
+}
+
+int CDHTReader::Poll()
+{
+    if (!Running) return(DHT_IDLE);
+
+    // The ISR is done with Data once Edges reaches the frame length
+    if (Edges < DHT_FRAME_EDGES)
+        {
+        if (millis() - StartMsec < DHT_TIMEOUT_MSEC)
+            return(DHT_BUSY);
+        }
+    detachInterrupt(digitalPinToInterrupt(Pin));
+    ActiveReader = NULL;
+    Running = false;
+
+    if ((Edges < DHT_FRAME_EDGES) ||
+        ((uint8_t)(Data[0] + Data[1] + Data[2] + Data[3]) != Data[4]))
+        {
+        Failures++;
+        return(DHT_FAILED);
+        }
+
+    Humidity = ((Data[0] << 8) | Data[1]) * 0.1;
+    Temperature = (((Data[2] & 0x7F) << 8) | Data[3]) * 0.1;
+    if (Data[2] & 0x80)
+        Temperature = -Temperature;
+    return(DHT_DONE);
+}
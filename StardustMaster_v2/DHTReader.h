@@ -0,0 +1,69 @@
+#ifndef DHTREADER_H
+#define DHTREADER_H
+
+#include <Arduino.h>
+
+/*********************************************
+ * CDHTReader
+ *
+ * Reads a DHT22 (AM2302) without blocking and without turning
+ * interrupts off. The DHT library bit-bangs the ~5 msec frame with
+ * interrupts masked, which drops GPS and Serial characters.
+ *
+ * Start() pulls the line low for the start signal (DHT_START_USEC,
+ * interrupts on), releases it and arms a FALLING edge interrupt.
+ * The sensor answers with an 80 usec low / 80 usec high, then sends
+ * 40 bits, each a 50 usec low and a 26-28 usec (0) or 70 usec (1)
+ * high. The time from one falling edge to the next is ~77 usec for a
+ * 0 and ~120 usec for a 1, so the ISR only takes micros() and shifts
+ * one bit in. The frame is done after DHT_FRAME_EDGES edges.
+ *
+ * Poll() collects the frame later, from the sensor's ReadSensor: it
+ * checks the checksum and decodes temperature and humidity from the
+ * same frame. A frame that isn't complete DHT_TIMEOUT_MSEC after the
+ * start is a failed read.
+ *
+ * One reader runs a frame at a time (the ISR has no argument).
+ * The pin must have an external interrupt. On the Mega only pins 2,
+ * 3, 18, 19, 20 and 21 do; Begin() returns false on any other pin
+ * and the sensor falls back to the DHT library.
+ */
+
+#define DHT_START_USEC      1100    // start signal, host holds the line low
+#define DHT_MIN_PERIOD_MSEC 2000    // sensor can't be read more often
+#define DHT_TIMEOUT_MSEC    20      // a frame takes ~5 msec
+#define DHT_ONE_USEC        100     // falling edge gap above this is a 1 bit
+#define DHT_FRAME_EDGES     42      // 2 for the response, 40 data bits
+
+// Poll results
+#define DHT_BUSY            0       // frame still coming
+#define DHT_DONE            1       // Temperature and Humidity are new
+#define DHT_FAILED          2       // no answer, short frame or bad checksum
+#define DHT_IDLE            3       // nothing started
+
+class CDHTReader
+{
+public:
+    CDHTReader();
+
+    bool Begin(int pin);            // false if the pin has no interrupt
+    bool Start();                   // send the start signal; false if too soon or another reader is busy
+    int  Poll();                    // DHT_BUSY .. DHT_IDLE
+    bool Due();                     // DHT_MIN_PERIOD_MSEC since the last start
+
+    double Temperature;             // degC
+    double Humidity;                // %RH
+    unsigned int Failures;          // failed frames since boot
+
+    void Edge();                    // from the ISR
+
+private:
+    int  Pin;
+    bool Running;
+    unsigned long StartMsec;
+    volatile uint8_t Edges;
+    volatile unsigned long LastEdgeMicros;
+    volatile uint8_t Data[5];       // humidity (2), temperature (2), checksum
+};
+
+#endif
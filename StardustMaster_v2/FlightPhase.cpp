@@ -0,0 +1,157 @@
+/**************************************************
+ * FlightPhase
+ *
+ * Implementation of CFlightPhase, the flight phase
+ * detector and sampling profile switch.
+ * See FlightPhase.h
+ *************************************************/
+
+#include "FlightPhase.h"
+#include "AltitudeFilter.h"
+#include "SensorSet.h"
+#include "Config.h"
+
+static const char PhaseNames[NUM_FLIGHT_PHASES][8] PROGMEM =
+    {"PAD", "ASCENT", "FLOAT", "BURST", "DESCENT"};
+
+CFlightPhase::CFlightPhase()   // constructor
+{
+    Phase = FLIGHT_PAD;
+    PhaseStartMsec = 0;
+    Transitions = 0;
+    Candidate = FLIGHT_PAD;
+    CandidateMsec = 0;
+    PadAltMm = 0;
+}
+
+const __FlashStringHelper *CFlightPhase::PhaseName(int phase)
+{
+    if ((phase < 0) || (phase >= NUM_FLIGHT_PHASES))
+        return(F("?"));
+    return(FPSTR(PhaseNames[phase]));
+}
+
+unsigned long CFlightPhase::SamplePeriodMsec()
+{
+    return(MyConfig.PhasePeriodMsec[Phase]);
+}
+
+/****************************
+ * Update
+ * Called once per loop. Until the filter has data we stay
+ * on the pad profile.
+ */
+void CFlightPhase::Update(unsigned long msec)
+{
+    if (AltFilter.Valid)
+        {
+        int next = Classify(msec);
+        if (next != Candidate)
+            {   // trend changed, start timing it
+            Candidate = next;
+            CandidateMsec = msec;
+            }
+        if ((Candidate != Phase) && (msec - CandidateMsec >= ConfirmMsec(Candidate)))
+            SwitchTo(Candidate, msec);
+        }
+    ApplyProfile();     // every loop, so late-starting sensors pick it up
+}
+
+int CFlightPhase::Classify(unsigned long msec)
+{
+    int32_t rate = AltFilter.RateMmSec;
+    int32_t alt = AltFilter.AltMm;
+
+    switch (Phase)
+        {
+        case FLIGHT_PAD:
+            if ((rate > ASCENT_RATE_MMS) && (alt - PadAltMm > LAUNCH_CLIMB_M * 1000L))
+                return(FLIGHT_ASCENT);
+            // Latch the pad altitude only while sitting still, so the
+            // baseline doesn't follow a slow climb up
+            if ((Candidate == FLIGHT_PAD) && (abs(rate) < FLOAT_RATE_MMS))
+                PadAltMm = alt;
+            break;
+        case FLIGHT_ASCENT:
+            if (rate < -BURST_RATE_MMS)
+                return(FLIGHT_BURST);
+            if (abs(rate) < FLOAT_RATE_MMS)
+                return(FLIGHT_FLOAT);
+            break;
+        case FLIGHT_FLOAT:
+            if (rate < -BURST_RATE_MMS)
+                return(FLIGHT_BURST);
+            if (rate < -FLOAT_RATE_MMS)
+                return(FLIGHT_DESCENT);
+            if (rate > ASCENT_RATE_MMS)
+                return(FLIGHT_ASCENT);
+            break;
+        case FLIGHT_BURST:
+            if (msec - PhaseStartMsec >= BURST_HOLD_MSEC)
+                return(FLIGHT_DESCENT);
+            break;
+        case FLIGHT_DESCENT:
+            if (abs(rate) < FLOAT_RATE_MMS)
+                return(FLIGHT_PAD);     // landed
+            break;
+        }
+    return(Phase);
+}
+
+unsigned long CFlightPhase::ConfirmMsec(int phase)
+{
+    switch (phase)
+        {
+        case FLIGHT_ASCENT:  return(ASCENT_CONFIRM_MSEC);
+        case FLIGHT_FLOAT:   return(FLOAT_CONFIRM_MSEC);
+        case FLIGHT_BURST:   return(BURST_CONFIRM_MSEC);
+        case FLIGHT_DESCENT: return(Phase == FLIGHT_BURST ? 0 : DESCENT_CONFIRM_MSEC);
+        default:             return(LANDED_CONFIRM_MSEC);
+        }
+}
+
+void CFlightPhase::SwitchTo(int phase, unsigned long msec)
+{
+    char logMsg[90];
+    char buf[15];
+
+    strcpy_P(logMsg, PSTR("Flight phase "));
+    strcat_P(logMsg, (PGM_P)PhaseName(Phase));
+    strcat_P(logMsg, PSTR(" -> "));
+    strcat_P(logMsg, (PGM_P)PhaseName(phase));
+    strcat_P(logMsg, PSTR(" at "));
+    dtostrf(AltFilter.Altitude(), 1, 0, buf);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" m, "));
+    dtostrf(AltFilter.VertRate(), 1, 1, buf);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" m/s, period "));
+    ultoa(MyConfig.PhasePeriodMsec[phase], buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" msec"));
+    LogEvent(logMsg);
+
+    if (phase == FLIGHT_PAD)
+        PadAltMm = AltFilter.AltMm;
+    Phase = phase;
+    PhaseStartMsec = msec;
+    Candidate = phase;
+    Transitions++;
+}
+
+struct PhasePeriodStep
+{
+    unsigned long Period;
+    
+    void operator()(CMySensor &sensor, int)     { sensor.SetPhasePeriod(Period); }
+};
+
+void CFlightPhase::ApplyProfile()
+{
+    PhasePeriodStep step;
+    
+    step.Period = SamplePeriodMsec();
+    ActiveSensors::ForEach(step);
+}
+
+CFlightPhase FlightPhase;
@@ -0,0 +1,89 @@
+#ifndef FLIGHTPHASE_H
+#define FLIGHTPHASE_H
+
+#include <Arduino.h>
+
+/*********************************************
+ * CFlightPhase
+ *
+ * Works out where we are in the flight from the altitude and
+ * vertical rate trends of AltFilter (which runs on the BMP388
+ * pressure, corrected by the GPS), and switches the sampling
+ * profile to match. Each phase has a sample period, from
+ * StardustConfig.txt (PADPERIOD, ASCENTPERIOD, FLOATPERIOD,
+ * BURSTPERIOD, DESCENTPERIOD, in msec):
+ *   - the wide csv row is written once per period
+ *   - with LOG_STREAMS, each sensor is read once per period,
+ *     but never faster than its natural rate
+ *
+ * A new phase has to hold for its confirm time before we switch,
+ * so a gust or a noisy GPS altitude doesn't flip the profile.
+ * Every switch goes to the error/event log.
+ *
+ *   PAD     -> ASCENT   climbing and LAUNCH_CLIMB_M above the pad
+ *                       altitude, latched while the rate was near zero
+ *   ASCENT  -> FLOAT    vertical rate near zero
+ *   ASCENT,
+ *   FLOAT   -> BURST    falling fast
+ *   FLOAT   -> DESCENT  sinking slowly (leaky balloon)
+ *   FLOAT   -> ASCENT   climbing again
+ *   BURST   -> DESCENT  BURST_HOLD_MSEC after burst
+ *   DESCENT -> PAD      vertical rate near zero (landed)
+ */
+
+// Flight phases. Also index the profile table
+#define FLIGHT_PAD          0
+#define FLIGHT_ASCENT       1
+#define FLIGHT_FLOAT        2
+#define FLIGHT_BURST        3
+#define FLIGHT_DESCENT      4
+#define NUM_FLIGHT_PHASES   5
+
+// Default profile periods (msec), if not in StardustConfig.txt
+#define DEFAULT_PAD_PERIOD      10000
+#define DEFAULT_ASCENT_PERIOD   2000
+#define DEFAULT_FLOAT_PERIOD    2000
+#define DEFAULT_BURST_PERIOD    1000
+#define DEFAULT_DESCENT_PERIOD  5000
+
+// Detection thresholds. Rates in mm/s, to match AltFilter
+#define ASCENT_RATE_MMS     1000L     // climbing faster than this
+#define FLOAT_RATE_MMS      500L      // |rate| below this is floating (or landed)
+#define BURST_RATE_MMS      8000L     // falling faster than this is a burst
+#define LAUNCH_CLIMB_M      50L       // above the pad altitude
+
+// Time a new phase must hold before we switch (msec)
+#define ASCENT_CONFIRM_MSEC     30000
+#define FLOAT_CONFIRM_MSEC      300000
+#define BURST_CONFIRM_MSEC      5000
+#define DESCENT_CONFIRM_MSEC    30000
+#define LANDED_CONFIRM_MSEC     300000
+#define BURST_HOLD_MSEC         300000  // burst profile runs this long
+
+class CFlightPhase
+{
+public:
+    CFlightPhase();
+
+    void Update(unsigned long msec);        // feed the latest filter output
+    unsigned long SamplePeriodMsec();       // current profile period
+    const __FlashStringHelper *PhaseName(int phase);
+
+    int  Phase;                     // FLIGHT_PAD .. FLIGHT_DESCENT
+    unsigned long PhaseStartMsec;   // when we entered Phase
+    int  Transitions;               // count of phase switches
+
+private:
+    int  Classify(unsigned long msec);      // phase the trend points to
+    unsigned long ConfirmMsec(int phase);
+    void SwitchTo(int phase, unsigned long msec);
+    void ApplyProfile();
+
+    int  Candidate;                 // phase waiting to be confirmed
+    unsigned long CandidateMsec;    // when Candidate was first seen
+    int32_t PadAltMm;               // altitude last seen sitting on the pad
+};
+
+extern CFlightPhase FlightPhase;
+
+#endif
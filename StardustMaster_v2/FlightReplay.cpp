@@ -0,0 +1,431 @@
+/**************************************************
+ * FlightReplay
+ * 
+ * Implementation of CFlightReplay and the replay stand-in
+ * sensors. See FlightReplay.h
+ *************************************************/
+
+#include "FlightReplay.h"
+#include "SensorSet.h"
+#include "AltitudeFilter.h"
+#include "Timebase.h"
+#include "GpsAiding.h"
+
+#ifdef REPLAY_SENSORS
+
+CFlightReplay::CFlightReplay()   // constructor
+{
+    RecordMsec = 0;
+    RecordCount = 0;
+    Finished = false;
+    NumFields = 0;
+    NextField = REPLAY_FIRST_FIELD;
+    QualityField = -1;
+    StartMsec = 0;
+    FirstRecordMsec = 0;
+}
+
+// The set's columns: every sensor's channels, replayed or computed
+struct ColumnCountStep
+{
+    int Columns;
+
+    void operator()(CMySensor &sensor, int)
+        {
+        Columns += sensor.NumChannels();
+        }
+};
+
+/****************************
+ * NextRecord
+ * 
+ * Reads lines from Serial until a data line arrives. The header
+ * line is checked against the sensor set and skipped.
+ * Returns false if nothing arrived within REPLAY_TIMEOUT_MSEC.
+ */
+bool CFlightReplay::NextRecord()
+{
+    if (Finished) return(false);
+    
+    Serial.setTimeout(REPLAY_TIMEOUT_MSEC);
+    while (true)
+        {
+        size_t len = Serial.readBytesUntil('\n', Line, REPLAY_LINE_LENGTH);
+        if (len == 0)
+            {   // host stopped sending
+            if (RecordCount > 0)
+                {
+                LogSummary();
+                Finished = true;
+                }
+            return(false);
+            }
+        Line[len] = 0;
+        if (Line[len-1] == '\r')
+            Line[len-1] = 0;
+
+        bool isHeader = (strncmp_P(Line, PSTR("Timestamp"), 9) == 0);
+        NumFields = SplitLine();
+        if (isHeader)
+            {
+            char *last = Fields[NumFields-1];
+            while (*last == ' ')
+                last++;
+            QualityField = (strncmp_P(last, PSTR("Quality"), 7) == 0) ? NumFields-1 : -1;
+            ColumnCountStep count;
+            count.Columns = REPLAY_FIRST_FIELD;
+            ActiveSensors::ForEach(count);
+            if (NumFields != count.Columns + (QualityField >= 0 ? 1 : 0))
+                {
+                char logMsg[60];
+                char buf[8];
+                strcpy_P(logMsg, PSTR("Replay: file has "));
+                itoa(NumFields, buf, 10);
+                strcat(logMsg, buf);
+                strcat_P(logMsg, PSTR(" columns, sensor set has "));
+                itoa(count.Columns, buf, 10);
+                strcat(logMsg, buf);
+                LogEvent(logMsg);
+                }
+            continue;
+            }
+        
+        double elapsed;
+        if ((NumFields <= REPLAY_FIRST_FIELD) || !GetField(1, elapsed))
+            continue;       // not a data line
+        
+        RecordMsec = (unsigned long)elapsed;
+        if (RecordCount == 0)
+            {
+            StartMsec = millis();
+            FirstRecordMsec = RecordMsec;
+            }
+        RecordCount++;
+        return(true);
+        }
+}
+
+// Split Line in place at the commas. Blank fields are kept.
+int CFlightReplay::SplitLine()
+{
+    int n = 0;
+    char *p = Line;
+    
+    Fields[n++] = p;
+    while (*p && (n < MAX_REPLAY_FIELDS))
+        {
+        if (*p == ',')
+            {
+            *p = 0;
+            Fields[n++] = p + 1;
+            }
+        p++;
+        }
+    return(n);
+}
+
+int CFlightReplay::ClaimFields(CMySensor *sensor)
+{
+    int first = NextField;
+
+    NextField += sensor->NumChannels();
+    return(first);
+}
+
+bool CFlightReplay::GetField(int index, double &value)
+{
+    if (index >= NumFields) return(false);
+    
+    char *p = Fields[index];
+    while (*p == ' ')
+        p++;
+    if (*p == 0) return(false);     // blank => sensor failed or unavailable
+    value = atof(p);
+    
+    int q = FieldQuality(index);
+    if ((q >= 0) && (q & (QUAL_FAILED | QUAL_UNAVAILABLE))) return(false);
+    return(true);
+}
+
+int CFlightReplay::FieldQuality(int index)
+{
+    if ((QualityField < 0) || (QualityField >= NumFields)) return(-1);
+
+    const char *qual = Fields[QualityField];
+    int channel = index - REPLAY_FIRST_FIELD;
+    if (channel < 0) return(-1);       // the timestamps have no digit
+    if ((int)strlen(qual) <= channel)
+        return(QUAL_UNAVAILABLE);
+    char c = qual[channel];
+    return((c >= 'A') ? c - 'A' + 10 : c - '0');
+}
+
+bool CFlightReplay::GetFields(int first, CMySensor *sensor)
+{
+    ChannelDesc desc;
+    bool ok = true;
+    
+    for (int i=0; i < sensor->NumChannels(); i++)
+        {
+        sensor->GetChannel(i, desc);
+        if (desc.Type == CHT_NUMBER)
+            ok &= GetField(first + i, sensor->Values[i]);
+        }
+    return(ok);
+}
+
+void CFlightReplay::LogSummary()
+{
+    char logMsg[80];
+    char buf[12];
+    
+    strcpy_P(logMsg, PSTR("Replay: "));
+    ltoa(RecordCount, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" records, "));
+    ltoa((RecordMsec - FirstRecordMsec) / 1000, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" sec of flight in "));
+    ltoa(millis() - StartMsec, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" msec"));
+    LogEvent(logMsg);
+    Serial.println(logMsg);
+}
+
+unsigned long FlightMsec()
+{
+    return(FlightReplay.RecordMsec);
+}
+
+CFlightReplay FlightReplay;
+
+
+/**************************************
+ * Replay GPS
+ * Columns: Altitude, Latitude, Longitude
+ * The log doesn't record the fix state. Without a fix the GPS logs
+ * its last position as a stale repeat, so the Quality digit says
+ * which records had one. Files logged before the Quality column
+ * count a fix lost after REPLAY_GPS_REPEATS unchanged positions,
+ * so a receiver sitting still on the pad keeps its fix.
+ * The startup sequence (GpsAiding.h) runs against a stand-in
+ * receiver that logs each step; reset the board partway through a
+ * replay to see the last replayed fix handed back.
+ **************************************/
+class CStandInReceiver: public CGpsReceiver
+{
+public:
+    bool EnableAop()
+        {
+        LogMsgF(F("Stand-in u-blox: AssistNow Autonomous on"));
+        return(true);
+        }
+    bool SaveConfig()
+        {
+        LogMsgF(F("Stand-in u-blox: config saved"));
+        return(true);
+        }
+    bool HasTime()
+        {
+        return(false);      // like a receiver that lost its backup power
+        }
+    bool AidPosition(int32_t lat, int32_t lon, int32_t altCm, uint32_t accCm)
+        {
+        char msg[100];
+        sprintf_P(msg, PSTR("Stand-in u-blox: position %ld, %ld (1e-7 deg), %ld cm, acc %lu cm"),
+                  (long)lat, (long)lon, (long)altCm, (unsigned long)accCm);
+        LogEvent(msg);
+        return(true);
+        }
+    bool AidTime(const GpsAidRecord &rec, uint16_t accSec)
+        {
+        char msg[80];
+        sprintf_P(msg, PSTR("Stand-in u-blox: time %04u-%02u-%02u %02u:%02u:%02u, acc %u s"),
+                  rec.Year, rec.Month, rec.Day, rec.Hour, rec.Minute, rec.Second, accSec);
+        LogEvent(msg);
+        return(true);
+        }
+};
+static CStandInReceiver StandIn;
+
+void CReplayGPSSensor::InitSensor()
+{
+    FirstField = FlightReplay.ClaimFields(this);
+    GpsAiding.Start();
+    while (!GpsAiding.Poll(StandIn))
+        ;       // the stand-in answers at once
+    startFixTime = FlightMsec();
+    GPS_fix = false;
+    Repeats = 0;
+    Values[CH_GPS_ALT] = 0.0;
+    Values[CH_GPS_LAT] = 0.0;
+    Values[CH_GPS_LON] = 0.0;
+}
+
+bool CReplayGPSSensor::ReadSensor()
+{
+    double alt, lat, lon;
+    
+    ErrMsg = "";
+    if (!FlightReplay.GetField(FirstField, alt) || 
+        !FlightReplay.GetField(FirstField+1, lat) ||
+        !FlightReplay.GetField(FirstField+2, lon))
+        {
+        ErrMsg = F("Replay: no GPS data");
+        return(false);
+        }
+    
+    bool valid = (lat != 0.0) || (lon != 0.0);
+    int q = FlightReplay.FieldQuality(FirstField + 1);
+    if (q >= 0)
+        valid = valid && !(q & QUAL_STALE);
+    else
+        {
+        if ((lat == Values[CH_GPS_LAT]) && (lon == Values[CH_GPS_LON]))
+            Repeats++;
+        else
+            Repeats = 0;
+        valid = valid && (Repeats < REPLAY_GPS_REPEATS);
+        }
+    if (valid)
+        {
+        if (!GPS_fix)
+            FixFound();
+        Values[CH_GPS_ALT] = alt;
+        AltFilter.GpsUpdate(FlightMsec(), alt);
+        Values[CH_GPS_LAT] = lat;
+        Values[CH_GPS_LON] = lon;
+        GpsAiding.Fix((int32_t)(lat * 1.0e7), (int32_t)(lon * 1.0e7), (int32_t)(alt * 100.0));
+        }
+    else if (GPS_fix)
+        {
+        FixLost();
+        }
+    return(true);
+}
+
+/**************************************
+ * Replay CO2
+ * Columns: CO2ppm, SCDTemp, SCDRH
+ **************************************/
+void CReplayCO2Sensor::InitSensor()
+{
+    FirstField = FlightReplay.ClaimFields(this);
+}
+
+bool CReplayCO2Sensor::ReadSensor()
+{
+    ErrMsg = "";
+    if (!FlightReplay.GetFields(FirstField, this))
+        {
+        ErrMsg = F("Replay: no CO2 data");
+        return(false);
+        }
+    return(true);
+}
+
+/**************************************
+ * Replay BMP388
+ * Columns: bmpHpa, bmpAlt, bmpTemp
+ **************************************/
+void CReplayBMP388Sensor::InitSensor()
+{
+    FirstField = FlightReplay.ClaimFields(this);
+}
+
+bool CReplayBMP388Sensor::ReadSensor()
+{
+    ErrMsg = "";
+    if (!FlightReplay.GetFields(FirstField, this))
+        {
+        ErrMsg = SensorName;
+        ErrMsg += F(" Failed to perform reading");
+        return(false);
+        }
+    AltFilter.BaroUpdate(FlightMsec(), Values[CH_BMP_ALT]);
+    return(true);
+}
+
+/**************************************
+ * Replay UV
+ * Columns: UVA, UVB, UVindex
+ **************************************/
+void CReplayUVSensor::InitSensor()
+{
+    FirstField = FlightReplay.ClaimFields(this);
+}
+
+bool CReplayUVSensor::ReadSensor()
+{
+    ErrMsg = "";
+    if (!FlightReplay.GetFields(FirstField, this))
+        {
+        ErrMsg = F("Replay: no UV data");
+        return(false);
+        }
+    return(true);
+}
+
+/**************************************
+ * Replay temperature sensors
+ * DHT22 columns:   Temp, HeaterOn, DHTHumid
+ * DS18B20 columns: Temp, HeaterOn
+ * Heater decisions are rerun on the replayed temperature.
+ **************************************/
+void CReplayDHTTempSensor::InitSensor()
+{
+    FirstField = FlightReplay.ClaimFields(this);
+    UseForHeaterControl = false;
+    Values[CH_TEMP_HEATER] = NAN;
+}
+
+bool CReplayDHTTempSensor::ReadSensor()
+{
+    ErrMsg = "";
+    if (!FlightReplay.GetField(FirstField, Values[CH_TEMP]))
+        Values[CH_TEMP] = -273.0;     // same as a failed DHT read
+    if (!FlightReplay.GetField(FirstField+CH_DHT_HUMID, Values[CH_DHT_HUMID]))
+        Values[CH_DHT_HUMID] = 0.0;
+
+    if (UseForHeaterControl)
+        {
+        HeaterControl.HeaterOnOff(Values[CH_TEMP]);
+        }
+    Values[CH_TEMP_HEATER] = UseForHeaterControl ? HeaterControl.HeaterOn : NAN;
+    return(Values[CH_TEMP] > -273.0);
+}
+
+void CReplayDS18BTempSensor::InitSensor()
+{
+    FirstField = FlightReplay.ClaimFields(this);
+    UseForHeaterControl = false;
+    Values[CH_TEMP_HEATER] = NAN;
+}
+
+bool CReplayDS18BTempSensor::ReadSensor()
+{
+    ErrMsg = "";
+    if (!FlightReplay.GetField(FirstField, Values[CH_TEMP]))
+        {
+        ErrMsg = F("Replay: no DS18B data");
+        return(false);
+        }
+
+    if (UseForHeaterControl)
+        {
+        HeaterControl.HeaterOnOff(Values[CH_TEMP]);
+        }
+    Values[CH_TEMP_HEATER] = UseForHeaterControl ? HeaterControl.HeaterOn : NAN;
+    return(true);
+}
+
+#else
+
+// GPS disciplined, see Timebase.h
+unsigned long FlightMsec()
+{
+    return(Timebase.Msec());
+}
+
+#endif
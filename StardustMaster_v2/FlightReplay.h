@@ -0,0 +1,142 @@
+#ifndef FLIGHTREPLAY_H
+#define FLIGHTREPLAY_H
+
+#include "MySensor.h"
+
+/*********************************************
+ * CFlightReplay
+ *
+ * Replays a logged flight through the firmware. Build with
+ * REPLAY_SENSORS selected in MySensor.h, then send a "Star" data
+ * file (the csv written by WriteCSVHeader/LogDisk) over Serial:
+ *
+ *     stty -F /dev/ttyACM0 115200 raw; cat Star0001.csv > /dev/ttyACM0
+ *
+ * or on Linux, without a board: HostTools/StarReplay runs the same
+ * sources against an Arduino shim, and HostTools/test/ReplayTest
+ * replays a logged flight on every "make test".
+ *
+ * Each line becomes one pass through loop(). The stand-in sensors
+ * below take their values from the line instead of the hardware, so
+ * the logging path, the GPS fix tracking and the heater decisions run
+ * on real ascent, burst and descent data. There is no sleep between
+ * records, so a flight replays as fast as the serial link delivers it.
+ *
+ * Time is simulated: FlightMsec() returns the "Elapsed Time" column
+ * (msec) of the current record instead of millis().
+ *
+ * Columns are assigned to sensors in set order, by each
+ * sensor's channel count. The replay sensor set must match the set
+ * the flight was logged with.
+ *
+ * A value whose Quality digit (see QUAL_ in MySensor.h) says failed
+ * or unavailable replays as a failed read, like a blank field in a
+ * file logged before the Quality column.
+ */
+
+#define REPLAY_LINE_LENGTH   300     // longest data line we accept
+#define MAX_REPLAY_FIELDS    40      // Timestamp, Elapsed Time + sensor columns
+#define REPLAY_TIMEOUT_MSEC  5000    // no line for this long => replay done
+#define REPLAY_FIRST_FIELD   2       // sensor columns start after the timestamps
+#define REPLAY_GPS_REPEATS   5       // same position this many records running => no fix
+
+class CFlightReplay
+{
+public:
+    CFlightReplay();
+
+    bool NextRecord();                  // read and split the next data line; false if none
+    int  ClaimFields(CMySensor *sensor);  // first column index for this sensor
+    bool GetField(int index, double &value);  // false if blank, failed or unavailable
+    int  FieldQuality(int index);       // the column's QUAL_ digit, -1 if the file has none
+    bool GetFields(int first, CMySensor *sensor); // every CHT_NUMBER channel into Values[]
+
+    unsigned long RecordMsec;           // Elapsed Time of the current record
+    long RecordCount;
+    bool Finished;
+
+private:
+    int  SplitLine();
+    void LogSummary();
+
+    char Line[REPLAY_LINE_LENGTH+1];
+    char *Fields[MAX_REPLAY_FIELDS];
+    int  NumFields;
+    int  NextField;                     // next unclaimed column
+    int  QualityField;                  // Quality column, -1 if the file has none
+    unsigned long StartMsec;            // millis() at the first record
+    unsigned long FirstRecordMsec;
+};
+
+extern CFlightReplay FlightReplay;
+
+// Clock used for flight timing: replay time when replaying, else millis()
+unsigned long FlightMsec();
+
+
+/*********************************************
+ * Stand-in sensors. Same headers and log lines as the real
+ * sensors; the values come from the replayed record.
+ */
+class CReplayGPSSensor: public CGPSSensor
+{
+public:
+    CReplayGPSSensor(const __FlashStringHelper *name, int pin, int muxport) : CGPSSensor(name, pin, muxport){}
+    void InitSensor();
+    bool ReadSensor();
+private:
+    int FirstField;
+    int Repeats;                        // records the position hasn't moved
+};
+
+class CReplayCO2Sensor: public CCO2Sensor
+{
+public:
+    CReplayCO2Sensor(const __FlashStringHelper *name, int pin, int muxport) : CCO2Sensor(name, pin, muxport){}
+    void InitSensor();
+    bool ReadSensor();
+private:
+    int FirstField;
+};
+
+class CReplayBMP388Sensor: public CBMP388Sensor
+{
+public:
+    CReplayBMP388Sensor(const __FlashStringHelper *name, int pin, int muxport) : CBMP388Sensor(name, pin, muxport){}
+    void InitSensor();
+    bool ReadSensor();
+private:
+    int FirstField;
+};
+
+class CReplayUVSensor: public CUVSensor
+{
+public:
+    CReplayUVSensor(const __FlashStringHelper *name, int pin, int muxport) : CUVSensor(name, pin, muxport){}
+    void InitSensor();
+    bool ReadSensor();
+private:
+    int FirstField;
+};
+
+class CReplayDHTTempSensor: public CDHTTempSensor
+{
+public:
+    CReplayDHTTempSensor(const __FlashStringHelper *name, int pin, int muxport) : CDHTTempSensor(name, pin, muxport){}
+    void InitSensor();
+    bool ReadSensor();
+private:
+    int FirstField;
+};
+
+class CReplayDS18BTempSensor: public CDS18BTempSensor
+{
+public:
+    CReplayDS18BTempSensor(const __FlashStringHelper *name, int pin, int muxport) : CDS18BTempSensor(name, pin, muxport){}
+    void InitSensor();
+    bool ReadSensor();
+private:
+    int FirstField;
+};
+
+#endif
@@ -7,6 +7,12 @@
 ***/
 
 #include "MySensor.h"
+#include "StatusLeds.h"
+#include "FlightReplay.h"
+#include "AltitudeFilter.h"
+#include "I2CBus.h"
+#include "Timebase.h"
+#include "GpsAiding.h"
 #include <Wire.h>
 #include <SparkFun_u-blox_GNSS_Arduino_Library.h> //http://librarymanager/All#SparkFun_u-blox_GNSS
 #include <MicroNMEA.h> //http://librarymanager/All#MicroNMEA
@@ -26,43 +32,121 @@ void SFE_UBLOX_GNSS::processNMEA(char incoming)
   nmea.process(incoming);
 }
 
+/**************************************
+ * CUbloxReceiver
+ * The GPS startup sequence's commands (see GpsAiding.h) on the
+ * u-blox. AssistNow Autonomous is a navigation setting: sent every
+ * boot, and saved with the port settings.
+ **************************************/
+class CUbloxReceiver: public CGpsReceiver
+{
+public:
+    bool EnableAop()
+        {
+        return(myGNSS.setAopCfg(1, 0, GPS_INIT_WAIT_MSEC));     // 0: default orbit error
+        }
+    bool SaveConfig()
+        {
+        return(myGNSS.saveConfigSelective(VAL_CFG_SUBSEC_IOPORT | VAL_CFG_SUBSEC_NAVCONF,
+                                          GPS_INIT_WAIT_MSEC));
+        }
+    bool HasTime()
+        {
+        return(myGNSS.getDateValid(GPS_INIT_WAIT_MSEC) && myGNSS.getTimeValid(GPS_INIT_WAIT_MSEC));
+        }
+    bool AidPosition(int32_t lat, int32_t lon, int32_t altCm, uint32_t accCm)
+        {
+        return(myGNSS.setPositionAssistanceLLH(lat, lon, altCm, accCm, GPS_INIT_WAIT_MSEC));
+        }
+    bool AidTime(const GpsAidRecord &rec, uint16_t accSec)
+        {
+        return(myGNSS.setUTCTimeAssistance(rec.Year, rec.Month, rec.Day, rec.Hour,
+                                           rec.Minute, rec.Second, 0, accSec, 0, 0,
+                                           GPS_INIT_WAIT_MSEC));
+        }
+};
+static CUbloxReceiver Ublox;
+
 /**************************************
  * GPS Sensor 
  **************************************/  
 void CGPSSensor::InitSensor()
 {
-    //EnableMuxPort(MuxPort);
-        
-    pinMode(GPS_FIX_ON, OUTPUT);      // LED for indicating a fix has been established
-    digitalWrite(GPS_FIX_ON, LOW);
+    StatusLeds.SetLed(LEDBIT_FIX, false);     // LED for indicating a fix has been established
     
-    Wire.begin();
-    
-    if (myGNSS.begin() == false)
-        {
-        ErrMsg = "u-blox GNSS not detected at default I2C address 0x42. Please check wiring.";
-        FailSensor(GPS_NOT_FOUND);
-        //DisableMuxPort(MuxPort);
-        return;  
-        }
+    GPS_fix = false;
+    startFixTime = FlightMsec();
+    BasePeriodMsec = GPS_PERIOD_MSEC;
 
-    myGNSS.setI2COutput(COM_TYPE_UBX | COM_TYPE_NMEA); //Set the I2C port to output both NMEA and UBX messages
-    myGNSS.saveConfigSelective(VAL_CFG_SUBSEC_IOPORT); //Save (only) the communications port settings to flash and BBR
-  
-    myGNSS.setProcessNMEAMask(SFE_UBLOX_FILTER_NMEA_ALL); // Make sure the library is passing all NMEA messages to processNMEA
-    //myGNSS.setProcessNMEAMask(SFE_UBLOX_FILTER_NMEA_GGA); // Or, we can be kind to MicroNMEA and _only_ pass the GGA messages to it
+    Values[CH_GPS_ALT] = 0.0;
+    Values[CH_GPS_LAT] = 0.0;
+    Values[CH_GPS_LON] = 0.0;
+}
 
-    // Set the Dynamic Model? to typical 2g Airborne model rather than Portable 2D model low acceleration
-    //bool myGNSS.setDynamicModel(DYN_MODEL_AIRBORNE2g);
-    
-    GPS_fix = false;
-    startFixTime = millis();
+// The u-blox setup is a string of commands, each waiting up to
+// GPS_INIT_WAIT_MSEC for the receiver's answer. PollInit sends
+// one step per call, so the other sensors and sampling don't wait
+// on the lot. begin() is only tried once the receiver ACKs its
+// address, so a missing one costs a probe, not a full wait, and
+// the tries are GPS_INIT_RETRY_MSEC apart.
+void CGPSSensor::StartInit()
+{
+    InitStartMsec = millis();
+    InitErrCode = GPS_NOT_FOUND;
+    InitSensor();
+    SensorAvailable = false;    // until the receiver is set up
+    InitStep = GPS_INIT_BEGIN;
+    InitTries = 0;
+    InitRetryMsec = millis();
+    InitState = INIT_WAITING;
+}
 
-    Value = 0.0;    // Value is altitude      
-    Latitude = 0.0;
-    Longitude = 0.0;
- 
-    //DisableMuxPort(MuxPort);
+bool CGPSSensor::PollInit()
+{
+    if (InitState != INIT_WAITING) return(true);
+    if ((InitStep == GPS_INIT_BEGIN) && ((long)(millis() - InitRetryMsec) < 0))
+        return(false);      // not time for the next try
+
+    I2CBus.Begin(I2C_DEV_UBLOX);
+    switch (InitStep)
+        {
+        case GPS_INIT_BEGIN:
+            {
+            Wire.beginTransmission(GPS_ADDRESS);
+            bool found = (Wire.endTransmission() == 0);
+            if (found && myGNSS.begin(Wire, GPS_ADDRESS, GPS_INIT_WAIT_MSEC))
+                InitStep = GPS_INIT_OUTPUT;
+            else if (++InitTries >= GPS_INIT_TRIES)
+                {
+                I2CBus.End();
+                ErrMsg = F("u-blox GNSS not detected at default I2C address 0x42. Please check wiring.");
+                FailSensor(GPS_NOT_FOUND);
+                return(true);
+                }
+            else
+                InitRetryMsec = millis() + GPS_INIT_RETRY_MSEC;
+            }
+            break;
+        case GPS_INIT_OUTPUT:
+            myGNSS.setI2COutput(COM_TYPE_UBX | COM_TYPE_NMEA, GPS_INIT_WAIT_MSEC); //Set the I2C port to output both NMEA and UBX messages
+            myGNSS.setProcessNMEAMask(SFE_UBLOX_FILTER_NMEA_ALL); // Make sure the library is passing all NMEA messages to processNMEA
+            //myGNSS.setProcessNMEAMask(SFE_UBLOX_FILTER_NMEA_GGA); // Or, we can be kind to MicroNMEA and _only_ pass the GGA messages to it
+
+            // Set the Dynamic Model? to typical 2g Airborne model rather than Portable 2D model low acceleration
+            //bool myGNSS.setDynamicModel(DYN_MODEL_AIRBORNE2g);
+            GpsAiding.Start();
+            InitStep = GPS_INIT_AIDING;
+            break;
+        case GPS_INIT_AIDING:
+            if (GpsAiding.Poll(Ublox))     // saves the port settings once, hands back the last fix
+                {
+                SensorAvailable = true;
+                InitState = INIT_READY;
+                }
+            break;
+        }
+    I2CBus.End();
+    return(InitState != INIT_WAITING);
 }
 
 /********************************
@@ -79,72 +163,95 @@ bool CGPSSensor::ReadSensor()
     //EnableMuxPort(MuxPort);
         
     ErrMsg="";
-    // checking timing to get a fix
-    double fixMinutes = 0.0;    // num minutes to find or lose fix
-    char logMsg[TheLogger.MAXLOGLINELENGTH+1];       // use for logging to error log
-    char buf[15];           // buffer for number conversions
                     
+    if (!I2CBus.Begin(I2C_DEV_UBLOX))
+        {   // backed off after I2C failures; keep the last values
+        ErrMsg = "";
+        FreshSample = false;
+        return(false);
+        }
     myGNSS.checkUblox(); //See if new data is available. Process bytes as they come in.
     if(nmea.isValid() == true)      // is fix valid
         {
-        digitalWrite(GPS_FIX_ON, HIGH);
         if ((!GPS_fix) && (myGNSS.getFixType() > 0))
             {  
-            GPS_fix = true;
-            strcpy(logMsg, "Established fix in"); 
-            fixMinutes = (millis() - startFixTime) / 1000.0 / 60.0;     // convert msec to minutes
-            dtostrf(fixMinutes,8,1,buf);
-            strcat(logMsg, buf);
-            strcat(logMsg," minutes");
-            TheLogger.LogMsg(logMsg);
-            startFixTime = millis();
+            FixFound();
             }
-        Latitude = nmea.getLatitude() / 1000000.;    // in millionths of deg
-        Longitude = nmea.getLongitude() / 1000000.;
+        StatusLeds.SetLed(LEDBIT_FIX, true);
+        Timebase.GpsTime(nmea.getYear(), nmea.getMonth(), nmea.getDay(), nmea.getHour(),
+                         nmea.getMinute(), nmea.getSecond(), nmea.getHundredths());
+        Values[CH_GPS_LAT] = nmea.getLatitude() / 1000000.;    // in millionths of deg
+        Values[CH_GPS_LON] = nmea.getLongitude() / 1000000.;
         long alt_temp = 0;
         if (nmea.getAltitude(alt_temp))      // in mm
             { // altitude was no good for some reason
-            Value = alt_temp / 1000.0;
+            Values[CH_GPS_ALT] = alt_temp / 1000.0;
+            AltFilter.GpsUpdate(FlightMsec(), Values[CH_GPS_ALT]);
             }
+        GpsAiding.Time(nmea.getYear(), nmea.getMonth(), nmea.getDay(),
+                       nmea.getHour(), nmea.getMinute(), nmea.getSecond());
+        GpsAiding.Fix(nmea.getLatitude() * 10, nmea.getLongitude() * 10,       // 1e-7 deg
+                      (int32_t)(Values[CH_GPS_ALT] * 100.0));
         }
-    else if (myGNSS.getFixType() == 0)
-        {   // no fix
-        digitalWrite(GPS_FIX_ON, LOW);
-        GPS_fix = false;
-        strcpy(logMsg, "Lost fix in"); 
-        fixMinutes = (millis() - startFixTime) / 1000.0 / 60.0;
-        dtostrf(fixMinutes,8,1,buf);
-        strcat(logMsg, buf);
-        strcat(logMsg," minutes");
-        TheLogger.LogMsg(logMsg);
-        startFixTime = millis();
+    else
+        {   // no fix: the position is the last one we had
+        FreshSample = false;
+        if (GPS_fix && (myGNSS.getFixType() == 0))
+            FixLost();
+        }
+    if (!I2CBus.End(readOK) && readOK)
+        {
+        ErrMsg = SensorName;
+        ErrMsg += F(" I2C timeout");
+        readOK = false;
         }
 
     //DisableMuxPort(MuxPort);
     return (readOK);
 }
 
-void CGPSSensor::GetHeader(char *buf)
+/********************************
+ * FixFound / FixLost
+ * 
+ * Fix tracking: sets the fix LED and logs how long it took
+ * to find (or lose) the fix. Shared with the replay GPS.
+ */
+void CGPSSensor::FixFound()
 {
-    strcpy(buf, "Altitude,  Latitude, Longitude");
+    char logMsg[50];        // use for logging to error log
+    char buf[15];           // buffer for number conversions
+    
+    StatusLeds.SetLed(LEDBIT_FIX, true);
+    GPS_fix = true;
+    strcpy_P(logMsg, PSTR("Established fix in")); 
+    double fixMinutes = (FlightMsec() - startFixTime) / 1000.0 / 60.0;     // convert msec to minutes
+    dtostrf(fixMinutes,8,1,buf);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" minutes"));
+    LogEvent(logMsg);
+    GpsAiding.LogFirstFix();
+    startFixTime = FlightMsec();
 }
 
-void CGPSSensor::GetLogLine(char *buf)
+void CGPSSensor::FixLost()
 {
-    char buf2[15];
+    char logMsg[50];        // use for logging to error log
+    char buf[15];           // buffer for number conversions
     
-    if ((strcmp(ErrMsg.c_str() , "") != 0) || !SensorAvailable)
-        { // err - return empty string
-        strcpy(buf, "        ,          ,          ");  
-        }
-    else
-        { // good read
-        dtostrf(Value,8,1,buf);
-        Mstrcat(buf,",",TheLogger.MAXLOGLINELENGTH);
-        dtostrf(Latitude,10,6,buf2);
-        Mstrcat(buf, buf2,TheLogger.MAXLOGLINELENGTH);
-        Mstrcat(buf,",",TheLogger.MAXLOGLINELENGTH);
-        dtostrf(Longitude,10,6,buf2);
-        Mstrcat(buf, buf2,TheLogger.MAXLOGLINELENGTH);
-        }
-}
+    StatusLeds.SetLed(LEDBIT_FIX, false);
+    GPS_fix = false;
+    strcpy_P(logMsg, PSTR("Lost fix in")); 
+    double fixMinutes = (FlightMsec() - startFixTime) / 1000.0 / 60.0;
+    dtostrf(fixMinutes,8,1,buf);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" minutes"));
+    LogEvent(logMsg);
+    startFixTime = FlightMsec();
+}
+
+const ChannelDesc GPSChannels[3] PROGMEM =
+    {
+    {"Altitude",  "m",   CHT_NUMBER, 8, 1, NO_RANGE},
+    {"Latitude",  "deg", CHT_NUMBER, 10, 6, -90.0, 90.0},
+    {"Longitude", "deg", CHT_NUMBER, 10, 6, -180.0, 180.0},
+    };
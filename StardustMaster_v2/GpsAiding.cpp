@@ -0,0 +1,227 @@
+/**************************************************
+ * GpsAiding
+ *
+ * Implementation of CGpsAiding, the last fix kept
+ * across resets. See GpsAiding.h
+ *************************************************/
+
+#include "GpsAiding.h"
+#include "MySensor.h"           // REPLAY_SENSORS
+#include "FlightReplay.h"       // FlightMsec
+#include "RecordCrc.h"          // Crc16
+#include "Timebase.h"           // DaysFromCivil
+#include <stddef.h>
+#if defined(__AVR__) || defined(HOST_BUILD)    // HostTools: the shim's EEPROM
+#define GPS_AID_EEPROM
+#include <avr/eeprom.h>
+#endif
+
+static_assert(sizeof(GpsAidRecord) <= EEPROM_GPS_SIZE, "GpsAidRecord is over EEPROM_GPS_SIZE");
+
+#define GPS_AID_CRC_BYTES   offsetof(GpsAidRecord, Crc)
+#ifdef REPLAY_SENSORS
+#define AID_MAGIC   GPS_AID_REPLAY_MAGIC
+#else
+#define AID_MAGIC   GPS_AID_MAGIC
+#endif
+
+CGpsAiding::CGpsAiding()   // constructor
+{
+    memset(&Rec, 0, sizeof(Rec));
+    Aided = 0;
+    HaveFix = false;
+    FirstLogged = false;
+    SaveMsec = 0;
+    StartMsec = 0;
+    AgeSec = -1;
+    Step = GPS_AID_STEP_DONE;
+}
+
+// Appends the steps in flags, like " position aided, config saved"
+static void AppendSteps(char *msg, uint8_t flags)
+{
+    bool first = true;
+
+    if (flags == 0)
+        {
+        strcat_P(msg, PSTR(" no aiding"));
+        return;
+        }
+    if (flags & GPS_AID_FIX)
+        {
+        strcat_P(msg, PSTR(" position aided"));
+        first = false;
+        }
+    if (flags & GPS_AID_TIME)
+        {
+        strcat_P(msg, first ? PSTR(" time aided") : PSTR(", time aided"));
+        first = false;
+        }
+    if (flags & GPS_AID_RX_TIME)
+        {
+        strcat_P(msg, first ? PSTR(" receiver kept time") : PSTR(", receiver kept time"));
+        first = false;
+        }
+    if (flags & GPS_AID_CONFIG)
+        {
+        strcat_P(msg, first ? PSTR(" config saved") : PSTR(", config saved"));
+        first = false;
+        }
+    if (flags & GPS_AID_STALE)
+        strcat_P(msg, first ? PSTR(" last fix too old") : PSTR(", last fix too old"));
+}
+
+// rec's UTC moved on by sec
+static void AddSeconds(GpsAidRecord &rec, long sec)
+{
+    int y, m, d;
+    long days = DaysFromCivil(rec.Year, rec.Month, rec.Day);
+    long secOfDay = (rec.Hour * 60L + rec.Minute) * 60L + rec.Second + sec;
+
+    days += secOfDay / 86400L;
+    secOfDay %= 86400L;
+    CivilFromDays(days, y, m, d);
+    rec.Year = y;
+    rec.Month = m;
+    rec.Day = d;
+    rec.Hour = secOfDay / 3600;
+    rec.Minute = secOfDay / 60 % 60;
+    rec.Second = secOfDay % 60;
+}
+
+void CGpsAiding::Start()
+{
+    Aided = 0;
+    HaveFix = false;
+    FirstLogged = false;
+    StartMsec = FlightMsec();
+    if (!Load())
+        memset(&Rec, 0, sizeof(Rec));
+
+    uint32_t now;
+    AgeSec = -1;
+    if (Rec.SavedRtc && RtcUnixTime(now) && (now >= Rec.SavedRtc) &&
+        (now - Rec.SavedRtc <= (uint32_t)GPS_AID_MAX_AGE_SEC))
+        AgeSec = now - Rec.SavedRtc;
+    else if (Rec.Flags & (GPS_AID_FIX | GPS_AID_TIME))
+        Aided |= GPS_AID_STALE;
+    Step = GPS_AID_STEP_AOP;
+}
+
+/****************************
+ * Poll
+ * Time goes to the receiver before position, as u-blox asks.
+ */
+bool CGpsAiding::Poll(CGpsReceiver &receiver)
+{
+    char msg[80];
+
+    switch (Step)
+        {
+        case GPS_AID_STEP_AOP:
+            receiver.EnableAop();
+            Step = GPS_AID_STEP_TIME;
+            return(false);
+        case GPS_AID_STEP_TIME:
+            if (receiver.HasTime())
+                Aided |= GPS_AID_RX_TIME;
+            else if ((Rec.Flags & GPS_AID_TIME) && (AgeSec >= 0))
+                {
+                GpsAidRecord now = Rec;
+                AddSeconds(now, AgeSec);
+                if (receiver.AidTime(now, GPS_AID_TIME_ACC_SEC))
+                    Aided |= GPS_AID_TIME;
+                }
+            Step = GPS_AID_STEP_CONFIG;
+            return(false);
+        case GPS_AID_STEP_CONFIG:
+            // No time means the backup RAM, and the config in it, was lost
+            if ((!(Rec.Flags & GPS_AID_CONFIG) || !(Aided & GPS_AID_RX_TIME)) &&
+                receiver.SaveConfig())
+                {
+                Rec.Flags |= GPS_AID_CONFIG;
+                Aided |= GPS_AID_CONFIG;
+                Save();
+                }
+            Step = GPS_AID_STEP_POSITION;
+            return(false);
+        case GPS_AID_STEP_POSITION:
+            if ((Rec.Flags & GPS_AID_FIX) && (AgeSec >= 0) &&
+                receiver.AidPosition(Rec.Lat, Rec.Lon, Rec.AltCm,
+                                     GPS_AID_POS_ACC_CM + AgeSec * GPS_AID_DRIFT_CMS))
+                Aided |= GPS_AID_FIX;
+            Step = GPS_AID_STEP_DONE;
+            strcpy_P(msg, PSTR("GPS start:"));
+            AppendSteps(msg, Aided);
+            LogEvent(msg);
+            break;
+        }
+    return(true);
+}
+
+void CGpsAiding::Fix(int32_t lat, int32_t lon, int32_t altCm)
+{
+    Rec.Lat = lat;
+    Rec.Lon = lon;
+    Rec.AltCm = altCm;
+    Rec.Flags |= GPS_AID_FIX;
+    if (!HaveFix || (FlightMsec() - SaveMsec >= GPS_AID_SAVE_MSEC))
+        Save();
+    HaveFix = true;
+}
+
+// Saved with the next Fix
+void CGpsAiding::Time(uint16_t year, uint8_t month, uint8_t day,
+                      uint8_t hour, uint8_t minute, uint8_t second)
+{
+    Rec.Year = year;
+    Rec.Month = month;
+    Rec.Day = day;
+    Rec.Hour = hour;
+    Rec.Minute = minute;
+    Rec.Second = second;
+    Rec.Flags |= GPS_AID_TIME;
+}
+
+void CGpsAiding::LogFirstFix()
+{
+    unsigned long msec = FlightMsec() - StartMsec;
+    char msg[80];
+    char buf[15];
+
+    if (FirstLogged) return;
+    FirstLogged = true;
+    strcpy_P(msg, PSTR("GPS first fix in "));
+    dtostrf(msec / 1000.0, 1, 1, buf);
+    strcat(msg, buf);
+    strcat_P(msg, PSTR(" s:"));
+    AppendSteps(msg, Aided);
+    LogEvent(msg);
+}
+
+bool CGpsAiding::Load()
+{
+#ifdef GPS_AID_EEPROM
+    eeprom_read_block(&Rec, (const void *)EEPROM_GPS_ADDR, sizeof(Rec));
+    return((Rec.Magic == AID_MAGIC) && (Rec.Version == GPS_AID_VERSION) &&
+           (RecordCrc.Crc16((char *)&Rec, GPS_AID_CRC_BYTES) == Rec.Crc));
+#else
+    return(false);
+#endif
+}
+
+// eeprom_update_block only writes the bytes that changed
+void CGpsAiding::Save()
+{
+    SaveMsec = FlightMsec();
+    if (!RtcUnixTime(Rec.SavedRtc))
+        Rec.SavedRtc = 0;       // age unknown: not handed back
+#ifdef GPS_AID_EEPROM
+    Rec.Magic = AID_MAGIC;
+    Rec.Version = GPS_AID_VERSION;
+    Rec.Crc = RecordCrc.Crc16((char *)&Rec, GPS_AID_CRC_BYTES);
+    eeprom_update_block(&Rec, (void *)EEPROM_GPS_ADDR, sizeof(Rec));
+#endif
+}
+
+CGpsAiding GpsAiding;
@@ -0,0 +1,135 @@
+#ifndef GPSAIDING_H
+#define GPSAIDING_H
+
+#include <Arduino.h>
+
+/*********************************************
+ * CGpsAiding
+ *
+ * Shortens the time to first fix after a reset. The last fix
+ * (position, altitude, UTC) is kept in EEPROM (EEPROM_GPS_ADDR,
+ * SystemParameters.h) and handed back to the receiver at the next
+ * start, so a power glitch on the pad or in flight isn't a cold
+ * start.
+ *
+ * Start() loads the record; Poll() then runs the receiver's startup
+ * sequence, one receiver command per call so it can go out from
+ * the GPS sensor's PollInit without holding up sampling:
+ *   1. AssistNow Autonomous (the receiver predicts the orbits itself
+ *      and keeps them in its battery backed RAM with the ephemeris)
+ *      is turned on, every boot.
+ *   2. If the receiver lost its own time (no backup power), the
+ *      saved UTC, moved on by the record's age, goes back as time
+ *      aiding with GPS_AID_TIME_ACC_SEC accuracy.
+ *   3. The port and navigation config is saved to the receiver's
+ *      backup RAM once; the record remembers it was done. A receiver
+ *      that lost its time lost that RAM too, and is saved to again.
+ *   4. The saved position goes back as position aiding. Its
+ *      accuracy is GPS_AID_POS_ACC_CM, widened by GPS_AID_DRIFT_CMS
+ *      for each second of the record's age: the balloon (or the
+ *      next launch site) may be a long way off.
+ * The record's age comes from the logger's RTC, stamped at each
+ * save. A record older than GPS_AID_MAX_AGE_SEC, or of unknown age
+ * (RTC not running, or behind the stamp), isn't handed back: wrong
+ * aiding with too tight an accuracy delays the fix.
+ * The receiver keeps the rest of its navigation state (ephemeris,
+ * almanac, orbit predictions) in its own backup RAM; the SAM-M8Q
+ * has no flash to save it to.
+ *
+ * Fix() takes each good fix; the record is written at the first
+ * fix and every GPS_AID_SAVE_MSEC after (eeprom_update_block, to
+ * spare the EEPROM). The time to first fix and the aiding given are
+ * logged by LogFirstFix().
+ *
+ * The receiver is reached through CGpsReceiver: the u-blox one in
+ * GPSSensor.cpp, and in replay builds a stand-in (FlightReplay.cpp)
+ * that logs each step, so the startup sequence can be checked with
+ * a reset in the middle of a replayed flight. HostTools/test/
+ * GpsAidingTest runs it on Linux, the record in the shim's EEPROM.
+ *
+ * SAMD has no EEPROM: nothing is kept and the config is saved to
+ * the receiver every boot, as before.
+ */
+
+#define GPS_AID_MAGIC           0x4741      // "GA"
+#define GPS_AID_REPLAY_MAGIC    0x5241      // "RA": replay builds, so a replay never aids a flight
+#define GPS_AID_VERSION         2           // bump if GpsAidRecord changes
+#define GPS_AID_SAVE_MSEC       300000L     // refresh the record every 5 min
+#define GPS_AID_MAX_AGE_SEC     21600L      // older than 6 h: no aiding
+#define GPS_AID_POS_ACC_CM      500000L     // 5 km, at age 0
+#define GPS_AID_DRIFT_CMS       3000L       // plus 30 m/s of drift for each second of age
+#define GPS_AID_TIME_ACC_SEC    10          // RTC drift and the save's second
+
+// GpsAidRecord Flags, and the Aided steps of this start
+#define GPS_AID_FIX             0x01        // position is a real fix
+#define GPS_AID_TIME            0x02        // UTC is set
+#define GPS_AID_CONFIG          0x04        // receiver config saved
+#define GPS_AID_RX_TIME         0x08        // receiver had its own time (Aided only)
+#define GPS_AID_STALE           0x10        // record too old or of unknown age (Aided only)
+
+// Startup sequence steps, one per Poll
+#define GPS_AID_STEP_AOP        0
+#define GPS_AID_STEP_TIME       1
+#define GPS_AID_STEP_CONFIG     2
+#define GPS_AID_STEP_POSITION   3
+#define GPS_AID_STEP_DONE       4
+
+struct GpsAidRecord
+{
+    uint16_t Magic;
+    uint8_t Version;
+    uint8_t Flags;
+    int32_t Lat;                    // 1e-7 deg
+    int32_t Lon;
+    int32_t AltCm;
+    uint16_t Year;
+    uint8_t Month, Day, Hour, Minute, Second;
+    uint32_t SavedRtc;              // RtcUnixTime at the save, 0 if unknown
+    uint16_t Crc;                   // of everything above
+};
+
+/*********************************************
+ * CGpsReceiver
+ * The receiver commands the startup sequence uses. Each returns
+ * false if the receiver didn't take it.
+ */
+class CGpsReceiver
+{
+public:
+    virtual bool EnableAop() = 0;           // AssistNow Autonomous on
+    virtual bool SaveConfig() = 0;          // port and navigation config, to backup RAM
+    virtual bool HasTime() = 0;             // receiver kept its time and date
+    virtual bool AidPosition(int32_t lat, int32_t lon, int32_t altCm, uint32_t accCm) = 0;
+    virtual bool AidTime(const GpsAidRecord &rec, uint16_t accSec) = 0;
+};
+
+class CGpsAiding
+{
+public:
+    CGpsAiding();
+
+    void Start();                           // from the GPS sensor's init
+    bool Poll(CGpsReceiver &receiver);      // next step; true once the sequence is done
+    void Fix(int32_t lat, int32_t lon, int32_t altCm);
+    void Time(uint16_t year, uint8_t month, uint8_t day,
+              uint8_t hour, uint8_t minute, uint8_t second);
+    void LogFirstFix();                     // time since Start; the first call only
+
+    uint8_t Aided;                  // GPS_AID_ flags given at this start
+
+private:
+    bool Load();
+    void Save();
+
+    GpsAidRecord Rec;
+    uint8_t Step;                   // GPS_AID_STEP_ Poll runs next
+    bool HaveFix;                   // a fix since Start
+    bool FirstLogged;               // LogFirstFix done
+    unsigned long SaveMsec;         // FlightMsec() of the last save
+    unsigned long StartMsec;        // FlightMsec() at Start, for the time to first fix
+    long AgeSec;                    // the loaded record's age, -1 if unknown or too old
+};
+
+extern CGpsAiding GpsAiding;
+
+#endif
@@ -0,0 +1,307 @@
+/**************************************************
+ * I2CBus
+ *
+ * Implementation of CI2CBus, the Wire owner and
+ * per-device clock switch. See I2CBus.h
+ *************************************************/
+
+#include "I2CBus.h"
+#include "I2CMux.h"
+#include "SystemParameters.h"
+#include <Wire.h>
+
+// Clock profile for each I2C_DEV_ device
+static const uint32_t DeviceClockHz[NUM_I2C_DEVS] =
+    {
+    I2C_CLOCK_FAST,         // TCA9548A mux
+    I2C_CLOCK_STANDARD,     // SCD30 - 100 kHz max, clock stretching
+    I2C_CLOCK_FAST,         // BMP388
+    I2C_CLOCK_FAST,         // VEML6075
+    I2C_CLOCK_FAST          // u-blox
+    };
+
+static const char DeviceNames[NUM_I2C_DEVS][9] PROGMEM =
+    {"mux", "SCD30", "BMP388", "VEML6075", "u-blox"};
+
+CI2CBus::CI2CBus()   // constructor
+{
+    Started = false;
+    Recovering = false;
+    ClockHz = 0;
+    TimeoutUsec = 0;
+    Timeouts = 0;
+    Recoveries = 0;
+    BackOffs = 0;
+    Depth = 0;
+    NestedFailed = false;
+    Device = 0;
+    StartMicros = 0;
+    RefLoop = false;
+    LoopCount = 0;
+    FastLoops = 0;
+    RefLoops = 0;
+    WindowStartMsec = 0;
+    LoopBusMicros = 0;
+    LoopSavedMicros = 0;
+    for (int i=0; i < NUM_I2C_DEVS; i++)
+        {
+        LoopMicros[i] = 0;
+        FastSum[i] = 0;
+        RefSum[i] = 0;
+        FailCount[i] = 0;
+        BackOffMsec[i] = 0;
+        BackOffUntil[i] = 0;
+        }
+}
+
+void CI2CBus::Init()
+{
+    if (Started) return;
+    Wire.begin();
+    Started = true;
+    ClockHz = 0;
+    SetClock(I2C_CLOCK_STANDARD);
+    TimeoutUsec = 0;
+    SetTimeout(I2C_TIMEOUT_USEC);
+#ifdef MUX_RESET_PIN
+    pinMode(MUX_RESET_PIN, OUTPUT);
+    digitalWrite(MUX_RESET_PIN, HIGH);
+#endif
+}
+
+void CI2CBus::SetClock(uint32_t hz)
+{
+    if (hz == ClockHz) return;
+    Wire.setClock(hz);
+    ClockHz = hz;
+}
+
+void CI2CBus::SetTimeout(uint32_t usec)
+{
+    if (usec == TimeoutUsec) return;
+#ifdef WIRE_HAS_TIMEOUT
+    Wire.setWireTimeout(usec, true);    // reset the TWI hardware on timeout
+#endif
+    TimeoutUsec = usec;
+}
+
+bool CI2CBus::Begin(int device)
+{
+    if (!Started) Init();
+    bool backedOff = BackOffMsec[device] && ((long)(millis() - BackOffUntil[device]) < 0);
+    if (Depth > 0)
+        {   // nested, keep the outer clock and timeout
+        if (backedOff)
+            {
+            NestedFailed = true;
+            return(false);
+            }
+        Depth++;
+        return(true);
+        }
+    if (backedOff)
+        return(false);      // still backed off; no transaction started
+
+    Depth = 1;
+    Device = device;
+    SetClock(RefLoop ? I2C_CLOCK_STANDARD : DeviceClockHz[device]);
+    SetTimeout(device == I2C_DEV_SCD30 ? SCD30_TIMEOUT_USEC : I2C_TIMEOUT_USEC);
+#ifdef WIRE_HAS_TIMEOUT
+    Wire.clearWireTimeoutFlag();
+#endif
+    StartMicros = micros();
+    return(true);
+}
+
+/****************************
+ * End
+ * deviceOK is the caller's verdict (the driver reported a failed
+ * read). A hang is a Wire timeout (AVR; see I2CBus.h). The bus is
+ * recovered before anyone else uses it.
+ */
+bool CI2CBus::End(bool deviceOK)
+{
+    if (Depth == 0) return(deviceOK);
+    if (--Depth > 0)
+        {   // nested: the outer End fails the transaction and recovers
+        if (!deviceOK)
+            NestedFailed = true;
+        return(deviceOK);
+        }
+    bool nestedFailed = NestedFailed;
+    NestedFailed = false;
+
+    unsigned long elapsed = micros() - StartMicros;
+    LoopMicros[Device] += elapsed;
+
+#ifdef WIRE_HAS_TIMEOUT
+    bool hung = Wire.getWireTimeoutFlag();
+    Wire.clearWireTimeoutFlag();
+#else
+    bool hung = false;          // no Wire timeout to tell us
+#endif
+    if (hung)
+        {
+        Timeouts++;
+        LogDevice(PSTR("I2C: timeout on "), Device);
+        Recover();
+        }
+    else if (nestedFailed)
+        Recover();      // the mux select inside failed; its state is unknown
+
+    if (hung || nestedFailed || !deviceOK)
+        {
+        Failed(Device);
+        return(false);
+        }
+    if (BackOffMsec[Device])
+        LogDevice(PSTR("I2C: back-off over for "), Device);
+    FailCount[Device] = 0;
+    BackOffMsec[Device] = 0;
+    return(true);
+}
+
+// Count a failure; back the device off after I2C_FAIL_LIMIT in a row
+void CI2CBus::Failed(int device)
+{
+    if (FailCount[device] < 255)
+        FailCount[device]++;
+    if (FailCount[device] < I2C_FAIL_LIMIT) return;
+
+    if (BackOffMsec[device] == 0)
+        {
+        BackOffMsec[device] = I2C_FIRST_BACKOFF_MSEC;
+        BackOffs++;
+        LogDevice(PSTR("I2C: backing off "), device);
+        }
+    else if (BackOffMsec[device] < I2C_MAX_BACKOFF_MSEC)
+        BackOffMsec[device] = min(BackOffMsec[device] * 2, I2C_MAX_BACKOFF_MSEC);
+    BackOffUntil[device] = millis() + BackOffMsec[device];
+}
+
+/****************************
+ * Recover
+ * A slave stuck mid-byte holds SDA low. Clock SCL until it
+ * finishes the byte and releases SDA, then send a STOP
+ * (SDA low -> high while SCL is high). Restart Wire with the
+ * current clock and timeout, then reset the mux so no port
+ * is left selected.
+ */
+void CI2CBus::Recover()
+{
+    if (Recovering) return;     // the mux reset below failed too
+    Recovering = true;
+    Recoveries++;
+    Wire.end();
+
+    pinMode(SDA, INPUT_PULLUP);
+    pinMode(SCL, INPUT_PULLUP);
+    for (int i=0; (i < I2C_RECOVERY_PULSES) && (digitalRead(SDA) == LOW); i++)
+        {
+        pinMode(SCL, OUTPUT);
+        digitalWrite(SCL, LOW);
+        delayMicroseconds(5);
+        pinMode(SCL, INPUT_PULLUP);     // released: high unless stretched
+        delayMicroseconds(5);
+        }
+    // STOP
+    pinMode(SDA, OUTPUT);
+    digitalWrite(SDA, LOW);
+    delayMicroseconds(5);
+    pinMode(SDA, INPUT_PULLUP);
+    delayMicroseconds(5);
+
+    Wire.begin();
+    uint32_t hz = ClockHz;
+    uint32_t usec = TimeoutUsec;
+    ClockHz = 0;
+    TimeoutUsec = 0;
+    SetClock(hz);
+    SetTimeout(usec);
+
+#ifdef MUX_RESET_PIN
+    digitalWrite(MUX_RESET_PIN, LOW);
+    delayMicroseconds(5);
+    digitalWrite(MUX_RESET_PIN, HIGH);
+#endif
+    I2CMux.Reset();
+    Recovering = false;
+}
+
+// what is a PSTR
+void CI2CBus::LogDevice(const char *what, int device)
+{
+    char logMsg[50];
+
+    strcpy_P(logMsg, what);
+    strcat_P(logMsg, DeviceNames[device]);
+    LogEvent(logMsg);
+}
+
+void CI2CBus::EndLoop()
+{
+    for (int i=0; i < NUM_I2C_DEVS; i++)
+        {
+        if (RefLoop)
+            RefSum[i] += LoopMicros[i];
+        else
+            FastSum[i] += LoopMicros[i];
+        LoopMicros[i] = 0;
+        }
+    if (RefLoop)
+        RefLoops++;
+    else
+        FastLoops++;
+
+    LoopCount++;
+    RefLoop = ((LoopCount % I2C_REF_EVERY) == 0);
+}
+
+void CI2CBus::Report()
+{
+    unsigned long windowMsec = millis() - WindowStartMsec;
+    if (windowMsec < I2C_REPORT_MSEC) return;
+    if ((FastLoops == 0) || (RefLoops == 0)) return;
+
+    long bus = 0;
+    long saved = 0;
+    for (int i=0; i < NUM_I2C_DEVS; i++)
+        {
+        long fast = FastSum[i] / FastLoops;
+        bus += fast;
+        saved += (long)(RefSum[i] / RefLoops) - fast;
+        }
+    LoopBusMicros = bus;
+    LoopSavedMicros = (saved > 0) ? saved : 0;
+
+    char logMsg[120];
+    char buf[12];
+    strcpy_P(logMsg, PSTR("I2C: "));
+    ultoa(LoopBusMicros, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" us/loop on the bus, fast mode saves "));
+    ultoa(LoopSavedMicros, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" us/loop; "));
+    utoa(Timeouts, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" timeouts, "));
+    utoa(Recoveries, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" recoveries, "));
+    utoa(BackOffs, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" back-offs"));
+    LogEvent(logMsg);
+
+    for (int i=0; i < NUM_I2C_DEVS; i++)
+        {
+        FastSum[i] = 0;
+        RefSum[i] = 0;
+        }
+    FastLoops = 0;
+    RefLoops = 0;
+    WindowStartMsec = millis();
+}
+
+CI2CBus I2CBus;
@@ -0,0 +1,117 @@
+#ifndef I2CBUS_H
+#define I2CBUS_H
+
+#include <Arduino.h>
+
+/*********************************************
+ * CI2CBus
+ *
+ * Owns the Wire bus: starts it once, and runs each device's traffic
+ * at that device's clock. The SCD30 is limited to 100 kHz (and
+ * stretches the clock); the BMP388, VEML6075, u-blox and the TCA9548A
+ * mux run at 400 kHz fast mode. The clock is only changed when the
+ * next transaction needs a different one.
+ *
+ * Sensors bracket their I2C work with Begin(device) / End(). Nested
+ * Begins (the mux select inside a sensor's transaction) keep the
+ * outer clock. A nested failure, or a nested device that is backed
+ * off, is held for the outer End(), which fails the transaction and
+ * recovers the bus then, not in the middle of the outer device's
+ * transaction.
+ *
+ * Hangs are caught on AVR only. There each device's timeout is armed
+ * in Wire (setWireTimeout, WIRE_HAS_TIMEOUT), so a stuck SDA or a
+ * device that stretches the clock forever aborts the wait and counts
+ * as a hang. The SAMD Wire has no timeout and waits in its driver
+ * until the bus frees up, so there a stuck bus still stalls loop()
+ * and the loop latency is not bounded. Failed transactions are
+ * counted and backed off on both. After a hang we
+ * clock SCL until the stuck device lets go of SDA, send a STOP,
+ * restart Wire and reset the mux. A device that fails
+ * I2C_FAIL_LIMIT times in a row is backed off: Begin() refuses it for
+ * a while, doubling up to I2C_MAX_BACKOFF_MSEC, so a dead sensor
+ * can't eat every loop. Timeouts, recoveries and back-offs are
+ * counted and logged.
+ *
+ * Measuring what fast mode buys: one loop in I2C_REF_EVERY runs every
+ * device at 100 kHz. Comparing the per-device time of those loops with
+ * the normal ones gives the bus time saved per loop, logged with the
+ * bus time every I2C_REPORT_MSEC. The times are whole transactions,
+ * so they include any waiting the driver does (like the BMP388
+ * conversion) - that part is the same in both and cancels out.
+ */
+
+// Devices, each with a clock profile
+#define I2C_DEV_MUX         0
+#define I2C_DEV_SCD30       1
+#define I2C_DEV_BMP388      2
+#define I2C_DEV_VEML6075    3
+#define I2C_DEV_UBLOX       4
+#define NUM_I2C_DEVS        5
+
+#define I2C_CLOCK_STANDARD  100000L
+#define I2C_CLOCK_FAST      400000L
+
+// Transaction timeouts (usec), AVR only. The SCD30 may stretch the clock a long time
+#define I2C_TIMEOUT_USEC        25000L
+#define SCD30_TIMEOUT_USEC      175000L
+
+#define I2C_FAIL_LIMIT          3           // failures in a row before back-off
+#define I2C_FIRST_BACKOFF_MSEC  2000L
+#define I2C_MAX_BACKOFF_MSEC    300000L
+#define I2C_RECOVERY_PULSES     9           // SCL pulses to free SDA
+
+#define I2C_REF_EVERY       50          // every Nth loop runs all at 100 kHz
+#define I2C_REPORT_MSEC     600000L     // log bus time and savings every 10 min
+
+class CI2CBus
+{
+public:
+    CI2CBus();
+
+    void Init();                    // Wire.begin(), once
+    bool Begin(int device);         // set clock and timeout; false if backed off
+    bool End(bool deviceOK = true); // false if the transaction hung or failed
+    void Recover();                 // free a stuck bus, restart Wire, reset the mux
+    bool InTransaction() { return(Depth > 0); }
+    void EndLoop();                 // per-loop bookkeeping, once per loop()
+    void Report();                  // log once per I2C_REPORT_MSEC
+
+    unsigned long LoopBusMicros;    // average bus time per loop, normal loops
+    unsigned long LoopSavedMicros;  // average saved per loop vs all at 100 kHz
+    unsigned int Timeouts;          // hung transactions since boot
+    unsigned int Recoveries;        // bus recoveries since boot
+    unsigned int BackOffs;          // devices put on back-off since boot
+
+private:
+    void SetClock(uint32_t hz);
+    void SetTimeout(uint32_t usec);
+    void Failed(int device);
+    void LogDevice(const char *what, int device);    // what is a PSTR
+
+    bool Started;
+    bool Recovering;                // Recover() is running
+    uint32_t ClockHz;               // current bus clock
+    uint32_t TimeoutUsec;           // current transaction timeout
+    int  Depth;                     // Begin nesting
+    bool NestedFailed;              // a nested Begin/End failed; the outer End handles it
+    int  Device;                    // outermost device in the transaction
+    unsigned long StartMicros;
+    bool RefLoop;                   // this loop runs all at 100 kHz
+    unsigned int LoopCount;
+
+    unsigned long LoopMicros[NUM_I2C_DEVS];    // this loop
+    unsigned long FastSum[NUM_I2C_DEVS];       // report window, normal loops
+    unsigned long RefSum[NUM_I2C_DEVS];        // report window, reference loops
+    unsigned int FastLoops;
+    unsigned int RefLoops;
+    unsigned long WindowStartMsec;
+
+    uint8_t FailCount[NUM_I2C_DEVS];            // failures in a row
+    unsigned long BackOffMsec[NUM_I2C_DEVS];    // current back-off, 0 if none
+    unsigned long BackOffUntil[NUM_I2C_DEVS];
+};
+
+extern CI2CBus I2CBus;
+
+#endif
@@ -0,0 +1,84 @@
+/**************************************************
+ * I2CMux
+ *
+ * Implementation of CI2CMux, the TCA9548A selection cache.
+ * See I2CMux.h
+ *************************************************/
+
+#include "I2CMux.h"
+#include "MySensor.h"
+#include "I2CBus.h"
+#include <Wire.h>
+
+CI2CMux::CI2CMux()   // constructor
+{
+    Selected = MUX_NONE;
+    Batching = false;
+    SelectOps = 0;
+    Retries = 0;
+    Known = false;
+}
+
+// The control register is a bit mask of enabled ports. Inside a
+// sensor's transaction a failure is left to the sensor's End(),
+// which recovers the bus once the sensor is done with it
+bool CI2CMux::WriteControl(uint8_t mask)
+{
+    bool nested = I2CBus.InTransaction();
+
+    for (int attempt=0; attempt < 2; attempt++)
+        {
+        SelectOps++;
+        if (!I2CBus.Begin(I2C_DEV_MUX)) break;      // mux backed off
+        Wire.beginTransmission(MUX_ADDRESS);
+        Wire.write(mask);
+        Known = (Wire.endTransmission() == 0);
+        if (I2CBus.End(Known)) return(true);
+        if (nested) break;
+        if (attempt == 0)
+            {
+            Retries++;
+            I2CBus.Recover();
+            }
+        }
+    Known = false;
+    return(false);
+}
+
+bool CI2CMux::Select(int port)
+{
+    if (port < 0) return(Deselect());
+    if (port > 7) port = 7;
+    if (Known && (Selected == port)) return(true);
+
+    Selected = port;
+    return(WriteControl(1 << port));
+}
+
+bool CI2CMux::Deselect()
+{
+    if (Known && (Selected == MUX_NONE)) return(true);
+
+    Selected = MUX_NONE;
+    return(WriteControl(0));
+}
+
+void CI2CMux::BeginBatch()
+{
+    Batching = true;
+}
+
+void CI2CMux::Reset()
+{
+    Known = false;
+    Selected = MUX_NONE;
+    Deselect();
+}
+
+void CI2CMux::EndBatch()
+{
+    Batching = false;
+    Deselect();
+}
+
+CI2CMux I2CMux;
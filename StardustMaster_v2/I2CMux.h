@@ -0,0 +1,48 @@
+#ifndef I2CMUX_H
+#define I2CMUX_H
+
+#include <Arduino.h>
+
+/*********************************************
+ * CI2CMux
+ *
+ * Tracks which TCA9548A port is selected so we only talk to the mux
+ * when the selection actually changes. One port is selected at a time
+ * (both SCD30s answer at 0x61, on ports 1 and 4).
+ *
+ * Sensors still call EnableMuxPort/DisableMuxPort around their own
+ * I2C traffic. Inside a batch (see ReadPlan.h) DisableMuxPort leaves
+ * the port selected, so the next sensor on the same port costs no
+ * mux traffic; the plan deselects when it moves to the direct bus and
+ * at the end of the batch.
+ *
+ * A failed write is retried once after a bus recovery instead of
+ * being ignored; the sensor read that follows reports the failure.
+ */
+
+#define MUX_NONE   -1       // no port selected
+
+class CI2CMux
+{
+public:
+    CI2CMux();
+
+    bool Select(int port);          // select only this port
+    bool Deselect();                // no port selected, direct bus only
+    void BeginBatch();              // hold the selection across sensors
+    void EndBatch();                // release and deselect
+    void Reset();                   // after a bus recovery: state unknown, deselect
+
+    int  Selected;                  // port selected, or MUX_NONE
+    bool Batching;
+    unsigned long SelectOps;        // writes to the mux since boot
+    unsigned int Retries;           // writes that failed and were retried
+
+private:
+    bool WriteControl(uint8_t mask);
+    bool Known;                     // Selected matches the mux (false until first write)
+};
+
+extern CI2CMux I2CMux;
+
+#endif
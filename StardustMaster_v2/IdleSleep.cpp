@@ -0,0 +1,75 @@
+/**************************************************
+ * IdleSleep
+ *
+ * Implementation of CIdleSleep. See IdleSleep.h
+ *************************************************/
+
+#include "IdleSleep.h"
+#include "StatusLeds.h"
+#include "Console.h"
+#include "AdcEngine.h"
+#include "SystemParameters.h"     // LogEvent
+
+#ifdef __AVR__
+#include <avr/sleep.h>
+#endif
+
+CIdleSleep::CIdleSleep()   // constructor
+{
+    PercentAsleep = 0;
+    TotalAsleepMsec = 0;
+    WindowStartMsec = 0;
+    WindowAsleepMicros = 0;
+}
+
+void CIdleSleep::SleepUntil(unsigned long deadlineMsec)
+{
+    unsigned long asleepMicros = 0;
+
+    while ((long)(millis() - deadlineMsec) < 0)
+        {
+        unsigned long startMicros = micros();
+#if defined(__AVR__)
+        set_sleep_mode(SLEEP_MODE_IDLE);
+        noInterrupts();
+        sleep_enable();
+        interrupts();       // sleep_cpu runs before any pending interrupt
+        sleep_cpu();
+        sleep_disable();
+#elif defined(ARDUINO_ARCH_SAMD)
+        __DSB();
+        __WFI();            // SysTick wakes us every msec
+#endif
+        asleepMicros += micros() - startMicros;
+        StatusLeds.Service();
+        AdcEngine.Service();
+        Console.Poll();
+        }
+
+    WindowAsleepMicros += asleepMicros;
+    TotalAsleepMsec += asleepMicros / 1000;
+}
+
+void CIdleSleep::Report()
+{
+    unsigned long windowMsec = millis() - WindowStartMsec;
+    if (windowMsec < IDLE_REPORT_MSEC) return;
+
+    PercentAsleep = (int)(WindowAsleepMicros / 10 / windowMsec);   // (us/1000) * 100 / msec
+
+    char logMsg[60];
+    char buf[12];
+    strcpy_P(logMsg, PSTR("Idle: asleep "));
+    itoa(PercentAsleep, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR("% of last "));
+    ltoa(windowMsec / 1000, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" sec"));
+    LogEvent(logMsg);
+
+    WindowStartMsec = millis();
+    WindowAsleepMicros = 0;
+}
+
+CIdleSleep IdleSleep;
@@ -0,0 +1,43 @@
+#ifndef IDLESLEEP_H
+#define IDLESLEEP_H
+
+#include <Arduino.h>
+
+/*********************************************
+ * CIdleSleep
+ *
+ * Puts the MCU to sleep between scheduled samples instead of busy
+ * waiting in delay().
+ *
+ * Only the light idle mode is used (AVR SLEEP_MODE_IDLE, SAMD WFI), so
+ * the timers keep running and millis() stays correct. Any interrupt
+ * wakes the CPU: the millis() tick, the LED tick, Serial or Wire
+ * traffic. SleepUntil() goes back to sleep until its deadline, and
+ * polls the command console (Console.h) each time it wakes, so a
+ * command typed between samples is answered right away.
+ *
+ * The time spent asleep is counted so we can see how much of each
+ * report window the CPU was idle.
+ */
+
+#define IDLE_REPORT_MSEC   600000L    // log the sleep fraction every 10 min
+
+class CIdleSleep
+{
+public:
+    CIdleSleep();
+
+    void SleepUntil(unsigned long deadlineMsec);    // sleep until millis() reaches deadline
+    void Report();                  // log sleep fraction once per IDLE_REPORT_MSEC
+
+    int  PercentAsleep;             // asleep % over the last report window
+    unsigned long TotalAsleepMsec;  // since boot
+
+private:
+    unsigned long WindowStartMsec;
+    unsigned long WindowAsleepMicros;   // asleep in the current window
+};
+
+extern CIdleSleep IdleSleep;
+
+#endif
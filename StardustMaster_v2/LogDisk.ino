@@ -16,13 +16,10 @@ void InitLogger()
         }
     else
         {
-        Serial.println("Skipping Disk Initialization (wire 22)"); 
+        Serial.println(F("Skipping Disk Initialization (wire 22)")); 
         }
-    // Check how much buffer is needed to hold data line for MaxSensors.
-    // Assume 30 bytes per sensor (3 values, each 8 chars, plus 3 commas)
-    // plus 30 for timestamps. Add extra 20 for fudge factor
-    int bufNeeded = (MaxSensors +1)*30 + 20;
-    TheLogger.MAXLOGLINELENGTH = bufNeeded;
+    // Longest data line for the sensor set, fixed at compile time. See Arena.h
+    TheLogger.MAXLOGLINELENGTH = MAX_LINE_LENGTH + RECORD_TRAILER_LENGTH;
     WriteCSVHeader();
 
 }
@@ -30,71 +27,154 @@ void InitLogger()
 /**********************
  * DiskFailedLights
  * Separate error flashing for the case of disk not initializing
+ * Chases the three lights forever in the background. Only the
+ * first failure sets the pattern.
  */
 void DiskFailedLights(char *msg)
 {
-    int lights[3] = {GPS_FIX_ON, HEATER_LED, STATUS_LED};
+    uint8_t lights[3] = {LEDBIT_FIX, LEDBIT_HEATER, LEDBIT_STATUS};
     
     Serial.println(msg);
-    while (1)
+    for (int i=0; i< 3; i++)
         {
-        for (int i=0; i< 3; i++)
-            {
-            digitalWrite (lights[i], LED_ON);
-            delay(50);
-            digitalWrite (lights[i], LED_OFF);
-            delay(50);  
-            }
-        delay(100);
+        if (!StatusLeds.QueueStep(lights[i], 1, 50, 50, i == 2 ? 100 : 0))
+            return;     // already chasing
         }
+    StatusLeds.Loop(3);
 }
 /***********************************************
  * WriteCSVHeader
  * 
  * Creates the next data file named StardutDatannn, where nnn is the next available number.
  * 
- * Writes the csv header information (column names) to the file
+ * Writes the csv header information (column names) to the file,
+ * and each sensor's units (from its channel table) to the Error Log
  */
-void WriteCSVHeader()
+// One sensor's units line, like "Units: Pressure hPa,m,degC"
+struct UnitsStep
+{
+    void operator()(CMySensor &sensor, int)
+        {
+        char unitMsg[LOGMSG_LENGTH];
+        int len;
+        
+        Fstrcpy(unitMsg, F("Units: "), sizeof(unitMsg));
+        Fstrcat(unitMsg, sensor.SensorName, sizeof(unitMsg));
+        Fstrcat(unitMsg, F(" "), sizeof(unitMsg));
+        len = strlen(unitMsg);
+        sensor.GetUnits(unitMsg + len, sizeof(unitMsg) - len);
+        LogEvent(unitMsg);
+        }
+};
+
+// One sensor's csv column names
+struct HeaderStep
 {
-    TheLogger.LogMsg(VERSION);      // Version info to the Error Log
-    TheLogger.LogMsg(SENSOR_SET_NAME);      // Log Sensor set
+    char *CsvHeader;
     
-    char csvHeader[TheLogger.MAXLOGLINELENGTH+1];
-    Mstrcpy(csvHeader, "Timestamp,      Elapsed Time",TheLogger.MAXLOGLINELENGTH);
-    char fieldBuf[50];                 // gets the Header piece (i.e., "FieldA"
-    for (int i=0; i < MaxSensors; i++)
+    void operator()(CMySensor &sensor, int)
         {
-        SensorArr[i]->GetHeader(fieldBuf);
-        Mstrcat(csvHeader, ",",TheLogger.MAXLOGLINELENGTH);
-        Mstrcat(csvHeader, fieldBuf,TheLogger.MAXLOGLINELENGTH);
+        char fieldBuf[LOG_FIELD_LENGTH+1];      // gets the Header piece (i.e., "FieldA"
+        
+        sensor.GetHeader(fieldBuf);
+        Fstrcat(CsvHeader, F(","),MAX_LINE_LENGTH);
+        Mstrcat(CsvHeader, fieldBuf,MAX_LINE_LENGTH);
         }
+};
+
+void WriteCSVHeader()
+{
+    UnitsStep units;
+    HeaderStep header;
+    
+    LogMsgF(F(VERSION));      // Version info to the Error Log
+    LogMsgF(F(SENSOR_SET_NAME));      // Log Sensor set
+    ActiveSensors::ForEach(units);
+    
+#ifdef LOG_STREAMS
+    StreamLog.WriteHeader();
+    return;
+#endif
+    char *csvHeader = Arena.LineBuf;
+    Fstrcpy(csvHeader, F("Timestamp,      Elapsed Time"),MAX_LINE_LENGTH);
+    header.CsvHeader = csvHeader;
+    ActiveSensors::ForEach(header);
+    Fstrcat(csvHeader, F(",Quality"),MAX_LINE_LENGTH);
     TheLogger.WriteDataHeader(csvHeader);
 }
 
 /**********************************************            
  *  LogDisk
- *  Builds long string with all of the fields for the csv file
- *  123,456.3, etc
+ *  Logs the sensors' error messages, then writes the data line
  */
 
-boolean LogDisk()
+// One sensor's error message, if it has one
+struct ErrMsgStep
 {
-
-    char fieldBuf[40];                 // gets the log piece (i.e., "1234.0"
-    char logS[TheLogger.MAXLOGLINELENGTH+1];           // The entire log line "123,4325.0,1234"
-              
-    strcpy(logS, "");
-    for (int i=0; i < MaxSensors; i++)
+    void operator()(CMySensor &sensor, int)
         {
-        if(SensorArr[i]->ErrMsg != "")
+        if(sensor.ErrMsg != "")
             {
-            TheLogger.LogMsg((char *)SensorArr[i]->ErrMsg.c_str());
+            LogEvent((char *)sensor.ErrMsg.c_str());
             }
-        SensorArr[i]->GetLogLine(fieldBuf);
-        if (i > 0)
-            Mstrcat(logS, ",",TheLogger.MAXLOGLINELENGTH);
-        Mstrcat(logS, fieldBuf,TheLogger.MAXLOGLINELENGTH);
         }
-    TheLogger.WriteDataFile(logS);
-}
+};
+
+boolean LogDisk()
+{
+    ErrMsgStep errors;
+    
+    ActiveSensors::ForEach(errors);
+    BuildDataLine(Arena.LineBuf);
+    WriteDataRecord(Arena.LineBuf, sizeof(Arena.LineBuf));
+    return(true);
+}
+
+/**********************************************            
+ *  BuildDataLine
+ *  Builds long string with all of the fields for the csv file
+ *  123,456.3, etc
+ *  and ends it with the Quality digits of every channel, like
+ *  ,0001000004440  (see QUAL_ in MySensor.h)
+ *  logS is Arena.LineBuf
+ */
+// One sensor's fields and Quality digits, as its own class. See SensorSet.h
+struct DataLineStep
+{
+    char *LogS;
+    char Quality[LOG_QUALITY_LENGTH+1];     // ",0001000..." one digit per channel
+    bool First;
+    
+    template<class T> void operator()(T &sensor, int)
+        {
+        char fieldBuf[LOG_FIELD_LENGTH+1];      // gets the log piece (i.e., "1234.0"
+        char qualBuf[MAX_SENSOR_CHANNELS+1];
+        
+        MemMonitor.StartProbe(MEM_PROBE_GETLOGLINE);
+        GetLogLine(sensor, fieldBuf);
+        MemMonitor.EndProbe(MEM_PROBE_GETLOGLINE);
+        GetQuality(sensor, qualBuf);
+        Append(fieldBuf, qualBuf);
+        }
+    
+    void Append(char *fieldBuf, char *qualBuf)      // not a template, see GetLogLine
+        {
+        if (!First)
+            Fstrcat(LogS, F(","),MAX_LINE_LENGTH);
+        First = false;
+        Mstrcat(LogS, fieldBuf,MAX_LINE_LENGTH);
+        Mstrcat(Quality, qualBuf, sizeof(Quality));
+        }
+};
+
+void BuildDataLine(char *logS)
+{
+    DataLineStep step;
+              
+    strcpy(logS, "");
+    step.LogS = logS;
+    step.First = true;
+    strcpy_P(step.Quality, PSTR(","));
+    ActiveSensors::ForEach(step);
+    Mstrcat(logS, step.Quality,MAX_LINE_LENGTH);
+}
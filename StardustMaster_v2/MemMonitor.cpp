@@ -0,0 +1,220 @@
+/**************************************************
+ * MemMonitor
+ *
+ * Implementation of CMemMonitor, the stack and
+ * heap instrumentation. See MemMonitor.h
+ *************************************************/
+
+#include "MemMonitor.h"
+#include "SystemParameters.h"     // LogEvent
+
+#ifdef __AVR__
+// avr-libc malloc internals
+extern char __heap_start;
+extern char *__brkval;
+struct __freelist
+{
+    size_t sz;
+    struct __freelist *nx;
+};
+extern struct __freelist *__flp;
+#define STACK_TOP   ((char *)RAMEND)
+#elif defined(HOST_BUILD)
+// HostTools builds (glibc malloc): the stack is nowhere near the
+// heap, so it isn't painted or scanned
+#include <malloc.h>
+extern "C" char *sbrk(int incr);
+#define STACK_TOP   ((char *)NULL)
+#else
+// SAMD: newlib malloc, stack at the top of RAM (linker script)
+#include <malloc.h>
+extern "C" char *sbrk(int incr);
+extern char __StackTop;
+#define STACK_TOP   (&__StackTop)
+#endif
+
+static const char ProbeNames[NUM_MEM_PROBES][11] PROGMEM =
+    {"LogDisk", "GetLogLine", "ReadSensor"};
+
+CMemMonitor::CMemMonitor()   // constructor
+{
+    StackMax = 0;
+    StackFree = 0;
+    HeapHoles = 0;
+    HeapLargest = 0;
+    HeapFragPercent = 0;
+    for (int i=0; i < NUM_MEM_PROBES; i++)
+        ProbeMax[i] = 0;
+    StackLow = NULL;
+    HeapHigh = NULL;
+    ProbeBase = NULL;
+    ProbeBottom = NULL;
+    Turn = 0;
+    Probing = false;
+    ReportMsec = 0;
+}
+
+char *CMemMonitor::HeapEnd()
+{
+#ifdef __AVR__
+    char *end = __brkval ? __brkval : &__heap_start;
+#else
+    char *end = sbrk(0);
+#endif
+    // If the heap shrinks, what it gave back isn't paint any more
+    if (end > HeapHigh)
+        HeapHigh = end;
+    return(HeapHigh);
+}
+
+char *CMemMonitor::LowestTouched(char *from, char *to)
+{
+    char *p = from;
+    while ((p < to) && (*p == (char)MEM_PAINT))
+        p++;
+    return(p);
+}
+
+/****************************
+ * PaintStack
+ * Everything between the heap and a little below our own frame.
+ * Writing below the stack pointer is safe: an interrupt that
+ * lands on the paint is done with it by the time we run again.
+ */
+void CMemMonitor::PaintStack()
+{
+#ifndef HOST_BUILD
+    char here;
+    char *top = &here - MEM_PAINT_MARGIN;
+
+    for (char *p = HeapEnd(); p < top; p++)
+        *p = MEM_PAINT;
+    StackLow = top;
+#endif
+}
+
+void CMemMonitor::ScanStack()
+{
+    if (StackLow == NULL) return;     // not painted
+
+    char *low = LowestTouched(HeapEnd(), StackLow);
+    if (low < StackLow)
+        StackLow = low;
+    StackMax = STACK_TOP - StackLow + 1;
+    StackFree = StackLow - HeapEnd();
+}
+
+/****************************
+ * StartProbe / EndProbe
+ * Only the probe whose turn it is runs. The high-water mark is
+ * taken before repainting, so the probe can't hide it.
+ */
+void CMemMonitor::StartProbe(int probe)
+{
+    if (Probing || (probe != Turn) || (StackLow == NULL)) return;
+    ScanStack();
+
+    char here;
+    char *top = &here - MEM_PAINT_MARGIN;
+    char *bottom = top - MEM_PROBE_WINDOW;
+    if (bottom < HeapEnd())
+        bottom = HeapEnd();
+    for (char *p = bottom; p < top; p++)
+        *p = MEM_PAINT;
+
+    ProbeBase = &here;
+    ProbeBottom = bottom;
+    Probing = true;
+}
+
+void CMemMonitor::EndProbe(int probe)
+{
+    if (!Probing || (probe != Turn)) return;
+    Probing = false;
+
+    char *low = LowestTouched(ProbeBottom, ProbeBase - MEM_PAINT_MARGIN);
+    unsigned int depth = ProbeBase - low;
+    if (depth > ProbeMax[probe])
+        ProbeMax[probe] = depth;
+    if (low < StackLow)
+        StackLow = low;
+}
+
+void CMemMonitor::EndLoop()
+{
+    Probing = false;        // a probe whose End was skipped
+    Turn = (Turn + 1) % NUM_MEM_PROBES;
+}
+
+/****************************
+ * MeasureHeap
+ * Free RAM is the holes in the heap plus the never-used stack
+ * above it. Call after ScanStack.
+ */
+void CMemMonitor::MeasureHeap()
+{
+    unsigned int largest;
+    unsigned long total;
+
+#ifdef __AVR__
+    unsigned int holes = 0;
+    largest = 0;
+    for (struct __freelist *f = __flp; f; f = f->nx)
+        {
+        holes += f->sz;
+        if (f->sz > largest)
+            largest = f->sz;
+        }
+    HeapHoles = holes;
+    if (StackFree > largest)
+        largest = StackFree;
+    total = (unsigned long)holes + StackFree;
+#else
+    struct mallinfo mi = mallinfo();
+    // The free top chunk runs straight into the gap above the heap
+    HeapHoles = mi.fordblks - mi.keepcost;
+    largest = mi.keepcost + StackFree;
+    total = (unsigned long)mi.fordblks + StackFree;
+#endif
+    HeapLargest = largest;
+    HeapFragPercent = total ? (int)(100 - (unsigned long)largest * 100 / total) : 0;
+}
+
+void CMemMonitor::Report(bool now)
+{
+    if (!now && (millis() - ReportMsec < MEM_REPORT_MSEC)) return;
+    ReportMsec = millis();
+
+    ScanStack();
+    MeasureHeap();
+
+    char logMsg[150];
+    char buf[8];
+    strcpy_P(logMsg, PSTR("Mem: stack "));
+    utoa(StackMax, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" max, "));
+    utoa(StackFree, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" free; heap "));
+    utoa(HeapHoles, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" free, "));
+    utoa(HeapLargest, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" largest, "));
+    itoa(HeapFragPercent, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR("% frag"));
+    for (int i=0; i < NUM_MEM_PROBES; i++)
+        {
+        strcat_P(logMsg, i == 0 ? PSTR("; ") : PSTR(", "));
+        strcat_P(logMsg, ProbeNames[i]);
+        strcat_P(logMsg, PSTR(" "));
+        utoa(ProbeMax[i], buf, 10);
+        strcat(logMsg, buf);
+        }
+    LogEvent(logMsg);
+}
+
+CMemMonitor MemMonitor;
@@ -0,0 +1,87 @@
+#ifndef MEMMONITOR_H
+#define MEMMONITOR_H
+
+#include <Arduino.h>
+
+/*********************************************
+ * CMemMonitor
+ *
+ * Watches the RAM between the heap and the stack, on AVR and SAMD.
+ *
+ * Stack: PaintStack(), first thing in setup(), fills the free RAM
+ * below the stack with MEM_PAINT. Scans count how much of the paint
+ * is still there, which gives the deepest the stack has ever been
+ * (high-water mark) and the headroom left above the heap.
+ *
+ * Heap: the free blocks inside the heap (String leaves holes), the
+ * largest block malloc could hand out, and the fragmentation - the
+ * part of the free RAM that is not in the largest block. On SAMD
+ * newlib doesn't give the size of the holes, so the largest block
+ * is the top of the heap plus the gap above it.
+ *
+ * Probes: the stack used by one call, including everything it calls.
+ * StartProbe() repaints MEM_PROBE_WINDOW bytes below the caller's
+ * stack, EndProbe() sees how far down the paint was overwritten.
+ * Probes take turns, one per loop, so an outer probe (LogDisk) never
+ * has an inner one (GetLogLine) repaint under it. A depth of the
+ * whole window means "at least this much".
+ *   LogDisk      the wide csv row, all GetLogLine calls included
+ *   GetLogLine   one sensor's log fields (the dtostrf chains)
+ *   ReadSensor   one sensor read; the GPS one runs the u-blox parser
+ *
+ * A record goes to the error log at boot and every MEM_REPORT_MSEC:
+ *   Mem: stack 1020 max, 2210 free; heap 24 free, 2200 largest, 1% frag;
+ *        LogDisk 310, GetLogLine 120, ReadSensor 420
+ */
+
+#define MEM_PAINT           0xA5        // unused stack
+#define MEM_PAINT_MARGIN    32          // bytes below our own frame left alone
+#define MEM_REPORT_MSEC     600000L     // log a record every 10 min
+#ifdef __AVR__
+#define MEM_PROBE_WINDOW    768         // bytes repainted for a probe
+#else
+#define MEM_PROBE_WINDOW    2048
+#endif
+
+// Probed calls
+#define MEM_PROBE_LOGDISK       0
+#define MEM_PROBE_GETLOGLINE    1
+#define MEM_PROBE_READSENSOR    2
+#define NUM_MEM_PROBES          3
+
+class CMemMonitor
+{
+public:
+    CMemMonitor();
+
+    void PaintStack();              // once, at the very start of setup()
+    void ScanStack();               // update the high-water mark
+    void StartProbe(int probe);     // before the probed call
+    void EndProbe(int probe);       // after it
+    void EndLoop();                 // next probe's turn
+    void Report(bool now = false);  // log a record every MEM_REPORT_MSEC (or now)
+
+    unsigned int StackMax;          // deepest the stack has been (bytes)
+    unsigned int StackFree;         // never-used stack above the heap
+    unsigned int HeapHoles;         // free bytes inside the heap
+    unsigned int HeapLargest;       // largest block malloc could return
+    int  HeapFragPercent;           // free RAM outside the largest block
+    unsigned int ProbeMax[NUM_MEM_PROBES];  // deepest call seen, per probe
+
+private:
+    void MeasureHeap();
+    char *HeapEnd();                // top of the heap (highest reached)
+    char *LowestTouched(char *from, char *to);  // first non-paint byte
+
+    char *StackLow;                 // lowest stack address seen so far
+    char *HeapHigh;                 // highest the heap has reached
+    char *ProbeBase;                // caller's stack when the probe started
+    char *ProbeBottom;              // bottom of the repainted window
+    int  Turn;                      // probe whose turn it is
+    bool Probing;
+    unsigned long ReportMsec;
+};
+
+extern CMemMonitor MemMonitor;
+
+#endif
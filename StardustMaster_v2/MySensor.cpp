@@ -1,6 +1,12 @@
 
 #include "MySensor.h"
 #include "Config.h"
+#include "StatusLeds.h"
+#include "FlightReplay.h"
+#include "AltitudeFilter.h"
+#include "I2CMux.h"
+#include "I2CBus.h"
+#include "Arena.h"
 
 Adafruit_BMP3XX bmp;              // I2C
 
@@ -11,38 +17,157 @@ Adafruit_BMP3XX bmp;              // I2C
  * 
  ***************************/
 
-#define LOW_VOLTAGE_LIMIT 8.0
-
 
 // Base Class
-CMySensor::CMySensor(char *sensorName, int pinnum, int muxport)    // constructor
+CMySensor::CMySensor(const __FlashStringHelper *sensorName, int pinnum, int muxport,
+                     const ChannelDesc *channels, int numChannels)    // constructor
 {
-    Value = 0.0;
+    for (int i=0; i < MAX_SENSOR_CHANNELS; i++)
+        Values[i] = 0.0;
+    ChannelTable = channels;
+    Channels = numChannels;
     ErrMsg = "";
     SensorName = sensorName;
     PinNum = pinnum;
     MuxPort = muxport;
     SensorAvailable = true;
+    BasePeriodMsec = SAMPLE_PERIOD_MSEC;
+    SamplePeriodMsec = SAMPLE_PERIOD_MSEC;
+    NextDueMsec = 0;
+    FreshSample = false;
+    ReadOK = true;
+    InitState = INIT_IDLE;
+    InitErrCode = 0;
+    InitStartMsec = 0;
+}
+
+// Called when the sensor is still waiting after INIT_BUDGET_MSEC.
+// See SensorInit (MySensor.h)
+void CMySensor::AbortInit()
+{
+    ErrMsg = F("init did not finish within boot budget");
+    FailSensor(InitErrCode);
+}
+
+/****************************
+ * Channels
+ * 
+ * GetHeader, FormatChannel and GetUnits walk the sensor's channel
+ * table (ChannelDesc, MySensor.h), one csv field per channel.
+ */
+const ChannelDesc DefaultChannels[1] PROGMEM =
+    {{"", "", CHT_NUMBER, 8, 2, NO_RANGE}};
+
+void CMySensor::GetChannel(int i, ChannelDesc &desc)
+{
+    memcpy_P(&desc, &ChannelTable[i], sizeof(desc));
 }
 
 void CMySensor::GetHeader(char *buf)
 {
-    strcpy(buf, SensorName.c_str());
+    ChannelDesc desc;
+    char *p = buf;
+    
+    for (int i=0; i < Channels; i++)
+        {
+        GetChannel(i, desc);
+        if (i > 0)
+            *p++ = ',';
+        if (desc.Name[0] == 0)
+            {   // the sensor's own name, already padded
+            strcpy_P(p, (PGM_P)SensorName);
+            p += strlen(p);
+            continue;
+            }
+        for (int pad = desc.Width - (int)strlen(desc.Name); pad > 0; pad--)
+            *p++ = ' ';
+        strcpy(p, desc.Name);
+        p += strlen(p);
+        }
+    *p = 0;
 }
 
-void CMySensor::GetLogLine(char *buf)
+// One log field, for GetLogLine (MySensor.h)
+bool CMySensor::FormatChannel(int i, char *buf)
 {
-    if ((strcmp(ErrMsg.c_str() , "") != 0) || !SensorAvailable)
-        { // err - return empty string
-        strcpy(buf, "        ");  
+    ChannelDesc desc;
+    
+    GetChannel(i, desc);
+    switch (desc.Type)
+        {
+        case CHT_ONOFF:
+            if (isnan(Values[i]))
+                *buf = 0;
+            else
+                strcpy_P(buf, (Values[i] != 0.0) ? PSTR("On") : PSTR("Off"));
+            for (int n = strlen(buf); n < desc.Width; n++)
+                buf[n] = ' ';
+            buf[desc.Width] = 0;
+            return(true);
+        case CHT_CUSTOM:
+            return(false);
+        default:
+            dtostrf(Values[i], desc.Width, desc.Precision, buf);
+            return(true);
         }
-    else
+}
+
+// Units that don't fit in size are left off (Mstrcat says so on Serial)
+void CMySensor::GetUnits(char *buf, int size)
+{
+    ChannelDesc desc;
+    
+    buf[0] = 0;
+    for (int i=0; i < Channels; i++)
         {
-        dtostrf(Value,8,2,buf);
+        GetChannel(i, desc);
+        if (i > 0)
+            Fstrcat(buf, F(","), size);
+        Mstrcat(buf, desc.Unit, size);
         }
+}
+
+// Sensors with CHT_CUSTOM channels have their own
+void CMySensor::FormatCustom(int channel, char *buf)
+{
+    buf[0] = 0;
+}
+
+/****************************
+ * SampleQuality / RangeMask
+ * 
+ * The values are logged whatever happened to the read; the Quality
+ * digits say what they are worth (QUAL_ flags, MySensor.h). Call
+ * after ReadSensor, before anything clears ErrMsg. See GetQuality
+ * (MySensor.h).
+ */
+uint8_t CMySensor::SampleQuality()
+{
+    if (!SensorAvailable)
+        return(QUAL_UNAVAILABLE);
+    if ((strcmp(ErrMsg.c_str() , "") != 0) || !ReadOK)
+        return(QUAL_FAILED);
+    if (!FreshSample)
+        return(QUAL_STALE);
+    return(QUAL_FRESH);
+}
+
+// From the rated range in the channel table
+uint8_t CMySensor::RangeMask()
+{
+    ChannelDesc desc;
+    uint8_t mask = 0;
     
+    for (int i=0; i < Channels; i++)
+        {
+        GetChannel(i, desc);
+        if ((desc.Type == CHT_NUMBER) && (desc.Min <= desc.Max) &&
+            ((Values[i] < desc.Min) || (Values[i] > desc.Max)))
+            mask |= 1 << i;
+        }
+    return(mask);
 }
- 
+
 /****************************
  * FailSensor
  * 
@@ -64,57 +189,54 @@ void CMySensor::FailSensor(int errcode)
     // format the message
     char msg[80];
 
-    strcpy(msg, SensorName.c_str());
-    Mstrcat(msg," Failure: ", 80);
+    strcpy_P(msg, (PGM_P)SensorName);
+    Fstrcat(msg, F(" Failure: "), 80);
     Mstrcat(msg,(char *)ErrMsg.c_str(), 80);
     FlashStatusError(errcode, msg);
     
     SensorAvailable = false;    
+    InitState = INIT_FAILED;
     
     ErrMsg = "";    // clear ErrMsg
 }
 
+/****************************
+ * SetPhasePeriod
+ * The flight phase profile gives a sample period; a sensor
+ * is never read faster than its natural BasePeriodMsec.
+ * If the new period is shorter, pull the next sample in.
+ */
+void CMySensor::SetPhasePeriod(unsigned long phaseMsec)
+{
+    unsigned long newPeriod = max(BasePeriodMsec, phaseMsec);
+    unsigned long now = FlightMsec();
+    
+    if (newPeriod == SamplePeriodMsec) return;
+    SamplePeriodMsec = newPeriod;
+    if ((long)(NextDueMsec - (now + newPeriod)) > 0)
+        NextDueMsec = now + newPeriod;
+}
+
 // EnableMuxPort()
 // If a sensor is on the mux, need 
 // to enable the port to see the sensor
 void CMySensor::EnableMuxPort(int muxport)
 {
-    if (muxport == NO_MUX) return;
+    if (muxport < 0) return;    // NO_MUX or NO_BUS
     
-    if (muxport > 7) muxport = 7;
-  
-    Wire.beginTransmission(MUX_ADDRESS);
-    //Read the current mux settings
-    Wire.requestFrom((int)MUX_ADDRESS, 1);
-    if (!Wire.available()) return; //Error
-    byte settings = Wire.read();
-  
-    //Set the wanted bit to enable the port
-    settings |= (1 << muxport);
-  
-    Wire.write(settings);
-    Wire.endTransmission();     
+    I2CMux.Select(muxport);
     //debug("        enabled mux port ",muxport);
 }
 
 // DisableMuxPort()
+// While a read plan batch runs the port stays selected for the
+// next sensor on it. See I2CMux.h
 void CMySensor::DisableMuxPort(int muxport)
 {
-    if (muxport == NO_MUX) return;
+    if (muxport < 0) return;
+    if (I2CMux.Batching) return;
     
-    if (muxport > 7) muxport = 7;
-  
-    Wire.beginTransmission(MUX_ADDRESS);
-    //Read the current mux settings
-    Wire.requestFrom((int)MUX_ADDRESS, 1);
-    if (!Wire.available()) return; //Error
-    byte settings = Wire.read();
-  
-    //Clear the wanted bit to disable the port
-    settings &= ~(1 << muxport);
-  
-    Wire.write(settings);
-    Wire.endTransmission();     
+    I2CMux.Deselect();
     //debug("        disabled mux port ",muxport);
 }
 
@@ -125,15 +247,18 @@ void CMySensor::DisableMuxPort(int muxport)
  **************************************/  
 void CBMP388Sensor::InitSensor()
 {
+    I2CBus.Begin(I2C_DEV_BMP388);
     if (MuxPort != NO_MUX)
         EnableMuxPort(MuxPort);
         
     if (!bmp.begin_I2C()) 
         {   // hardware I2C mode, can pass in address & alt Wire
-        FlashStatusError(BMP388_NOT_FOUND, "BMP388 sensor failed to initialize");
+        FlashStatusError(BMP388_NOT_FOUND, F("BMP388 sensor failed to initialize"));
         SensorAvailable = false;
         }
 
+    BasePeriodMsec = BMP388_PERIOD_MSEC;
+
     // Set up oversampling and filter initialization
     bmp.setTemperatureOversampling(BMP3_OVERSAMPLING_8X);
     bmp.setPressureOversampling(BMP3_OVERSAMPLING_4X);
@@ -142,6 +267,7 @@ void CBMP388Sensor::InitSensor()
 
     if (MuxPort != NO_MUX)
         DisableMuxPort(MuxPort);
+    I2CBus.End();
 }
     
 bool CBMP388Sensor::ReadSensor()
@@ -150,51 +276,56 @@ bool CBMP388Sensor::ReadSensor()
 
     if (!SensorAvailable) return(readOK);
     
+    if (!I2CBus.Begin(I2C_DEV_BMP388))
+        {   // backed off after I2C failures; keep the last values
+        ErrMsg = "";
+        FreshSample = false;
+        return(false);
+        }
     if (MuxPort != NO_MUX)
         EnableMuxPort(MuxPort);
         
     ErrMsg="";
-    Value = 0.0;
     if (! bmp.performReading()) 
         {
         ErrMsg = SensorName;
-        ErrMsg += " Failed to perform reading";
+        ErrMsg += F(" Failed to perform reading");
         readOK = false;
         }
     else
         { // good data
-        Value = bmp.pressure / 100.0;         // in hpa
-        bmpTemperature = bmp.temperature;     // in degC
-        bmpAltitude = bmp.readAltitude(MyConfig.SeaLevelPressure);   // in meters
+        Values[CH_BMP_HPA] = bmp.pressure / 100.0;
+        Values[CH_BMP_TEMP] = bmp.temperature;
+        Values[CH_BMP_ALT] = bmp.readAltitude(MyConfig.SeaLevelPressure);
+        AltFilter.BaroUpdate(FlightMsec(), Values[CH_BMP_ALT]);
         }
     if (MuxPort != NO_MUX)
         DisableMuxPort(MuxPort);
+    if (!I2CBus.End(readOK) && readOK)
+        {
+        ErrMsg = SensorName;
+        ErrMsg += F(" I2C timeout");
+        readOK = false;
+        }
     return (readOK);
 }
 
-void CBMP388Sensor::GetHeader(char *buf)
-{
-    strcpy(buf,"  bmpHpa,  bmpAlt, bmpTemp");
-}
+// BMP388 data sheet: 300..1250 hPa, -40..85 degC. Above about
+// 9 km the pressure is below what it is rated for.
+const ChannelDesc BMPChannels[3] PROGMEM =
+    {
+    {"bmpHpa",  "hPa",  CHT_NUMBER, 8, 2, 300.0, 1250.0},
+    {"bmpAlt",  "m",    CHT_NUMBER, 8, 2, NO_RANGE},
+    {"bmpTemp", "degC", CHT_NUMBER, 8, 2, -40.0, 85.0},
+    };
 
-void CBMP388Sensor::GetLogLine(char *buf)
+uint8_t CBMP388Sensor::RangeMask()
 {
-    char buf2[15];
+    uint8_t mask = CMySensor::RangeMask();
     
-    if ((strcmp(ErrMsg.c_str() , "") != 0) || !SensorAvailable)
-        { // err - return empty string
-        strcpy(buf, "        ,        ,        ");  
-        }
-    else
-        { // good read
-        dtostrf(Value,8,2,buf);
-        Mstrcat(buf,",",TheLogger.MAXLOGLINELENGTH);
-        dtostrf(bmpAltitude,8,2,buf2);
-        Mstrcat(buf,buf2,TheLogger.MAXLOGLINELENGTH);
-        Mstrcat(buf,",",TheLogger.MAXLOGLINELENGTH);
-        dtostrf(bmpTemperature,8,2,buf2);
-        Mstrcat(buf,buf2,TheLogger.MAXLOGLINELENGTH);
-        }
+    if (mask & (1 << CH_BMP_HPA))
+        mask |= 1 << CH_BMP_ALT;
+    return(mask);
 }
 
   
@@ -204,80 +335,100 @@ void CBMP388Sensor::GetLogLine(char *buf)
  **************************************/  
 void CVoltSensor::InitSensor()
 {
-    pinMode (PinNum, INPUT);     // for analogRead
+    Channel = AdcEngine.AddChannel(PinNum);
+    LastSeq = 0;
+    if (Channel < 0)
+        {
+        ErrMsg = F("No ADC channel left");
+        SensorAvailable = false;
+        }
 }
-    
+
 bool CVoltSensor::ReadSensor()
 {
-    bool readOK = true;
+    double fraction;
+    uint8_t seq;
+
+    if (!SensorAvailable) return(true);
 
     ErrMsg="";
-    int rdg = analogRead(PinNum);
-    Value = rdg * 5.0 / 1024.0;
-    if (SensorName == "   Volt9")
-      { // The 9 Volt reading uses a voltage divider to get half the actual voltage, so the voltage
-        // fits in the 0..5 Volt range of the AD. Need to double the reading to get the
-        // actual voltage
-      Value = 2.0 * Value;
-
-      // If the voltage gets too low, we end up with the disk files getting
-      // corrupted. If the voltage gets below 8, halt the system.
-      /**** 
-       *  This turned out be be a poor idead. Our battery went too low after 1 hour or so.
-      if (Value < LOW_VOLTAGE_LIMIT)
-          {  // too low
-          digitalWrite(HEATER_LED, LED_ON);
-          digitalWrite(GPS_FIX_ON, LED_ON);
-          digitalWrite(STATUS_LED, LED_ON);
-          while (1);
-          }
-          *******/
-      }
-    
-    return (readOK);
+    if (!AdcEngine.Latest(Channel, fraction, seq))
+        return(false);      // no value yet
+    FreshSample = (seq != LastSeq);
+    LastSeq = seq;
+    Values[CH_MAIN] = fraction * RefVolts * Divider + Offset;
+    return(true);
 }
 
 
 // Create Sensor objects
-//   Select the desired configuration in MySensor.h
-#ifdef PRODUCTION_SENSORS
-CGPSSensor GPSSensor("     GPS", 0, NO_MUX);    // name, pin, muxport
-CCO2Sensor CO2SensorOld("  CO2Old", 0, 1);
-CCO2Sensor CO2SensorNew("  CO2New", 0, 4);
-//CDHTTempSensor TempSensor(" OutTemp", EXTERNTEMP_PIN, NO_MUX);
-//CDS18BTempSensor InternTempSensor(" IntTemp", INTERNTEMP_PIN, NO_MUX);
-//CDS18BTempSensor OutsideTempSensor("OutDSB18", OUTDS18BTEMP_PIN, NO_MUX);
-//CUVSensor UVSensor1("     UV1", 0, 2);
-CUVSensor UVSensor2("     UV2", 0, 7);
-CBMP388Sensor BMP388Sensor("Pressure", 0, 2);
-//CVoltSensor Volt9Sensor("   Volt9", PINVOLT9, NO_MUX);
-//CVoltSensor Volt37Sensor("   Volt37", PINVOLT37, NO_MUX);
-
-CMySensor *SensorArr[] = {&GPSSensor, &CO2SensorOld,&CO2SensorNew, 
-//          &TempSensor, &InternTempSensor, &OutsideTempSensor,
-          &BMP388Sensor, &UVSensor2};
-#endif
-
-// Sensors used in the ColdBox test setup
-#ifdef COLDBOX_SENSORS
-CGPSSensor GPSSensor("     GPS", 0, NO_MUX);    // name, pin, muxport
-CCO2Sensor CO2SensorOld("  CO2Old", 0, 1);
-CCO2Sensor CO2SensorNew("  CO2New", 0, 4);
-//CDHTTempSensor TempSensor(" OutTemp", EXTERNTEMP_PIN, NO_MUX);
-//CDS18BTempSensor InternTempSensor(" IntTemp", INTERNTEMP_PIN, NO_MUX);
-//CDS18BTempSensor OutsideTempSensor("OutDSB18", OUTDS18BTEMP_PIN, NO_MUX);
-CUVSensor UVSensor1("     UV1", 0, 2);
-CUVSensor UVSensor2("     UV2", 0, 7);
-//CBMP388Sensor BMP388Sensor("Pressure", 0, 2);
-//CVoltSensor Volt9Sensor("   Volt9", PINVOLT9, NO_MUX);
-//CVoltSensor Volt37Sensor("   Volt37", PINVOLT37, NO_MUX);
-
-CMySensor *SensorArr[] = {&GPSSensor, &CO2SensorOld,&CO2SensorNew, 
-//          &TempSensor, &InternTempSensor, &OutsideTempSensor,
-          &UVSensor2, &UVSensor2};
-#endif
-
-int MaxSensors = (sizeof(SensorArr) / sizeof(int));  
+//   Select the desired set in MySensor.h
+// Sensor names, kept in flash. The csv header and logs use them
+FLASH_STRING(GPSName,      "     GPS");
+FLASH_STRING(CO2OldName,   "  CO2Old");
+FLASH_STRING(CO2NewName,   "  CO2New");
+FLASH_STRING(OutTempName,  " OutTemp");
+FLASH_STRING(IntTempName,  " IntTemp");
+FLASH_STRING(OutDSB18Name, "OutDSB18");
+FLASH_STRING(UV1Name,      "     UV1");
+FLASH_STRING(UV2Name,      "     UV2");
+FLASH_STRING(PressureName, "Pressure");
+FLASH_STRING(FusionName,   "  Fusion");
+FLASH_STRING(ClockName,    "   Clock");
+FLASH_STRING(Volt9Name,    "   Volt9");
+FLASH_STRING(Volt37Name,   "   Volt37");
+
+// The selected set's objects (MySensor.h), in column order.
+// Everything walks them through SensorSet.h
+#define SENSOR_OBJECT(type, object, name, pin, muxport, ...) \
+    type object(FPSTR(name), pin, muxport, ##__VA_ARGS__);
+SENSOR_SET(SENSOR_OBJECT)
+
+/****************************
+ * Sensor set checks
+ * A row with the same class, pin and mux port as another is the
+ * same sensor listed twice. All three sets are checked, not just the
+ * selected one, so a bad row doesn't wait for someone to switch sets.
+ * Everything that grows with the sensor set is sized at compile time,
+ * so check it here rather than find out in flight. See Arena.h
+ */
+struct SensorKey
+{
+    const char *Type;
+    int Pin;
+    int MuxPort;
+};
+#define SENSOR_KEY(type, object, name, pin, muxport, ...)   {#type, pin, muxport},
+#define SENSOR_RAM(type, ...)               + sizeof(type)
+static constexpr SensorKey ProductionKeys[] = {PRODUCTION_SET(SENSOR_KEY)};
+static constexpr SensorKey ColdBoxKeys[] = {COLDBOX_SET(SENSOR_KEY)};
+static constexpr SensorKey ReplayKeys[] = {REPLAY_SET(SENSOR_KEY)};
+
+static constexpr bool SameText(const char *a, const char *b)
+{
+    return((*a == *b) && ((*a == 0) || SameText(a + 1, b + 1)));
+}
+
+static constexpr bool SameSensor(const SensorKey &a, const SensorKey &b)
+{
+    return((a.Pin == b.Pin) && (a.MuxPort == b.MuxPort) && SameText(a.Type, b.Type));
+}
+
+// Row i of keys[n] against every row after it, from row j on
+static constexpr bool NoRepeats(const SensorKey *keys, int n, int i, int j)
+{
+    return((i >= n) ? true :
+           (j >= n) ? NoRepeats(keys, n, i + 1, i + 2) :
+           (!SameSensor(keys[i], keys[j]) && NoRepeats(keys, n, i, j + 1)));
+}
+
+#define SET_KEYS_OK(keys)   NoRepeats(keys, sizeof(keys) / sizeof(keys[0]), 0, 1)
+
+static_assert(SET_KEYS_OK(ProductionKeys), "A sensor is listed twice in PRODUCTION_SET (MySensor.h)");
+static_assert(SET_KEYS_OK(ColdBoxKeys), "A sensor is listed twice in COLDBOX_SET (MySensor.h)");
+static_assert(SET_KEYS_OK(ReplayKeys), "A sensor is listed twice in REPLAY_SET (MySensor.h)");
+static_assert((0 SENSOR_SET(SENSOR_RAM)) + ARENA_RAM_BYTES <= RAM_BUDGET_BYTES,
+              "Sensor set is over RAM_BUDGET_BYTES. See Arena.h");
 
 
 
@@ -295,10 +446,9 @@ void CHeaterControl::Init()
 {
     HeaterOn = false;
     pinMode(HEATER_PIN, OUTPUT);
-    pinMode(HEATER_LED, OUTPUT);
     
     digitalWrite(HEATER_PIN,LOW);     // heater off
-    digitalWrite(HEATER_LED,LED_OFF); // LED off
+    StatusLeds.SetLed(LEDBIT_HEATER, false); // LED off
 }
 
          
@@ -307,21 +457,21 @@ void CHeaterControl::HeaterOnOff(double theTemp)
     if ((theTemp < HEATER_LOW_LIMIT) && (theTemp > -273.0))
         {
         digitalWrite(HEATER_PIN, HIGH);     // start frying  
-        digitalWrite(HEATER_LED,LED_ON);  
+        StatusLeds.SetLed(LEDBIT_HEATER, true);  
         HeaterOn = true;
         }
     else if (theTemp > HEATER_HIGH_LIMIT)
         {
         digitalWrite(HEATER_PIN, LOW);     // stop frying  
-        digitalWrite(HEATER_LED,LED_OFF);  
+        StatusLeds.SetLed(LEDBIT_HEATER, false);  
         HeaterOn = false;
         }
     else
         { // bad read
         digitalWrite(HEATER_PIN, LOW);     // stop frying  
-        digitalWrite(HEATER_LED,LED_OFF);  
+        StatusLeds.SetLed(LEDBIT_HEATER, false);  
         HeaterOn = false;
         }
 }
 
-CHeaterControl HeaterControl;
+CHeaterControl HeaterControl;
@@ -7,6 +7,8 @@
 
 //if sensor is direct, not going through the I2C mux, use this
 const int NO_MUX =    -1;
+//if the "sensor" doesn't use the bus at all (computed values), use this
+const int NO_BUS =    -2;
 #define MUX_ADDRESS   0x70      // I2C address of the mux
 
 /***************** BMP380 stuff *******************/
@@ -19,6 +21,8 @@ const int NO_MUX =    -1;
 
 /***************** DHT22 stuff *******************/
 #include <DHT.h>
+#include "DHTReader.h"
+#include "AdcEngine.h"
 
 /***************** VEML6075 stuff *******************/
 //#include "Adafruit_VEML6075.h"
@@ -40,12 +44,156 @@ const int NO_MUX =    -1;
 #include <CACLogger.h> 
 extern CLogger TheLogger;
 
-// Select the desired set of sensors.
-// See near the end of MySensor.cpp for the sensor setup
+// Select the desired set of sensors, one of the three.
+//
+// Each set is a typed list, one row per sensor in csv column order:
+//     SENSOR(class, object, name, pin, muxport [, more constructor args])
+// MySensor.cpp builds the sensor objects from the selected rows,
+// SensorSet.h the compile-time list every sensor loop runs over,
+// and NUM_SENSORS (it sizes the log buffers, see Arena.h) is
+// counted from them, so a set is written down once. A sensor
+// listed twice (same class, pin and mux port) in any of the sets
+// fails the build. To leave a sensor out, wrap its row in
+// /* */: a // comment would end the list. The HostTools builds pick
+// the set on the compiler command line instead.
+#if !defined(PRODUCTION_SENSORS) && !defined(COLDBOX_SENSORS) && !defined(REPLAY_SENSORS)
 #define PRODUCTION_SENSORS
-#define SENSOR_SET_NAME "Production Sensors"
 //#define COLDBOX_SENSORS
-//#define SENSOR_SET_NAME "Cold Box Sensors"
+//#define REPLAY_SENSORS        // replay a logged flight fed over Serial. See FlightReplay.h
+#endif
+
+#define PRODUCTION_SET_NAME "Production Sensors"
+#define PRODUCTION_SET(SENSOR) \
+    SENSOR(CGPSSensor,       GPSSensor,          GPSName,      0, NO_MUX) \
+    SENSOR(CCO2Sensor,       CO2SensorOld,       CO2OldName,   0, 1) \
+    SENSOR(CCO2Sensor,       CO2SensorNew,       CO2NewName,   0, 4) \
+    /* SENSOR(CDHTTempSensor,   TempSensor,         OutTempName,  EXTERNTEMP_PIN, NO_MUX) */ \
+    /* SENSOR(CDS18BTempSensor, InternTempSensor,   IntTempName,  INTERNTEMP_PIN, NO_MUX) */ \
+    /* SENSOR(CDS18BTempSensor, OutsideTempSensor,  OutDSB18Name, OUTDS18BTEMP_PIN, NO_MUX) */ \
+    SENSOR(CBMP388Sensor,    BMP388Sensor,       PressureName, 0, 2) \
+    /* SENSOR(CUVSensor,        UVSensor1,          UV1Name,      0, 2) */ \
+    SENSOR(CUVSensor,        UVSensor2,          UV2Name,      0, 7) \
+    SENSOR(CFusionSensor,    FusionSensor,       FusionName,   0, NO_BUS) \
+    SENSOR(CClockSensor,     ClockSensor,        ClockName,    0, NO_BUS) \
+    /* SENSOR(CVoltSensor,      Volt9Sensor,        Volt9Name,    PINVOLT9, NO_MUX, VOLT9_DIVIDER) */ \
+    /* SENSOR(CVoltSensor,      Volt37Sensor,       Volt37Name,   PINVOLT37, NO_MUX) */
+
+// Sensors used in the ColdBox test setup
+#define COLDBOX_SET_NAME "Cold Box Sensors"
+#define COLDBOX_SET(SENSOR) \
+    SENSOR(CGPSSensor,       GPSSensor,          GPSName,      0, NO_MUX) \
+    SENSOR(CCO2Sensor,       CO2SensorOld,       CO2OldName,   0, 1) \
+    SENSOR(CCO2Sensor,       CO2SensorNew,       CO2NewName,   0, 4) \
+    /* SENSOR(CDHTTempSensor,   TempSensor,         OutTempName,  EXTERNTEMP_PIN, NO_MUX) */ \
+    /* SENSOR(CDS18BTempSensor, InternTempSensor,   IntTempName,  INTERNTEMP_PIN, NO_MUX) */ \
+    /* SENSOR(CDS18BTempSensor, OutsideTempSensor,  OutDSB18Name, OUTDS18BTEMP_PIN, NO_MUX) */ \
+    /* SENSOR(CBMP388Sensor,    BMP388Sensor,       PressureName, 0, 2) */ \
+    SENSOR(CUVSensor,        UVSensor1,          UV1Name,      0, 2) \
+    SENSOR(CUVSensor,        UVSensor2,          UV2Name,      0, 7) \
+    SENSOR(CClockSensor,     ClockSensor,        ClockName,    0, NO_BUS) \
+    /* SENSOR(CVoltSensor,      Volt9Sensor,        Volt9Name,    PINVOLT9, NO_MUX, VOLT9_DIVIDER) */ \
+    /* SENSOR(CVoltSensor,      Volt37Sensor,       Volt37Name,   PINVOLT37, NO_MUX) */
+
+// Stand-in sensors fed from a logged flight (see FlightReplay.h).
+// Must list the same sensors, in the same order, as the flight's set.
+// The Fusion and Clock columns are computed, not replayed, so a flight
+// logged before the altitude filter existed replays with them filled
+// in; they go after the replayed sensors.
+#define REPLAY_SET_NAME "Replay Sensors"
+#define REPLAY_SET(SENSOR) \
+    SENSOR(CReplayGPSSensor,       ReplayGPS,      GPSName,      0, NO_MUX) \
+    SENSOR(CReplayCO2Sensor,       ReplayCO2Old,   CO2OldName,   0, 1) \
+    SENSOR(CReplayCO2Sensor,       ReplayCO2New,   CO2NewName,   0, 4) \
+    /* SENSOR(CReplayDHTTempSensor,   ReplayOutTemp,  OutTempName,  EXTERNTEMP_PIN, NO_MUX) */ \
+    /* SENSOR(CReplayDS18BTempSensor, ReplayIntTemp,  IntTempName,  INTERNTEMP_PIN, NO_MUX) */ \
+    SENSOR(CReplayBMP388Sensor,    ReplayPressure, PressureName, 0, 2) \
+    SENSOR(CReplayUVSensor,        ReplayUV2,      UV2Name,      0, 7) \
+    SENSOR(CFusionSensor,          FusionSensor,   FusionName,   0, NO_BUS) \
+    SENSOR(CClockSensor,           ClockSensor,    ClockName,    0, NO_BUS)
+
+#if defined(PRODUCTION_SENSORS) + defined(COLDBOX_SENSORS) + defined(REPLAY_SENSORS) != 1
+#error "Select exactly one sensor set in MySensor.h"
+#elif defined(PRODUCTION_SENSORS)
+#define SENSOR_SET_NAME     PRODUCTION_SET_NAME
+#define SENSOR_SET          PRODUCTION_SET
+#elif defined(COLDBOX_SENSORS)
+#define SENSOR_SET_NAME     COLDBOX_SET_NAME
+#define SENSOR_SET          COLDBOX_SET
+#else
+#define SENSOR_SET_NAME     REPLAY_SET_NAME
+#define SENSOR_SET          REPLAY_SET
+#endif
+
+#define SENSOR_COUNT(...)   + 1
+#define NUM_SENSORS         (0 SENSOR_SET(SENSOR_COUNT))
+
+// Sensor initialization states. Init is split into StartInit(), which kicks off
+// the slow operations, and PollInit(), which is called from loop() until the
+// sensor is ready. This lets sampling start before the slowest sensor is done.
+#define INIT_IDLE       0     // StartInit not called yet
+#define INIT_WAITING    1     // slow operation started, polling for completion
+#define INIT_READY      2     // sensor can be read
+#define INIT_FAILED     3     // init failed or ran past the boot budget
+
+#define INIT_BUDGET_MSEC  15000   // total boot time allowed for all sensors to finish init
+#define INIT_POLL_MSEC    50      // longest sleep while inits are pending
+
+// Select the logging layout. By default every sensor is read each loop and
+// logged as one wide csv row. LOG_STREAMS reads each sensor at its own
+// SamplePeriodMsec and logs it to its own stream. See StreamLog.h
+//#define LOG_STREAMS
+
+// Benchmark build: time the per-sample code at boot, print the
+// results and stop. Not for flight. See Bench.h
+//#define RUN_BENCHMARKS
+
+// Room for a driver object (OneWire, DHT, ...) inside the sensor object.
+// InitSensor builds the driver there with placement new, so it is static
+// like the sensor, and never on the heap.
+#define DRIVER_STORAGE(type, name)   alignas(type) uint8_t name[sizeof(type)]
+
+// Longest header or log fields one sensor writes into the GetHeader or
+// GetLogLine buf (chars, without the terminator)
+#define LOG_FIELD_LENGTH    48
+
+// Sample quality. Each data record ends in a Quality column with one
+// hex digit per log channel (column), in column order, so a failed or
+// repeated value is still logged - no blank fields - and the host
+// tools can tell it from a fresh one. The digit is a mask of:
+#define QUAL_FRESH          0x0     // new reading
+#define QUAL_STALE          0x1     // repeat of an earlier reading (no new data, I2C back-off)
+#define QUAL_FAILED         0x2     // this read failed; value is left over
+#define QUAL_UNAVAILABLE    0x4     // sensor not initialized, failed, or no data yet
+#define QUAL_RANGE          0x8     // outside the sensor's rated range
+#define MAX_SENSOR_CHANNELS 4       // log columns one sensor writes, at most
+
+// Channels. Each sensor class has a table of ChannelDesc in flash,
+// one per log column, and keeps the latest reading of each in
+// Values[], in the same order. The csv header, the log fields, the
+// units and the range check are all done from the table by the base
+// class, so a sensor class only has to fill Values[].
+#define CHT_NUMBER      0       // dtostrf(value, Width, Precision)
+#define CHT_ONOFF       1       // heater: On / Off, blank if the value is NAN
+#define CHT_CUSTOM      2       // the sensor formats it (FormatCustom)
+#define CH_NAME_LENGTH  10
+#define CH_UNIT_LENGTH  6
+
+struct ChannelDesc
+{
+    char Name[CH_NAME_LENGTH];      // csv header, padded to Width; "" is the sensor's name
+    char Unit[CH_UNIT_LENGTH];      // like hPa; "" if none
+    uint8_t Type;                   // CHT_NUMBER ..
+    uint8_t Width;                  // csv field width
+    uint8_t Precision;              // decimals
+    float Min, Max;                 // rated range, QUAL_RANGE outside it; Min > Max for none
+};
+
+#define NO_RANGE        1.0, 0.0    // Min, Max of a channel with no rated range
+#define NUM_CHANNELS(table)   (sizeof(table) / sizeof(table[0]))
+
+// One column, the sensor's name, no range
+#define CH_MAIN         0
+extern const ChannelDesc DefaultChannels[1];
 
 
 /*********************************************
@@ -72,18 +220,34 @@ private:
  * 
  * Base class for Sensors in general. This class is
  * subclassed to create the actual sensors.
+ *
+ * There are no virtuals, so the sensors carry no vtable. Every
+ * sensor is reached through the set in SensorSet.h, with its own
+ * class known, and each call is a direct one. A sensor class has
+ *     void InitSensor();      // code for setup() initialization
+ *     bool ReadSensor();      // read the sensor
+ * and declares its own FormatCustom, SampleQuality or RangeMask to
+ * replace the ones here (see GetLogLine and GetQuality below). A
+ * sensor with a slow init has StartInit and PollInit, see SensorInit.
  */
 class CMySensor
 {
 public:
   // muxport = -1 if not connected to a mux port
-  CMySensor(char *sensorName, int pin, int muxport);    // constructor
+  CMySensor(const __FlashStringHelper *sensorName, int pin, int muxport,
+            const ChannelDesc *channels = DefaultChannels, int numChannels = 1);    // constructor
   
-  virtual void InitSensor() = 0;         // code for setup() initialization  0=> pure virtual?
-  virtual bool ReadSensor() = 0;         // read the sensor
-  virtual void GetHeader(char *buf);     // csv field header, like Temperature
-  virtual void GetLogLine(char *buf);    // csv field string, like 1234.0
+  void AbortInit();                      // init ran past INIT_BUDGET_MSEC
+  void GetHeader(char *buf);             // csv field header, like Temperature
+  void GetUnits(char *buf, int size);    // like hPa,m,degC; size counts the terminator
+  void FormatCustom(int channel, char *buf);    // a CHT_CUSTOM field; blank
+  uint8_t SampleQuality();               // QUAL_ flags for the whole sample
+  uint8_t RangeMask();                   // channel n outside its rated range => bit n
+  int  NumChannels() { return(Channels); }     // log columns
+  void GetChannel(int i, ChannelDesc &desc);   // from the table in flash
+  bool FormatChannel(int i, char *buf);        // one field; false for CHT_CUSTOM, left to FormatCustom
   void FailSensor(int errcode);          // Logs Initialization failure message
+  void SetPhasePeriod(unsigned long phaseMsec);  // flight phase profile period
 
   void HeaterOnOff();           // used by Temperature sensor to turn on heaters
   bool HeaterOn;
@@ -91,117 +255,241 @@ public:
   void EnableMuxPort(int muxport);   
   void DisableMuxPort(int muxport);   
   
-  double Value;                  // current data value of ReadSensor
+  double Values[MAX_SENSOR_CHANNELS];   // latest reading of each channel
   String ErrMsg;                 // err msg in case read fails
-  String SensorName;
+  const __FlashStringHelper *SensorName;    // in flash. See FLASH_STRING
   int    PinNum;                 // Arduino pin for reading the sensor, if needed
                                  // If I2C sensor, holds alternate I2C address
   int    MuxPort;                // NO_MUX if not on the mux
 
   bool SensorAvailable;         // true allows operation. False skips readings
+  unsigned long BasePeriodMsec;   // natural (fastest useful) sample period
+  unsigned long SamplePeriodMsec;  // current period, used with LOG_STREAMS. See FlightPhase.h
+  unsigned long NextDueMsec;    // when the next stream sample is due
+  bool FreshSample;             // last ReadSensor got new data (not a repeat)
+  bool ReadOK;                  // what the last ReadSensor returned
+  int  InitState;               // INIT_IDLE .. INIT_FAILED
+  int  InitErrCode;             // error code flashed if init times out
+  unsigned long InitStartMsec;  // millis() when StartInit was called
 private:
+  const ChannelDesc *ChannelTable;    // in flash
+  int8_t Channels;
+};
+
+/****************************
+ * GetLogLine / GetQuality
+ * The sensor's csv fields (like 1234.0) and its Quality digits, one
+ * per channel. Called with the sensor's own class, so its own
+ * FormatCustom, SampleQuality and RangeMask are the ones used. The
+ * formatting itself is in FormatChannel, out of the template, so
+ * each sensor class adds only the loop (and PSTR stays out of
+ * templates, where avr-gcc can put it in a conflicting section).
+ */
+template<class T> void GetLogLine(T &sensor, char *buf)
+{
+    char *p = buf;
+    
+    for (int i=0; i < sensor.NumChannels(); i++)
+        {
+        if (i > 0)
+            *p++ = ',';
+        if (!sensor.FormatChannel(i, p))
+            sensor.FormatCustom(i, p);
+        p += strlen(p);
+        }
+}
+
+template<class T> void GetQuality(T &sensor, char *buf)
+{
+    uint8_t quality = sensor.SampleQuality();
+    uint8_t range = (quality & (QUAL_UNAVAILABLE | QUAL_FAILED)) ? 0 : sensor.RangeMask();
+    int n = sensor.NumChannels();
+    
+    for (int i=0; i < n; i++)
+        {
+        uint8_t q = quality | ((range & (1 << i)) ? QUAL_RANGE : 0);
+        buf[i] = q < 10 ? '0' + q : 'A' + q - 10;
+        }
+    buf[n] = 0;
+}
+
+/****************************
+ * SensorInit
+ * setup() starts every sensor's init, then loop() polls the ones
+ * still INIT_WAITING. The default is for sensors that have nothing
+ * to wait for: InitSensor runs at once and the sensor is ready (or
+ * failed). A class with a slow first operation (first conversion,
+ * warm-up, first measurement) has its own StartInit, which only
+ * kicks it off and sets INIT_WAITING with SensorAvailable false, and
+ * PollInit, which checks for completion without blocking; it says
+ * so with SLOW_INIT after the class. A class derived from one, like
+ * a replay stand-in, gets the default again.
+ */
+template<class T> struct SensorInit
+{
+    static void Start(T &sensor)
+        {
+        sensor.InitStartMsec = millis();
+        sensor.InitSensor();
+        sensor.InitState = sensor.SensorAvailable ? INIT_READY : INIT_FAILED;
+        }
+    static bool Poll(T &sensor)     { return(sensor.InitState != INIT_WAITING); }
 };
 
+#define SLOW_INIT(type) \
+    template<> struct SensorInit<type> \
+    { \
+        static void Start(type &sensor)     { sensor.StartInit(); } \
+        static bool Poll(type &sensor)      { return(sensor.PollInit()); } \
+    };
+
 /********************************************************
  * CO2 sensor - SCD30
  *     also gives temperature (outside) and Relative Humidity
  *     I2C connection
  */
+#define CH_CO2_PPM      0
+#define CH_CO2_TEMP     1       // degC
+#define CH_CO2_RH       2       // %
+extern const ChannelDesc CO2Channels[3];
+
+// SCD30 init steps, one per PollInit. See CO2UV.cpp
+#define SCD30_INIT_BEGIN    0       // find it, soft reset, start measuring
+#define SCD30_INIT_INTERVAL 1       // measurement interval
+#define SCD30_INIT_FIRST    2       // wait for the first measurement
+
 class CCO2Sensor: public CMySensor
 {
 public:
-    CCO2Sensor(char *name, int pin, int muxport) : CMySensor(name, pin, muxport){}
+    CCO2Sensor(const __FlashStringHelper *name, int pin, int muxport)
+        : CMySensor(name, pin, muxport, CO2Channels, NUM_CHANNELS(CO2Channels)){}
     void InitSensor();
+    void StartInit();
+    bool PollInit();
     bool ReadSensor();
-    void GetHeader(char *buf);      // Use base routine
-    void GetLogLine(char *buf);    
 
-    // Value is CO2 in ppm
-    double scd30Temp;               // temp in degC
-    double scd30RH;                 // Relative Humidity in %
+protected:
+    int InitStep = SCD30_INIT_BEGIN;    // SCD30_INIT_ step PollInit runs next
 };
+SLOW_INIT(CCO2Sensor)
 
 /********************************************************
  * GPS sensor - sparkfun u-blox SAM-M8Q breakout
  */
+#define CH_GPS_ALT      0       // m
+#define CH_GPS_LAT      1       // deg
+#define CH_GPS_LON      2
+extern const ChannelDesc GPSChannels[3];
+
+// GPS init steps, one per PollInit. See GPSSensor.cpp
+#define GPS_INIT_BEGIN      0       // find the receiver
+#define GPS_INIT_OUTPUT     1       // I2C port output
+#define GPS_INIT_AIDING     2       // startup sequence, see GpsAiding.h
+#define GPS_INIT_WAIT_MSEC  250     // longest wait for each u-blox answer
+#define GPS_INIT_TRIES      4       // begin() tries before giving up
+#define GPS_INIT_RETRY_MSEC 1000    // between begin() tries
+#define GPS_ADDRESS         0x42
+
 class CGPSSensor: public CMySensor
 {
 public:
-  CGPSSensor(char *name, int pin, int muxport) : CMySensor(name, pin, muxport){}
+  CGPSSensor(const __FlashStringHelper *name, int pin, int muxport)
+      : CMySensor(name, pin, muxport, GPSChannels, NUM_CHANNELS(GPSChannels)){}
   void InitSensor();
+  void StartInit();
+  bool PollInit();
   bool ReadSensor();    // returns altitude
-  void GetHeader(char *buf);     // override base
-  void GetLogLine(char *buf);    // csv field string, like 1234.0
-
-  // GPS-only variables
-  // Value is altitude
-  double Latitude;
-  double Longitude;
 
   bool GPS_fix;     // true - we have a fix
 
-private:
+protected:
+    void FixFound();      // log time to fix, LED on
+    void FixLost();       // log time fix was held, LED off
+
+    int InitStep = GPS_INIT_BEGIN;      // GPS_INIT_ step PollInit runs next
+    int InitTries = 0;
+    unsigned long InitRetryMsec = 0;    // next begin() try
+
 
     // Used to measure time to get a fix
     uint32_t startFixTime = millis();   // tracking how long to get a fix
 };
+SLOW_INIT(CGPSSensor)
+
+// Temperature sensors. With UseForHeaterControl the HeaterOn column
+// shows the heater; otherwise it is blank (NAN)
+#define CH_TEMP         0       // degC
+#define CH_TEMP_HEATER  1
+#define CH_DHT_HUMID    2       // %
+extern const ChannelDesc DHTChannels[3];
+extern const ChannelDesc DS18BChannels[2];
 
 class CDHTTempSensor: public CMySensor
 {
 public:
-  CDHTTempSensor(char *name, int pin, int muxport) : CMySensor(name, pin, muxport){}
+  CDHTTempSensor(const __FlashStringHelper *name, int pin, int muxport)
+      : CMySensor(name, pin, muxport, DHTChannels, NUM_CHANNELS(DHTChannels)){}
   void InitSensor();
+  void StartInit();
+  bool PollInit();
   bool ReadSensor();
-  void GetHeader(char *buf);     // override base
-  void GetLogLine(char *buf);    // csv field string, like 1234.0
 
   bool UseForHeaterControl;     // default false
-  double Humidity;
-  DHT *dht;
+  DHT *dht;                     // built in dhtMem, if the pin has no interrupt
+
+private:
+  CDHTReader Reader;            // interrupt driven frames, see DHTReader.h
+  bool UseReader;               // false: blocking DHT library reads
+  DRIVER_STORAGE(DHT, dhtMem);
 };
+SLOW_INIT(CDHTTempSensor)
 
 class CDS18BTempSensor: public CMySensor
 {
 public:
-    CDS18BTempSensor(char *name, int pin, int muxport) : CMySensor(name, pin, muxport){}
+    CDS18BTempSensor(const __FlashStringHelper *name, int pin, int muxport)
+        : CMySensor(name, pin, muxport, DS18BChannels, NUM_CHANNELS(DS18BChannels)){}
     void InitSensor();
+    void StartInit();
+    bool PollInit();
     bool ReadSensor();
-    void GetHeader(char *buf);     // override base
-    void GetLogLine(char *buf);    // csv field string, like 1234.0
   
     void printAddress(DeviceAddress deviceAddress);
     bool UseForHeaterControl;     // default false
 
 private:
-    OneWire *oneWire; 
+    OneWire *oneWire;                   // built in oneWireMem
     
     // Pass our oneWire reference to Dallas Temperature.  
-    DallasTemperature *sensors; 
+    DallasTemperature *sensors;         // built in sensorsMem
+    DRIVER_STORAGE(OneWire, oneWireMem);
+    DRIVER_STORAGE(DallasTemperature, sensorsMem);
     
     // arrays to hold device address 
     DeviceAddress insideThermometer; 
 
 };
+SLOW_INIT(CDS18BTempSensor)
+
+#define CH_UV_UVA       0
+#define CH_UV_UVB       1
+#define CH_UV_INDEX     2
+extern const ChannelDesc UVChannels[3];
 
 class CUVSensor: public CMySensor
 {
 public:
-  CUVSensor(char *name, int pin, int muxport) : CMySensor(name, pin, muxport){}
+  CUVSensor(const __FlashStringHelper *name, int pin, int muxport)
+      : CMySensor(name, pin, muxport, UVChannels, NUM_CHANNELS(UVChannels)){}
   void InitSensor();
   bool ReadSensor();
-  void GetHeader(char *buf);     // csv field header, like Temperature
-  void GetLogLine(char *buf);    // csv field string, like 1234.0
-
-  // UV-only variables
-  double UVB;            // UVA is in Value
-  double UVindex;        // UV index
 };
 
 /****** replace this if we find one that works
 class CCH4Sensor: public CMySensor
 {
 public:
-  CCH4Sensor(char *name, int pin, int muxport) : CMySensor(name, pin, muxport){}
+  CCH4Sensor(const __FlashStringHelper *name, int pin, int muxport) : CMySensor(name, pin, muxport){}
   void InitSensor();
   bool ReadSensor();    // returns altitude
   void GetHeader(char *buf);     // override base
@@ -215,7 +503,7 @@ public:
 class COzoneSensor: public CMySensor
 {
 public:
-    COzoneSensor(char *name, int pin, int muxport) : CMySensor(name, pin, muxport){}
+    COzoneSensor(const __FlashStringHelper *name, int pin, int muxport) : CMySensor(name, pin, muxport){}
     void InitSensor();
     bool ReadSensor();    // returns altitude
     void GetHeader(char *buf);     // override base
@@ -229,45 +517,95 @@ public:
 };
 *****/
 
+#define CH_BMP_HPA      0
+#define CH_BMP_ALT      1       // m
+#define CH_BMP_TEMP     2       // degC
+extern const ChannelDesc BMPChannels[3];
+
 class CBMP388Sensor: public CMySensor
 {
 public:
-  CBMP388Sensor(char *name, int pin, int muxport) : CMySensor(name, pin, muxport){}
+  CBMP388Sensor(const __FlashStringHelper *name, int pin, int muxport)
+      : CMySensor(name, pin, muxport, BMPChannels, NUM_CHANNELS(BMPChannels)){}
   void InitSensor();
   bool ReadSensor();
-  void GetHeader(char *buf);     // csv field header, like Temperature
-  void GetLogLine(char *buf);    // csv field string, like 1234.0
+  uint8_t RangeMask();           // the altitude comes from the pressure
+};
+
 
-  // Value is the pressure
-  // Also reads Altitude and temperature
-  double bmpAltitude;            // in meters
-  double bmpTemperature;         // in degC
+/********************************************************
+ * Fusion - not a device. Logs the altitude and vertical
+ * rate from AltFilter (see AltitudeFilter.h), which the GPS
+ * and BMP388 sensors feed. List it after them in the set.
+ */
+#define CH_FUSE_ALT     0       // m
+#define CH_FUSE_RATE    1       // m/s, positive up
+#define CH_FUSE_ALTSIG  2       // m, 1 sigma
+#define CH_FUSE_RATESIG 3       // m/s, 1 sigma
+extern const ChannelDesc FusionChannels[4];
+
+class CFusionSensor: public CMySensor
+{
+public:
+  CFusionSensor(const __FlashStringHelper *name, int pin, int muxport)
+      : CMySensor(name, pin, muxport, FusionChannels, NUM_CHANNELS(FusionChannels)){}
+  void InitSensor();
+  bool ReadSensor();
+  uint8_t SampleQuality();       // unavailable until the filter has data
 };
 
 
-class CVoltSensor: public CMySensor
+/********************************************************
+ * Clock - not a device. Logs the GPS disciplined UTC from
+ * Timebase (see Timebase.h). List it last in the set.
+ */
+// The date and second of day don't fit a float (AVR double); they
+// are formatted from Utc
+#define CH_CLOCK_DATE   0
+#define CH_CLOCK_SEC    1
+#define CH_CLOCK_PPM    2       // rate correction
+extern const ChannelDesc ClockChannels[3];
+
+class CClockSensor: public CMySensor
 {
 public:
-  CVoltSensor(char *name, int pin, int muxport) : CMySensor(name, pin, muxport){}
+  CClockSensor(const __FlashStringHelper *name, int pin, int muxport)
+      : CMySensor(name, pin, muxport, ClockChannels, NUM_CHANNELS(ClockChannels)){}
   void InitSensor();
-  bool ReadSensor();    // returns altitude
+  bool ReadSensor();
+  void FormatCustom(int channel, char *buf);    // date and second of day, from Utc
+  uint8_t SampleQuality();       // unavailable until the GPS gives the time
+
+  int64_t Utc;                   // usec since 1970, when read
 };
 
-extern CGPSSensor GPSSensor;
-extern CCO2Sensor CO2Sensor;
-extern CDS18BTempSensor InternTempSensor;
-extern CDHTTempSensor TempSensor;
-extern CUVSensor UVSensor;
-//extern COzoneSensor O3Sensor;
-extern CVoltSensor CVolt9Sensor;
-extern CVoltSensor CVolt37Sensor;
-extern CBMP388Sensor BMP388Sensor;
-//extern CCH4Sensor CH4Sensor;
 
-extern CMySensor *SensorArr[];
-extern int MaxSensors;
+/********************************************************
+ * Voltage - an analog pin, read through AdcEngine (see
+ * AdcEngine.h). Each instance has its own calibration:
+ *   Value = pin fraction of full scale * refVolts * divider + offset
+ */
+class CVoltSensor: public CMySensor
+{
+public:
+  CVoltSensor(const __FlashStringHelper *name, int pin, int muxport,
+              double divider = 1.0, double offset = 0.0, double refVolts = ADC_REF_VOLTS)
+      : CMySensor(name, pin, muxport), Divider(divider), Offset(offset), RefVolts(refVolts){}
+  void InitSensor();
+  bool ReadSensor();    // latest filtered value, no waiting
+
+  double Divider;       // input volts per volt at the pin
+  double Offset;        // volts added after scaling
+  double RefVolts;      // ADC reference
+
+private:
+  int Channel;          // in AdcEngine
+  uint8_t LastSeq;      // AdcEngine value last read
+};
+
+const int MaxSensors = NUM_SENSORS;     // known at compile time
 
 extern CHeaterControl HeaterControl;
 
 
-#endif
+#endif
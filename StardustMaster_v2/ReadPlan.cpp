@@ -0,0 +1,91 @@
+/**************************************************
+ * ReadPlan
+ *
+ * Implementation of CReadPlan, the mux-grouped sensor
+ * read order. See ReadPlan.h
+ *************************************************/
+
+#include "ReadPlan.h"
+#include "SensorSet.h"
+#include "MemMonitor.h"
+#include "I2CMux.h"
+
+CReadPlan::CReadPlan()   // constructor
+{
+}
+
+// One sensor's read. See SensorSet.h
+struct ReadStep
+{
+    template<class T> void operator()(T &sensor, int)
+        {
+        if (sensor.MuxPort == NO_MUX)
+            I2CMux.Deselect();      // no-op unless a port is still selected
+        sensor.FreshSample = true;
+        MemMonitor.StartProbe(MEM_PROBE_READSENSOR);
+        sensor.ReadOK = sensor.ReadSensor();
+        MemMonitor.EndProbe(MEM_PROBE_READSENSOR);
+        }
+};
+
+void CReadPlan::ReadAll()
+{
+    ReadStep step;
+    
+    I2CMux.BeginBatch();
+    ForEach(step);
+    I2CMux.EndBatch();
+}
+
+// One sensor's name and port, for LogPlan
+struct PlanLogStep
+{
+    char *LogMsg;
+    int Size;
+    
+    template<class T> void operator()(T &sensor, int)
+        {
+        Append(sensor);
+        }
+    void Append(CMySensor &sensor);
+};
+
+void PlanLogStep::Append(CMySensor &sensor)
+{
+    char buf[8];
+    String name = sensor.SensorName;
+    
+    name.trim();
+    if (strlen(LogMsg) + name.length() + 6 >= (size_t)Size) return;
+    strcat_P(LogMsg, PSTR(" "));
+    strcat(LogMsg, name.c_str());
+    if (sensor.MuxPort >= 0)
+        {
+        strcat_P(LogMsg, PSTR("/"));
+        itoa(sensor.MuxPort, buf, 10);
+        strcat(LogMsg, buf);
+        }
+}
+
+void CReadPlan::LogPlan()
+{
+    char logMsg[120];
+    char buf[8];
+
+    PlanLogStep step;
+    
+    strcpy_P(logMsg, PSTR("Read plan:"));
+    step.LogMsg = logMsg;
+    step.Size = sizeof(logMsg);
+    ForEach(step);
+    if (strlen(logMsg) + 12 < sizeof(logMsg))
+        {
+        strcat_P(logMsg, PSTR(", "));
+        itoa(Ports, buf, 10);
+        strcat(logMsg, buf);
+        strcat_P(logMsg, PSTR(" ports"));
+        }
+    LogEvent(logMsg);
+}
+
+CReadPlan ReadPlan;
@@ -0,0 +1,89 @@
+#ifndef READPLAN_H
+#define READPLAN_H
+
+#include "SensorSet.h"
+
+/*********************************************
+ * CReadPlan
+ *
+ * The order sensors are read in each cycle, worked out at compile
+ * time from the mux ports in the set's rows (SensorSet.h):
+ *   1. NO_MUX sensors, with no mux port selected
+ *   2. mux sensors, grouped by port, ports in ascending order
+ *   3. NO_BUS sensors (computed from the others, like Fusion)
+ * Within a group the set order is kept. A cycle selects each port
+ * that has a due sensor once and deselects once at the end, so the
+ * mux traffic grows with the number of ports in use, not the number
+ * of sensors behind them.
+ *
+ * ForEach calls a SensorSet step in plan order, unrolled like
+ * ActiveSensors::ForEach; the column passed is still the set's.
+ * Only the read order changes; log columns stay in set order.
+ */
+
+// Sort key: direct bus first, then mux ports, then no bus
+constexpr int PlanGroup(int port)
+{
+    return((port == NO_BUS) ? 100 : (port < 0) ? 0 : 1 + port);
+}
+
+// A stable sort of Set's columns by PlanGroup, as constexpr functions
+template<class Set> struct PlanOrder
+{
+    // Columns that read before column
+    static constexpr int Rank(int column, int other = 0)
+        {
+        return((other >= Set::Count) ? 0 :
+               (((PlanGroup(Set::MuxPort(other)) < PlanGroup(Set::MuxPort(column))) ||
+                 ((PlanGroup(Set::MuxPort(other)) == PlanGroup(Set::MuxPort(column))) && (other < column)))
+                ? 1 : 0) + Rank(column, other + 1));
+        }
+
+    // The column read n-th
+    static constexpr int Column(int n, int column = 0)
+        {
+        return((column >= Set::Count) ? -1 :
+               (Rank(column) == n) ? column : Column(n, column + 1));
+        }
+
+    // Distinct mux ports, from the n-th read on
+    static constexpr int Ports(int n = 0, int lastPort = NO_MUX)
+        {
+        return((n >= Set::Count) ? 0 :
+               (((Set::MuxPort(Column(n)) >= 0) && (Set::MuxPort(Column(n)) != lastPort)) ? 1 : 0) +
+               Ports(n + 1, Set::MuxPort(Column(n))));
+        }
+};
+
+// Calls the step for the n-th read on
+template<class Set, int N = 0, bool Done = (N >= Set::Count)> struct PlanWalk
+{
+    template<class F> static void ForEach(F &f)
+        {
+        enum { Column = PlanOrder<Set>::Column(N) };
+        f(SensorAt<Set, Column>::Ref::Sensor(), Column);
+        PlanWalk<Set, N + 1>::ForEach(f);
+        }
+};
+
+template<class Set, int N> struct PlanWalk<Set, N, true>
+{
+    template<class F> static void ForEach(F &)      { }
+};
+
+class CReadPlan
+{
+public:
+    CReadPlan();
+
+    void ReadAll();                 // read every sensor in plan order (wide row mode)
+    void LogPlan();                 // log the order and port groups
+
+    template<class F> void ForEach(F &f)     { PlanWalk<ActiveSensors>::ForEach(f); }
+
+    enum { Count = ActiveSensors::Count, Ports = PlanOrder<ActiveSensors>::Ports() };
+};
+
+extern CReadPlan ReadPlan;
+
+#endif
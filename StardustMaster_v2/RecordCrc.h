@@ -0,0 +1,46 @@
+#ifndef RECORDCRC_H
+#define RECORDCRC_H
+
+#include <Arduino.h>
+
+/*********************************************
+ * CRecordCrc
+ *
+ * Seals every data file line and error/event log line with a
+ * sequence number and a CRC, so a file cut short or scrambled by a
+ * brown-out can be salvaged record by record (HostTools/StarScan,
+ * and StarDecode drops the damaged lines). Each record gets the
+ * trailer
+ *     <record>,#D<seq>:<len>*<crc>
+ *   D or E     data file line or event log line
+ *   <seq>      counts from 1 at boot, separately for D and E
+ *   <len>      length of <record>, the text we hand to CLogger
+ *              (CLogger's timestamp in front is not covered)
+ *   <crc>      4 hex digits of CRC-16/CCITT (poly 0x1021, init
+ *              0xFFFF) over <record> and the trailer up to the '*'
+ * <len> lets the scanner find the start of the record from the
+ * trailer, even with garbage in front of it on the line.
+ *
+ * The CRC table (512 bytes) lives in flash; one table lookup per
+ * byte keeps it cheap on the AVR.
+ */
+
+#define RECORD_TRAILER_LENGTH   24      // ,#D4294967295:65535*FFFF
+#define RECORD_DATA             'D'
+#define RECORD_EVENT            'E'
+
+class CRecordCrc
+{
+public:
+    CRecordCrc();
+
+    uint16_t Crc16(const char *p, int len, uint16_t crc = 0xFFFF);
+    void Seal(char *record, int tarLim, char kind);     // add the trailer, truncating if needed
+
+    unsigned long DataSeq;          // last data record sealed
+    unsigned long EventSeq;         // last event record sealed
+};
+
+extern CRecordCrc RecordCrc;
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef SENSORSET_H
+#define SENSORSET_H
+
+#include "MySensor.h"
+#include "FlightReplay.h"
+
+/*********************************************
+ * SensorSet
+ *
+ * The selected sensor set (SENSOR_SET in MySensor.h) as a compile-time
+ * list of (class, object, mux port) rows. Everything that walks the
+ * sensors does it through here, with a functor whose template
+ * operator() is called with every sensor as its own class and its
+ * column (the row's place in the set, the csv column order):
+ *
+ *     struct Step
+ *     {
+ *         template<class T> void operator()(T &sensor, int column) { ... }
+ *     };
+ *     Step step;
+ *     ActiveSensors::ForEach(step);
+ *
+ * ForEach unrolls at compile time, one call per row, and every call
+ * the step makes on the sensor is a direct one (see CMySensor). The
+ * read order, grouped by mux port, is worked out from the rows at
+ * compile time too. See ReadPlan.h
+ */
+
+template<class T, T &Object, int Port> struct SensorRef
+{
+    typedef T Type;
+    enum { MuxPort = Port };
+    static T &Sensor()      { return(Object); }
+};
+
+struct SensorSetEnd {};     // closes the list, after the last row's comma
+
+template<class... Refs> struct SensorSet;
+
+template<> struct SensorSet<SensorSetEnd>
+{
+    enum { Count = 0 };
+    template<class F> static void ForEach(F &, int = 0)      { }
+    static constexpr int MuxPort(int)   { return(NO_MUX); }
+};
+
+template<class First, class... Rest> struct SensorSet<First, Rest...>
+{
+    typedef SensorSet<Rest...> Next;
+    enum { Count = 1 + Next::Count };
+
+    template<class F> static void ForEach(F &f, int column = 0)
+        {
+        f(First::Sensor(), column);
+        Next::ForEach(f, column + 1);
+        }
+
+    // The mux port of the sensor in column
+    static constexpr int MuxPort(int column)
+        {
+        return((column == 0) ? (int)First::MuxPort : Next::MuxPort(column - 1));
+        }
+};
+
+// SensorAt<Set, column>::Ref is the row in that column
+template<class Set, int Column> struct SensorAt;
+
+template<class First, class... Rest> struct SensorAt<SensorSet<First, Rest...>, 0>
+{
+    typedef First Ref;
+};
+
+template<class First, class... Rest, int Column> struct SensorAt<SensorSet<First, Rest...>, Column>
+    : SensorAt<SensorSet<Rest...>, Column - 1>
+{
+};
+
+// The selected set's objects are built in MySensor.cpp
+#define SENSOR_EXTERN(type, object, ...)    extern type object;
+#define SENSOR_REF(type, object, name, pin, muxport, ...)   SensorRef<type, object, muxport>,
+SENSOR_SET(SENSOR_EXTERN)
+typedef SensorSet<SENSOR_SET(SENSOR_REF) SensorSetEnd> ActiveSensors;
+
+static_assert(ActiveSensors::Count == NUM_SENSORS, "ActiveSensors doesn't match SENSOR_SET");
+
+#endif
@@ -37,20 +37,39 @@
 // Set up array of sensor objects
 #include "MySensor.h"
 #include "Config.h"
+#include "StatusLeds.h"
+#include "IdleSleep.h"
+#include "FlightReplay.h"
+#include "StreamLog.h"
+#include "FlightPhase.h"
+#include "ReadPlan.h"
+#include "SensorSet.h"          // the per-sample loops
+#include "I2CBus.h"
+#include "Arena.h"
+#include "MemMonitor.h"         // stack and heap use
+#include "Timebase.h"
+#include "RecordCrc.h"
+#include "Console.h"            // serial commands
+#include "Bench.h"              // RUN_BENCHMARKS
 #include <CACBoardDiff.h>
-#include <MemoryFree.h>         // checking for memory leaks
-unsigned int startFreeMemory = 0;
-unsigned int curMemory = 0;
+
+// Overlapped sensor init tracking (see StartSensorInits)
+unsigned long BootStartMsec = 0;
+int PendingInits = 0;           // sensors still INIT_WAITING
+int ReadySensors = 0;           // sensors INIT_READY
+bool InitsFinished = false;     // all sensors ready or failed
+
+// Sample schedule. Samples start every flight phase period (or when the next
+// stream is due with LOG_STREAMS); we sleep in between. See FlightPhase.h
+unsigned long NextSampleMsec = 0;
 
 #include <BrewmicroSD.h>
 #include <CACLogger.h>
 CRTC TheRTC;
+bool RtcRunning = false;        // TheRTC.Init() worked
 CBrewmicroSD TheDisk;
 CLogger TheLogger;
 
-// FreeMemory stuff to verify we do not have memory leak
-//#define CHECK_FREE_MEMORY
-
 /*********************************
  * setup()
  * 
@@ -59,21 +78,23 @@ CLogger TheLogger;
  * b) when the Arduino Reset button is pressed
  */
 void setup() {
+    MemMonitor.PaintStack();    // first, so the high-water mark covers everything
     Serial.begin(115200);   // initialize Serial Console for debugging info
-    Serial.println("************************");
-    Serial.println(VERSION);
+    Serial.println(F("************************"));
+    Serial.println(F(VERSION));
     
-    pinMode(STATUS_LED, OUTPUT);
-    pinMode(HEATER_LED, OUTPUT);
-    pinMode(GPS_FIX_ON, OUTPUT);
-    digitalWrite (STATUS_LED, LED_ON);      
+    StatusLeds.Init();
+    StatusLeds.SetLed(LEDBIT_STATUS, true);
     pinMode(PIN_DISKLOG, INPUT_PULLUP);
     
+    I2CBus.Init();          // Wire, once, for the RTC and all sensors
+    Timebase.Init();        // GPS time pulse, if wired
     char *errMsg = TheRTC.Init();
     if (errMsg)
         {
-        Serial.print("RTC init err "); Serial.println(errMsg);
+        Serial.print(F("RTC init err ")); Serial.println(errMsg);
         }
+    RtcRunning = (errMsg == NULL);
     
     if (digitalRead(PIN_DISKLOG) == HIGH)
         {
@@ -90,55 +111,163 @@ void setup() {
     MyConfig.Init(TheDisk);    // load config settings
     
     InitLogger();
+    MemMonitor.Report(true);    // RAM left after the static data
     HeaterControl.Init();
     debug("SeaLevelPressure is ", MyConfig.SeaLevelPressure);
     debug("DataFileMsecBump is ", MyConfig.DataFileMsecBump);
     
     
-    for (int i=0; i < MaxSensors; i++)
+    // Start every sensor. loop() polls them until they are done, and
+    // starts sampling once the first one is ready.
+    StartSensorInits();
+    ReadPlan.LogPlan();     // read order, grouped by mux port
+#ifdef RUN_BENCHMARKS
+    // Every sensor done and read once, so there are values to format
+    while (PendingInits > 0)
         {
-        //Serial.print("Sensor Init ");Serial.println(SensorArr[i]->SensorName);
-        SensorArr[i]->InitSensor();
+        PollSensorInits();
         }
+    ReadPlan.ReadAll();
+    Bench.Run();
+    for (;;)
+        ;                   // not a flight build: stop here
+#endif
+    NextSampleMsec = millis();
     // If a temperature sensor is used for heater control, uncomment the next line
     //InternTempSensor.UseForHeaterControl = true;
+}
 
-    // Flash any error messages
-    FlashErrors(2);     // flash 2 times
+void loop() {
+#ifdef REPLAY_SENSORS
+    // Each replayed record is one pass; no waiting between records
+    if (!FlightReplay.NextRecord()) return;
+#endif
+    Console.StartLoop();
+
+    if (Console.RotatePending)
+        {   // asked for on the console; started here, between samples
+        Console.RotatePending = false;
+        InitLogger();
+        }
 
-#ifdef CHECK_FREE_MEMORY
-#ifndef ARDUINO_SAMD_ZERO
-    startFreeMemory = freeMemory();    // initial memory
-    Serial.print("Starting Free Memory ");Serial.println(startFreeMemory);
+    if (!InitsFinished)
+        {
+        PollSensorInits();
+        if (PendingInits == 0)
+            {   // all sensors done. Flash any error messages
+            InitsFinished = true;
+            FlashErrors(2);     // flash 2 times
+            }
+        }
+    
+    // Pick the sampling profile from the last altitude/rate estimate
+    FlightPhase.Update(FlightMsec());
+    
+    // Nothing to log until a sensor is ready. While inits are pending
+    // loop also wakes to poll them, between samples.
+    bool sampleDue = (ReadySensors > 0) || InitsFinished;
+#if !defined(LOG_STREAMS) && !defined(REPLAY_SENSORS)
+    sampleDue = sampleDue && ((long)(millis() - NextSampleMsec) >= 0);
+#endif
+    if (sampleDue)
+        {
+        StatusLeds.SetLed(LEDBIT_STATUS, true);     // heartbeat on while reading
+#ifdef LOG_STREAMS
+        StreamLog.SampleDueSensors();
+#else
+        ReadPlan.ReadAll();
+        MemMonitor.StartProbe(MEM_PROBE_LOGDISK);
+        LogDisk();
+        MemMonitor.EndProbe(MEM_PROBE_LOGDISK);
+#endif
+        StatusLeds.SetLed(LEDBIT_STATUS, false);
+        }
+    I2CBus.EndLoop();
+    MemMonitor.EndLoop();
+    MemMonitor.Report();        // stack, heap and probes every MEM_REPORT_MSEC
+    Console.EndLoop();
+    AdcEngine.Service();        // one ADC conversion, where it isn't interrupt driven
+    
+#ifndef REPLAY_SENSORS
+    Console.Poll();
+    // Sleep until the next sample is due. If we overran, don't try
+    // to catch up on the missed samples.
+    IdleSleep.Report();
+    I2CBus.Report();
+    Timebase.Report();
+#ifdef LOG_STREAMS
+    NextSampleMsec = StreamLog.NextDueMsec();
+#else
+    if (sampleDue)
+        {
+        NextSampleMsec += FlightPhase.SamplePeriodMsec();
+        if ((long)(millis() - NextSampleMsec) > 0)
+            NextSampleMsec = millis();
+        }
 #endif
+    unsigned long wakeMsec = NextSampleMsec;
+    if (!InitsFinished && ((long)(wakeMsec - millis()) > INIT_POLL_MSEC))
+        wakeMsec = millis() + INIT_POLL_MSEC;
+    IdleSleep.SleepUntil(wakeMsec);
 #endif
 }
 
-void loop() {
-    digitalWrite (STATUS_LED, LED_ON);      
-    for (int i=0; i < MaxSensors; i++)
+
+
+/*****************************
+ * StartSensorInits / PollSensorInits
+ * 
+ * Sensor init is overlapped: StartSensorInits() kicks off every sensor's
+ * slow operation (first conversion, warm-up, first measurement) before
+ * waiting on any of them. PollSensorInits() checks the waiting sensors
+ * without blocking. Sensors still waiting after INIT_BUDGET_MSEC are failed.
+ * See SensorInit in MySensor.h
+ */
+struct StartInitStep
+{
+    template<class T> void operator()(T &sensor, int)
         {
-        //Serial.print("Read Sensor ");Serial.println(SensorArr[i]->SensorName);
-        SensorArr[i]->ReadSensor();
+        //Serial.print(F("Sensor Init "));Serial.println(sensor.SensorName);
+        SensorInit<T>::Start(sensor);
         }
-    LogDisk();
-    digitalWrite (STATUS_LED, LED_OFF);      
+};
+
+struct PollInitStep
+{
+    bool PastBudget;
     
-    // Checking for memory leaks
-#ifdef CHECK_FREE_MEMORY
-#ifndef ARDUINO_SAMD_ZERO
-    curMemory = freeMemory();
-    if (curMemory != startFreeMemory)
+    template<class T> void operator()(T &sensor, int)
         {
-        Serial.print("Free Memory ");Serial.println(curMemory);
+        if (!SensorInit<T>::Poll(sensor))
+            {
+            if (PastBudget)
+                sensor.AbortInit();
+            else
+                PendingInits++;
+            }
+        if (sensor.InitState == INIT_READY)
+            ReadySensors++;
         }
-#endif    
-#endif    
+};
+
+void StartSensorInits()
+{
+    StartInitStep step;
     
-    delay(2000);
+    BootStartMsec = millis();
+    ActiveSensors::ForEach(step);
+    PollSensorInits();
 }
 
-
+void PollSensorInits()
+{
+    PollInitStep step;
+    
+    step.PastBudget = (millis() - BootStartMsec) > INIT_BUDGET_MSEC;
+    PendingInits = 0;
+    ReadySensors = 0;
+    ActiveSensors::ForEach(step);
+}
 
 /*****************************
  * FlashStatusError
@@ -147,6 +276,9 @@ void loop() {
  * a sensor is not found, or the disk didn't initialize right
  * The user selects the desired pattern when calling this function
  * from the list above
+ * 
+ * The flashing is queued on StatusLeds and plays in the background,
+ * so none of these functions wait for the pattern to finish.
  */
 
 // Hold a list of error code to flash
@@ -158,7 +290,7 @@ void FlashStatusError(int whichErr, char *msg)
  {
   // Add to errCodes List
 
-    TheLogger.LogMsg(msg);
+    LogEvent(msg);
     if (MaxFlashCount < MAX_ERROR_FLASH)
         {
         errCodes[MaxFlashCount] = whichErr;
@@ -166,6 +298,15 @@ void FlashStatusError(int whichErr, char *msg)
         }
  }
 
+void FlashStatusError(int whichErr, const __FlashStringHelper *msg)
+{
+    char buf[LOGMSG_LENGTH+1];
+    
+    strncpy_P(buf, (PGM_P)msg, LOGMSG_LENGTH);
+    buf[LOGMSG_LENGTH] = 0;
+    FlashStatusError(whichErr, buf);
+}
+
 void FlashErrors(int numTimes)
 {
     for (int loopCnt=0; loopCnt < numTimes; loopCnt++)
@@ -181,30 +322,16 @@ void FlashPulses(int numPulses,int *pattern)
 {
     for (int i=0; i < numPulses; i++)
         {
-        digitalWrite (STATUS_LED, LED_ON);
-        delay(pattern[i]);
-        digitalWrite (STATUS_LED, LED_OFF);
-        delay(BREAKMSEC);  
+        StatusLeds.QueueStep(LEDBIT_STATUS, 1, pattern[i], BREAKMSEC,
+                             (i == numPulses-1) ? BREAKMSEC*3 : 0);
         }
-    delay(BREAKMSEC*3);  
 }
 
 void FlashErrNumber(int errnum, int numFlashes)
 {
     // Using the 3 status LEDs, rapidly flash the errnum 1-7 in binary.
     // Flash for a short time (1-2 seconds?) 
-    for (int i=0; i< numFlashes; i++)
-        {
-        digitalWrite(GPS_FIX_ON, errnum & 1? HIGH : LOW);  // Blue Light  
-        digitalWrite(HEATER_LED, errnum & 2? HIGH : LOW);  // Red Light 
-        digitalWrite(STATUS_LED, errnum & 4? HIGH : LOW);  // Yellow Light 
-        delay(50);
-        digitalWrite(GPS_FIX_ON, LOW);  // Blue Light  
-        digitalWrite(HEATER_LED, LOW);  // Red Light 
-        digitalWrite(STATUS_LED, LOW);
-        delay(50);
-        }
-    delay (3*BREAKMSEC);
+    StatusLeds.QueueStep(errnum & 7, numFlashes, 50, 50, 3*BREAKMSEC);
 }
 
 
@@ -224,8 +351,8 @@ void Mstrcpy(char *target, char *src, int tarLim)
         }
     else
         {
-        Serial.println("    >>> Mstrcpy: target is not large enough to hold src");
-        Serial.print("    >>> src is "); Serial.print(src);Serial.print(" Limit is ");Serial.println(tarLim);
+        Serial.println(F("    >>> Mstrcpy: target is not large enough to hold src"));
+        Serial.print(F("    >>> src is ")); Serial.print(src);Serial.print(F(" Limit is "));Serial.println(tarLim);
         }
 }
 
@@ -237,10 +364,91 @@ void Mstrcat(char *target, char *src, int tarLim)
         }
     else
         {
-        Serial.println("    >>> Mstrcat: target is not large enough to hold src");
-        Serial.print("    >>> target is "); Serial.print(target);
-        Serial.print("    >>> src is "); Serial.println(src);
-        Serial.print("    >>> Limit is ");Serial.println(tarLim);
+        Serial.println(F("    >>> Mstrcat: target is not large enough to hold src"));
+        Serial.print(F("    >>> target is ")); Serial.print(target);
+        Serial.print(F("    >>> src is ")); Serial.println(src);
+        Serial.print(F("    >>> Limit is "));Serial.println(tarLim);
         }
   
-}
+}
+
+/**************************************
+ * Flash string versions
+ * Same checks as Mstrcpy/Mstrcat, for src in flash (F("...")).
+ * See "Flash strings" in SystemParameters.h
+ *******************************/
+void Fstrcpy(char *target, const __FlashStringHelper *src, int tarLim)
+{
+    if (strlen_P((PGM_P)src) < tarLim)
+        { // OK to copy
+        strcpy_P(target, (PGM_P)src);
+        }
+    else
+        {
+        Serial.println(F("    >>> Fstrcpy: target is not large enough to hold src"));
+        Serial.print(F("    >>> src is ")); Serial.print(src);Serial.print(F(" Limit is "));Serial.println(tarLim);
+        }
+}
+
+void Fstrcat(char *target, const __FlashStringHelper *src, int tarLim)
+{
+    if ((strlen(target) + strlen_P((PGM_P)src)) < tarLim)
+        { // OK to cat
+        strcat_P(target, (PGM_P)src);
+        }
+    else
+        {
+        Serial.println(F("    >>> Fstrcat: target is not large enough to hold src"));
+        Serial.print(F("    >>> target is ")); Serial.print(target);
+        Serial.print(F("    >>> src is ")); Serial.println(src);
+        Serial.print(F("    >>> Limit is "));Serial.println(tarLim);
+        }
+}
+
+// CLogger only takes RAM strings; copy the message out of flash first
+void LogMsgF(const __FlashStringHelper *msg)
+{
+    char buf[LOGMSG_LENGTH + RECORD_TRAILER_LENGTH + 1];
+    
+    strncpy_P(buf, (PGM_P)msg, LOGMSG_LENGTH);
+    buf[LOGMSG_LENGTH] = 0;
+    RecordCrc.Seal(buf, sizeof(buf), RECORD_EVENT);
+    if (Bench.Running) return;      // timing the code, not the card
+    TheLogger.LogMsg(buf);
+}
+
+/**************************************
+ * RtcUnixTime
+ * Seconds since 1970 on the logger's RTC (the Timestamp column's
+ * clock); false if it didn't start. It keeps running through a
+ * reset, so GpsAiding can tell how long we were down.
+ *******************************/
+bool RtcUnixTime(uint32_t &secs)
+{
+    if (!RtcRunning) return(false);
+    secs = TheRTC.now().unixtime();
+    return(true);
+}
+
+/**************************************
+ * LogEvent / WriteDataRecord
+ * Every error log and data file line goes out through these,
+ * sealed with its sequence number and CRC. See RecordCrc.h
+ *******************************/
+void LogEvent(char *msg)
+{
+    char buf[LOGMSG_LENGTH + RECORD_TRAILER_LENGTH + 1];
+    
+    strncpy(buf, msg, LOGMSG_LENGTH);
+    buf[LOGMSG_LENGTH] = 0;
+    RecordCrc.Seal(buf, sizeof(buf), RECORD_EVENT);
+    if (Bench.Running) return;      // timing the code, not the card
+    TheLogger.LogMsg(buf);
+}
+
+// tarLim is the size of line's buffer; it needs RECORD_TRAILER_LENGTH spare
+void WriteDataRecord(char *line, int tarLim)
+{
+    RecordCrc.Seal(line, tarLim, RECORD_DATA);
+    TheLogger.WriteDataFile(line);
+}
@@ -0,0 +1,170 @@
+/**************************************************
+ * StatusLeds
+ *
+ * Implementation of CStatusLeds, the background LED sequencer.
+ * See StatusLeds.h
+ *************************************************/
+
+#include "StatusLeds.h"
+
+// Step phases
+#define PHASE_ON    0
+#define PHASE_OFF   1
+#define PHASE_GAP   2
+
+CStatusLeds::CStatusLeds()   // constructor
+{
+    Head = 0;
+    Tail = 0;
+    LoopStart = 0;
+    Looping = false;
+    IdleMask = 0;
+    ShownMask = 0;
+    Playing = false;
+    BlinksLeft = 0;
+    Phase = PHASE_ON;
+    PhaseEndMsec = 0;
+}
+
+void CStatusLeds::Init()
+{
+    pinMode(GPS_FIX_ON, OUTPUT);
+    pinMode(HEATER_LED, OUTPUT);
+    pinMode(STATUS_LED, OUTPUT);
+    ShowMask(IdleMask);
+
+#ifdef __AVR__
+    // Timer0 already runs millis(). Its compare A interrupt gives us a
+    // ~1 kHz tick without touching the millis() overflow interrupt.
+    OCR0A = 0x80;
+    TIMSK0 |= _BV(OCIE0A);
+#endif
+}
+
+void CStatusLeds::SetLed(uint8_t ledBit, bool on)
+{
+    noInterrupts();
+    if (on)
+        IdleMask |= ledBit;
+    else
+        IdleMask &= ~ledBit;
+    if (!Playing && (Head == Tail))
+        ShowMask(IdleMask);
+    interrupts();
+}
+
+// Returns false if the queue is full or a Loop() pattern is running
+bool CStatusLeds::QueueStep(uint8_t mask, uint8_t count, uint16_t onMsec, uint16_t offMsec, uint16_t gapMsec)
+{
+    if (Looping) return(false);
+
+    uint8_t next = (Tail + 1) % LED_QUEUE_SIZE;
+    if (next == Head) return(false);    // full
+
+    Queue[Tail].Mask = mask;
+    Queue[Tail].Count = count;
+    Queue[Tail].OnMsec = onMsec;
+    Queue[Tail].OffMsec = offMsec;
+    Queue[Tail].GapMsec = gapMsec;
+    Tail = next;      // publish the step to the tick
+    return(true);
+}
+
+void CStatusLeds::Loop(int numSteps)
+{
+    noInterrupts();
+    LoopStart = (Tail + LED_QUEUE_SIZE - numSteps) % LED_QUEUE_SIZE;
+    Looping = true;
+    interrupts();
+}
+
+bool CStatusLeds::Busy()
+{
+    return (Playing || (Head != Tail));
+}
+
+void CStatusLeds::Service()
+{
+#ifndef __AVR__
+    Tick();     // no timer tick on this board
+#endif
+}
+
+void CStatusLeds::ShowMask(uint8_t mask)
+{
+    digitalWrite(GPS_FIX_ON, mask & LEDBIT_FIX ? LED_ON : LED_OFF);     // Blue Light
+    digitalWrite(HEATER_LED, mask & LEDBIT_HEATER ? LED_ON : LED_OFF);  // Red Light
+    digitalWrite(STATUS_LED, mask & LEDBIT_STATUS ? LED_ON : LED_OFF);  // Yellow Light
+    ShownMask = mask;
+}
+
+void CStatusLeds::StartStep()
+{
+    LedStep *step = &Queue[Head];
+
+    Playing = true;
+    BlinksLeft = step->Count;
+    if (BlinksLeft == 0)
+        {   // gap only
+        ShowMask(0);
+        Phase = PHASE_GAP;
+        PhaseEndMsec = millis() + step->GapMsec;
+        return;
+        }
+    ShowMask(step->Mask);
+    Phase = PHASE_ON;
+    PhaseEndMsec = millis() + step->OnMsec;
+}
+
+void CStatusLeds::Tick()
+{
+    if (!Playing)
+        {
+        if (Head != Tail)
+            StartStep();
+        else if (ShownMask != IdleMask)
+            ShowMask(IdleMask);     // nothing queued: normal display
+        return;
+        }
+
+    if ((long)(millis() - PhaseEndMsec) < 0) return;    // phase not over yet
+
+    LedStep *step = &Queue[Head];
+    switch (Phase)
+        {
+        case PHASE_ON:
+            ShowMask(0);
+            Phase = PHASE_OFF;
+            PhaseEndMsec = millis() + step->OffMsec;
+            break;
+        case PHASE_OFF:
+            BlinksLeft--;
+            if (BlinksLeft > 0)
+                {
+                ShowMask(step->Mask);
+                Phase = PHASE_ON;
+                PhaseEndMsec = millis() + step->OnMsec;
+                }
+            else
+                {
+                Phase = PHASE_GAP;
+                PhaseEndMsec = millis() + step->GapMsec;
+                }
+            break;
+        default:    // PHASE_GAP - step done
+            Playing = false;
+            Head = (Head + 1) % LED_QUEUE_SIZE;
+            if (Looping && (Head == Tail))
+                Head = LoopStart;
+            break;
+        }
+}
+
+#ifdef __AVR__
+ISR(TIMER0_COMPA_vect)
+{
+    StatusLeds.Tick();
+}
+#endif
+
+CStatusLeds StatusLeds;
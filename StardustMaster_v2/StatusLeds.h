@@ -0,0 +1,71 @@
+#ifndef STATUSLEDS_H
+#define STATUSLEDS_H
+
+#include <Arduino.h>
+#include "SystemParameters.h"
+
+/*********************************************
+ * CStatusLeds
+ *
+ * Background sequencer for the three status LEDs.
+ *
+ * Patterns (error codes, pulses, the disk failure chase) are queued as
+ * steps and played from a timer tick, so the main loop never waits on
+ * delay() to show them. When the queue is empty the LEDs show their
+ * normal state: heartbeat (yellow), heater on (red) and GPS fix (blue).
+ *
+ * On AVR the tick comes from a Timer0 compare interrupt (~1 kHz, shares
+ * the millis() timer). Other boards call Service() from the main loop.
+ */
+
+// LED bits, matching the binary error code display
+#define LEDBIT_FIX        1     // Blue   GPS_FIX_ON
+#define LEDBIT_HEATER     2     // Red    HEATER_LED
+#define LEDBIT_STATUS     4     // Yellow STATUS_LED
+
+#define LED_QUEUE_SIZE    24    // max queued steps (2 passes of MAX_ERROR_FLASH codes + spare)
+
+// One step: blink Mask Count times, then stay dark for GapMsec
+struct LedStep
+{
+    uint8_t  Mask;
+    uint8_t  Count;
+    uint16_t OnMsec;
+    uint16_t OffMsec;
+    uint16_t GapMsec;
+};
+
+class CStatusLeds
+{
+public:
+    CStatusLeds();
+
+    void Init();                  // set pins, start the tick
+    void SetLed(uint8_t ledBit, bool on);   // normal (idle) state of an LED
+    bool QueueStep(uint8_t mask, uint8_t count, uint16_t onMsec, uint16_t offMsec, uint16_t gapMsec);
+    void Loop(int numSteps);      // repeat the last numSteps queued steps forever
+    bool Busy();                  // true while a pattern is playing
+    void Service();               // advance from the main loop (no-op if timer driven)
+    void Tick();                  // advance the sequencer; called from the timer
+
+private:
+    void ShowMask(uint8_t mask);
+    void StartStep();
+
+    LedStep Queue[LED_QUEUE_SIZE];
+    volatile uint8_t Head;        // step being played
+    volatile uint8_t Tail;        // next free slot
+    volatile uint8_t LoopStart;   // where Loop() wraps back to
+    volatile bool    Looping;
+
+    volatile uint8_t IdleMask;    // LEDs to show when nothing is queued
+    uint8_t  ShownMask;           // what is on the pins now
+    bool     Playing;             // Queue[Head] has been started
+    uint8_t  BlinksLeft;
+    uint8_t  Phase;               // on, off or gap
+    unsigned long PhaseEndMsec;
+};
+
+extern CStatusLeds StatusLeds;
+
+#endif
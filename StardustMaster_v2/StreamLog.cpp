@@ -0,0 +1,218 @@
+/**************************************************
+ * StreamLog
+ * 
+ * Implementation of CStreamLogger, the multi-rate
+ * per-sensor stream logging. See StreamLog.h
+ *************************************************/
+
+#include "StreamLog.h"
+#include "FlightReplay.h"
+#include "Config.h"
+#include "ReadPlan.h"
+#include "SensorSet.h"
+#include "I2CMux.h"
+#include "MemMonitor.h"
+#include "RecordCrc.h"
+
+#ifdef LOG_STREAMS
+
+CStreamLogger::CStreamLogger()   // constructor
+{
+    for (int i=0; i < MAX_STREAMS; i++)
+        {
+        Block[i][0] = 0;
+        Count[i] = 0;
+        FirstMsec[i] = 0;
+        }
+    DefinitionsMsec = 0;
+}
+
+// Copy src to the end of target without the blank padding
+static void AppendTrimmed(char *target, const char *src, int tarLim)
+{
+    int len = strlen(target);
+    for (; *src && (len < tarLim); src++)
+        {
+        if (*src != ' ')
+            target[len++] = *src;
+        }
+    target[len] = 0;
+}
+
+void CStreamLogger::WriteHeader()
+{
+    char header[40];
+    strcpy_P(header, PSTR("Timestamp,      Elapsed Time,Block"));
+    TheLogger.WriteDataHeader(header);
+    if (MaxSensors > MAX_STREAMS)
+        LogMsgF(F("StreamLog: more sensors than MAX_STREAMS, extra sensors not logged"));
+    WriteDefinitions();
+}
+
+// One stream's definition line. The header is the same for every
+// sensor class, so this takes any sensor as a CMySensor
+struct CStreamLogger::DefinitionStep
+{
+    void operator()(CMySensor &sensor, int stream)
+        {
+        char line[80 + RECORD_TRAILER_LENGTH];
+        char fieldBuf[50];
+        char buf[8];
+        
+        if (stream >= MAX_STREAMS) return;
+        strcpy_P(line, PSTR("D,"));
+        itoa(stream, buf, 10);
+        strcat(line, buf);
+        strcat_P(line, PSTR(","));
+        strncpy_P(fieldBuf, (PGM_P)sensor.SensorName, 49);
+        fieldBuf[49] = 0;
+        AppendTrimmed(line, fieldBuf, 79);
+        strcat_P(line, PSTR(","));
+        sensor.GetHeader(fieldBuf);
+        AppendTrimmed(line, fieldBuf, 79);
+        WriteDataRecord(line, sizeof(line));
+        }
+};
+
+void CStreamLogger::WriteDefinitions()
+{
+    DefinitionStep step;
+    
+    ActiveSensors::ForEach(step);
+    DefinitionsMsec = millis();
+}
+
+// One sensor's read, if it is due, as its own class. See SensorSet.h
+// The stream number is the sensor's column.
+struct CStreamLogger::SampleStep
+{
+    CStreamLogger *Logger;
+    unsigned long Now;
+    
+    template<class T> void operator()(T &sensor, int stream)
+        {
+        char fieldBuf[40];
+        
+        if (stream >= MAX_STREAMS) return;
+        if (!sensor.SensorAvailable) return;
+        if ((long)(Now - sensor.NextDueMsec) < 0) return;
+
+        sensor.FreshSample = true;
+        MemMonitor.StartProbe(MEM_PROBE_READSENSOR);
+        sensor.ReadOK = sensor.ReadSensor();
+        MemMonitor.EndProbe(MEM_PROBE_READSENSOR);
+        if (sensor.ErrMsg != "")
+            LogEvent((char *)sensor.ErrMsg.c_str());
+        else if (sensor.FreshSample)
+            {
+            GetLogLine(sensor, fieldBuf);
+            Logger->AddSample(stream, fieldBuf, Now);
+            }
+
+        // Next due time; if we fell behind, don't try to catch up
+        sensor.NextDueMsec += sensor.SamplePeriodMsec;
+        if ((long)(Now - sensor.NextDueMsec) > 0)
+            sensor.NextDueMsec = Now + sensor.SamplePeriodMsec;
+        }
+};
+
+/****************************
+ * SampleDueSensors
+ * 
+ * Reads every available sensor whose NextDueMsec has come.
+ * Fresh, good samples go into the sensor's block. Read errors go
+ * to the error log, as LogDisk does.
+ */
+void CStreamLogger::SampleDueSensors()
+{
+    SampleStep step;
+    
+    step.Logger = this;
+    step.Now = FlightMsec();
+    // Read in plan order so the due sensors on a mux port share one select
+    I2CMux.BeginBatch();
+    ReadPlan.ForEach(step);
+    I2CMux.EndBatch();
+    Flush(false);
+
+    if (millis() - DefinitionsMsec >= (unsigned long)MyConfig.DataFileMsecBump)
+        WriteDefinitions();     // for the next data file
+}
+
+void CStreamLogger::AddSample(int stream, const char *field, unsigned long msec)
+{
+    char rec[60];
+    char buf[12];
+    
+    strcpy_P(rec, PSTR(","));
+    ultoa(msec, buf, 10);
+    strcat(rec, buf);
+    strcat_P(rec, PSTR(","));
+    AppendTrimmed(rec, field, 59);
+    
+    if (strlen(Block[stream]) + strlen(rec) > STREAM_BLOCK_LENGTH)
+        FlushStream(stream);
+    if (Count[stream] == 0)
+        FirstMsec[stream] = millis();
+    strcat(Block[stream], rec);
+    Count[stream]++;
+}
+
+void CStreamLogger::Flush(bool all)
+{
+    for (int i=0; i < MAX_STREAMS; i++)
+        {
+        if (Count[i] == 0) continue;
+        if (all || (millis() - FirstMsec[i] >= STREAM_FLUSH_MSEC))
+            FlushStream(i);
+        }
+}
+
+void CStreamLogger::FlushStream(int stream)
+{
+    char line[STREAM_BLOCK_LENGTH + 12 + RECORD_TRAILER_LENGTH];
+    char buf[8];
+    
+    strcpy_P(line, PSTR("B,"));
+    itoa(stream, buf, 10);
+    strcat(line, buf);
+    strcat_P(line, PSTR(","));
+    itoa(Count[stream], buf, 10);
+    strcat(line, buf);
+    strcat(line, Block[stream]);
+    WriteDataRecord(line, sizeof(line));
+    
+    Block[stream][0] = 0;
+    Count[stream] = 0;
+}
+
+// The earliest NextDueMsec of the logged sensors
+struct NextDueStep
+{
+    unsigned long Next;
+    
+    void operator()(CMySensor &sensor, int stream)
+        {
+        if ((stream >= MAX_STREAMS) || !sensor.SensorAvailable) return;
+        if ((long)(sensor.NextDueMsec - Next) < 0)
+            Next = sensor.NextDueMsec;
+        }
+};
+
+unsigned long CStreamLogger::NextDueMsec()
+{
+    unsigned long now = FlightMsec();
+    NextDueStep step;
+    
+    step.Next = now + SAMPLE_PERIOD_MSEC;
+    ActiveSensors::ForEach(step);
+    unsigned long next = step.Next;
+    if ((long)(next - now) < 0)
+        next = now;
+    // Sleep works in millis(); convert from flight time
+    return (millis() + (next - now));
+}
+
+CStreamLogger StreamLog;
+
+#endif
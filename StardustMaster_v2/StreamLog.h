@@ -0,0 +1,56 @@
+#ifndef STREAMLOG_H
+#define STREAMLOG_H
+
+#include "MySensor.h"
+
+/*********************************************
+ * CStreamLogger
+ *
+ * Multi-rate logging, used when LOG_STREAMS is selected in MySensor.h.
+ *
+ * Each sensor is a stream, read at its own SamplePeriodMsec. A sample
+ * is only logged when the sensor produced new data, so slow sensors
+ * (SCD30 every 5 sec) don't repeat stale values and fast ones aren't
+ * held to the loop rate. Samples are collected in a per-stream block
+ * and written as one data line when the block is full or older than
+ * STREAM_FLUSH_MSEC.
+ *
+ * Data file lines (after the logger's Timestamp and Elapsed Time):
+ *   D,<stream>,<sensor name>,<column names...>      stream definition
+ *   B,<stream>,<count>,<msec>,<values...>,<msec>,<values...>,...
+ * <msec> is FlightMsec() when the sample was read. Values have their
+ * blank padding removed. The definitions are written at start and
+ * again every DataFileMsecBump, so every rotated file has them.
+ * HostTools/StarDecode splits the streams and aligns them.
+ */
+
+#define MAX_STREAMS           8       // streams beyond this are not logged
+#define STREAM_BLOCK_LENGTH   160     // chars of samples held per stream (paid for by the flash strings)
+#define STREAM_FLUSH_MSEC     10000   // max time a sample waits in a block
+
+class CStreamLogger
+{
+public:
+    CStreamLogger();
+
+    void WriteHeader();             // header and stream definitions
+    void SampleDueSensors();        // read the sensors that are due, log fresh samples
+    void Flush(bool all);           // write blocks older than STREAM_FLUSH_MSEC (or all)
+    unsigned long NextDueMsec();    // earliest time a sensor is due
+
+private:
+    void WriteDefinitions();
+    void AddSample(int stream, const char *field, unsigned long msec);
+    void FlushStream(int stream);
+    struct DefinitionStep;
+    struct SampleStep;
+
+    char Block[MAX_STREAMS][STREAM_BLOCK_LENGTH+1];
+    uint8_t Count[MAX_STREAMS];     // samples in Block
+    unsigned long FirstMsec[MAX_STREAMS];   // time of the oldest sample in Block
+    unsigned long DefinitionsMsec;  // when the definitions were last written
+};
+
+extern CStreamLogger StreamLog;
+
+#endif
@@ -51,6 +51,7 @@
 #define DS18B_NOT_FOUND   7
 
 extern void FlashStatusError(int i, char *s);
+extern void FlashStatusError(int i, const __FlashStringHelper *s);
 
 /******* I2C addresses
  *  0x10  VEML6075 (UV Sensor)
@@ -61,6 +62,7 @@ extern void FlashStatusError(int i, char *s);
 #define PIN_DISKLOG 22      // debug tool - if low, do not log to disk - serial print instead
 
 #define PINVOLT9              A0    // AD Pin for 9 Volt Battery reading    
+#define VOLT9_DIVIDER         2.0   // the 9 Volt battery is halved to fit the 0..5 Volt AD range
 #define PINVOLT37             A1    // AD Pin for 3.7 Volt Battery reading    
 #define CH4_PIN               A2
 #ifdef REDBOARD_TURBO
@@ -92,6 +94,24 @@ extern void FlashStatusError(int i, char *s);
 #define HEATER_LED            35    // Red LED showing when Heater is on
 
 #define CO2SENSOR_ADDRESS     0x61
+//#define MUX_RESET_PIN       33    // TCA9548A RESET (active low), if wired
+//#define GPS_PPS_PIN         3     // u-blox time pulse, if wired (interrupt pin). See Timebase.h
+
+// Sample periods (msec). All sensors are read once per flight phase period into
+// one wide csv row, unless LOG_STREAMS is set (see MySensor.h): then each sensor
+// is read at the phase period, or its natural rate below if that is slower,
+// into its own stream. See FlightPhase.h
+#define SAMPLE_PERIOD_MSEC    2000    // default before the first phase update
+#define GPS_PERIOD_MSEC       1000    // u-blox nav rate is 1 Hz
+#define BMP388_PERIOD_MSEC    1000
+#define DS18B_PERIOD_MSEC     1000    // 12 bit conversion takes 750 msec
+#define SCD30_INTERVAL_SEC    5       // SCD30 measurement interval
+
+// EEPROM (AVR only), one block per user
+#define EEPROM_CONFIG_ADDR    0       // config cache, see Config.h
+#define EEPROM_CONFIG_SIZE    128
+#define EEPROM_GPS_ADDR       128     // last GPS fix, see GpsAiding.h
+#define EEPROM_GPS_SIZE       32
 
 // Pulse times for FlashStatusError
 #define LONGPULSE       1000
@@ -105,4 +125,28 @@ extern void FlashStatusError(int i, char *s);
 extern void Mstrcpy(char *target, char *src, int tarLim);
 extern void Mstrcat(char *target, char *src, int tarLim);
 
-#endif
+/*************** Flash strings *****************
+ * On AVR, string constants are copied into SRAM at startup unless
+ * they are put in flash. Use F("...") for messages, PSTR() with the
+ * _P string functions for fixed text built into buffers, and
+ * FLASH_STRING for named constants (sensor names).
+ * On SAMD these all compile to plain strings.
+ */
+#define FLASH_STRING(name, text)   const char name[] PROGMEM = text
+#ifndef FPSTR
+#define FPSTR(p)    (reinterpret_cast<const __FlashStringHelper *>(p))
+#endif
+#define LOGMSG_LENGTH   150     // longest message passed to the logger
+
+extern void Fstrcpy(char *target, const __FlashStringHelper *src, int tarLim);
+extern void Fstrcat(char *target, const __FlashStringHelper *src, int tarLim);
+extern void LogMsgF(const __FlashStringHelper *msg);
+
+// All logging goes through these, to seal each record with a
+// sequence number and CRC. See RecordCrc.h
+extern void LogEvent(char *msg);
+extern void WriteDataRecord(char *line, int tarLim);
+extern void BuildDataLine(char *logS);      // the csv data line, not written (LogDisk.ino)
+extern bool RtcUnixTime(uint32_t &secs);     // the RTC, seconds since 1970; false if not running
+
+#endif
@@ -9,9 +9,11 @@
  *************************************************/
  
 #include "MySensor.h"
+#include <new>          // placement new, see DRIVER_STORAGE
 
 /***************** DHT22 stuff *******************/
 #define DHTTYPE DHT22
+#define DHT_WARMUP_MSEC   2000    // DHT22 needs ~2 sec after power-up before the first read
        
 
 /***************** DS18B temperature stuff *******************/
@@ -23,67 +25,98 @@
 void CDS18BTempSensor::InitSensor()
 {
     UseForHeaterControl = false;
+    Values[CH_TEMP_HEATER] = NAN;     // blank HeaterOn column
+    BasePeriodMsec = DS18B_PERIOD_MSEC;
     
     pinMode (PinNum, INPUT);      // for AD pin analogRead
 
-    // Create the objects
+    // Create the objects, in the storage inside this sensor
     // Setup a oneWire instance to communicate with any OneWire devices (not just Maxim/Dallas temperature ICs) 
-    oneWire = new OneWire(PinNum); 
+    oneWire = new (oneWireMem) OneWire(PinNum); 
 
     // Pass our oneWire reference to Dallas Temperature.  
-    sensors = new DallasTemperature(oneWire); 
+    sensors = new (sensorsMem) DallasTemperature(oneWire); 
 
     // arrays to hold device address 
     //DeviceAddress insideThermometer; 
 
     // locate devices on the bus 
-    //Serial.print("Locating devices..."); 
+    //Serial.print(F("Locating devices...")); 
     sensors->begin(); 
-    //Serial.print("Found "); 
+    //Serial.print(F("Found ")); 
     //Serial.print(sensors->getDeviceCount(), DEC); 
-    //Serial.println(" devices."); 
+    //Serial.println(F(" devices.")); 
 
     if (sensors->getDeviceCount() == 0)
         {
-        ErrMsg = "No Devices found on DS18B bus";
+        ErrMsg = F("No Devices found on DS18B bus");
         FailSensor(DS18B_NOT_FOUND);
         return;
         }
         
     // report parasite power requirements 
-    //Serial.print("Parasite power is: ");  
-    //if (sensors->isParasitePowerMode()) Serial.println("ON"); 
-    //else Serial.println("OFF"); 
+    //Serial.print(F("Parasite power is: "));  
+    //if (sensors->isParasitePowerMode()) Serial.println(F("ON")); 
+    //else Serial.println(F("OFF")); 
 
     // Method 1: 
     // Search for devices on the bus and assign based on an index. Ideally, 
     // you would do this to initially discover addresses on the bus and then  
     // use those addresses and manually assign them (see above) once you know  
     // the devices on your bus (and assuming they don't change). 
-    if (!sensors->getAddress(insideThermometer, 0)) Serial.println("Unable to find address for Device 0");  
+    if (!sensors->getAddress(insideThermometer, 0)) Serial.println(F("Unable to find address for Device 0"));  
     
   // show the addresses we found on the bus 
-  //Serial.print("Device 0 Address: "); 
+  //Serial.print(F("Device 0 Address: ")); 
   //printAddress(insideThermometer); 
   //Serial.println(); 
 
   // set the resolution to 9 bit (Each Dallas/Maxim device is capable of several different resolutions) 
   sensors->setResolution(insideThermometer, 12);    // we want 12?
   
-  //Serial.print("Device 0 Resolution: "); 
+  //Serial.print(F("Device 0 Resolution: ")); 
   //Serial.print(sensors->getResolution(insideThermometer), DEC);  
   //Serial.println(); 
 
+  // Don't block for the conversion (750 msec at 12 bits). ReadSensor() reads
+  // the previous conversion and starts the next one.
+  sensors->setWaitForConversion(false);
   sensors->requestTemperatures(); // Start the first read  
     
 }
 
+void CDS18BTempSensor::StartInit()
+{
+    InitStartMsec = millis();
+    InitErrCode = DS18B_NOT_FOUND;
+    InitSensor();
+    if (!SensorAvailable)
+        {
+        InitState = INIT_FAILED;
+        return;
+        }
+    SensorAvailable = false;    // until the first conversion is done
+    InitState = INIT_WAITING;
+}
+
+bool CDS18BTempSensor::PollInit()
+{
+    if (InitState != INIT_WAITING) return(true);
+
+    if (sensors->isConversionComplete())
+        {
+        SensorAvailable = true;
+        InitState = INIT_READY;
+        }
+    return (InitState != INIT_WAITING);
+}
+
 // function to print a device address 
 void CDS18BTempSensor::printAddress(DeviceAddress deviceAddress) 
 { 
   for (uint8_t i = 0; i < 8; i++) 
   { 
-    if (deviceAddress[i] < 16) Serial.print("0"); 
+    if (deviceAddress[i] < 16) Serial.print(F("0")); 
     Serial.print(deviceAddress[i], HEX); 
   } 
 }
@@ -98,47 +131,25 @@ bool CDS18BTempSensor::ReadSensor()
 
     // Need to reverse these for better response? The first request is doen in init
     
-    Value = sensors->getTempC(insideThermometer);
+    Values[CH_TEMP] = sensors->getTempC(insideThermometer);
     sensors->requestTemperatures(); // Start the next read temperatures 
 
     if (readOK && UseForHeaterControl)
         {
-        HeaterControl.HeaterOnOff(Value); 
+        HeaterControl.HeaterOnOff(Values[CH_TEMP]); 
         }
+    Values[CH_TEMP_HEATER] = UseForHeaterControl ? HeaterControl.HeaterOn : NAN;
     return (readOK);  
 }
 
-void CDS18BTempSensor::GetHeader(char *buf)
-{
-    strcpy(buf, SensorName.c_str());
-    Mstrcat(buf,",HeaterOn",TheLogger.MAXLOGLINELENGTH);
-}
-
-void CDS18BTempSensor::GetLogLine(char *buf)    
-{
-    // buf receives this field piece, like
-    //  "25.45,Off"
-    
-    if ((strcmp(ErrMsg.c_str() , "") != 0) || !SensorAvailable)
-        { // err - return empty string
-        strcpy(buf, "        ,        ");  
-        }
-    else
-        { // good read
-        char locBuf[15];
-        dtostrf(Value,8,2,buf);
-        Mstrcat(buf,",",TheLogger.MAXLOGLINELENGTH);
-        if (UseForHeaterControl)  
-            {
-            if (HeaterOn)
-                Mstrcat(buf, "On      ",TheLogger.MAXLOGLINELENGTH);
-            else
-                Mstrcat(buf, "Off     ",TheLogger.MAXLOGLINELENGTH);
-            }
-        else
-            Mstrcat(buf,"        ",TheLogger.MAXLOGLINELENGTH);
-        }
-}
+// The log line is like "   25.45,Off     "
+// DS18B20 data sheet: -55..125 degC; 85.00 is also what it reads
+// before its first conversion
+const ChannelDesc DS18BChannels[2] PROGMEM =
+    {
+    {"",         "degC", CHT_NUMBER, 8, 2, -55.0, 125.0},
+    {"HeaterOn", "",     CHT_ONOFF,  8, 0, NO_RANGE},
+    };
 
 
 
@@ -149,23 +160,62 @@ void CDS18BTempSensor::GetLogLine(char *buf)
  * If Temperature rises above 15, turn off heater
  * Set up for DHT22
  * Needs 2 sec delay between reads
+ *
+ * On an interrupt pin the frames come in through CDHTReader: each
+ * ReadSensor collects the frame the one before started, and starts
+ * the next once DHT_MIN_PERIOD_MSEC have passed. In between, the
+ * sample is a repeat (stale). Elsewhere the DHT library reads
+ * (interrupts off for ~5 msec).
  ***********************************************/  
 void CDHTTempSensor::InitSensor()
 {
-    dht = new DHT(PinNum, DHTTYPE);  
-    dht->begin();     
+    UseReader = Reader.Begin(PinNum);
+    if (!UseReader)
+        {
+        dht = new (dhtMem) DHT(PinNum, DHTTYPE);  
+        dht->begin();     
+        LogMsgF(F("DHT: no interrupt on its pin, using blocking reads"));
+        }
     
     UseForHeaterControl = false;
+    Values[CH_TEMP_HEATER] = NAN;     // blank HeaterOn column
+}
+
+// The test read is done in PollInit once the warm-up time has passed
+void CDHTTempSensor::StartInit()
+{
+    InitStartMsec = millis();
+    InitErrCode = DHT_NOT_FOUND;
+    InitSensor();
+    SensorAvailable = false;    // until the test read passes
+    InitState = INIT_WAITING;
+}
+
+bool CDHTTempSensor::PollInit()
+{
+    if (InitState != INIT_WAITING) return(true);
+    if (millis() - InitStartMsec < DHT_WARMUP_MSEC) return(false);
 
     // did it work? Try to read temperature
-    double testVal = dht->readTemperature();
+    double testVal;
+    if (UseReader)
+        {   // a test frame; Start only sends the start signal
+        Reader.Start();
+        int result = Reader.Poll();
+        if (result == DHT_BUSY) return(false);
+        testVal = (result == DHT_DONE) ? Reader.Temperature : NAN;
+        }
+    else
+        testVal = dht->readTemperature();
     if ( isnan(testVal) ) 
         {
-        ErrMsg = "DHT sensor not found";
+        ErrMsg = F("DHT sensor not found");
         FailSensor(DHT_NOT_FOUND);
-        return;
+        return(true);
         }
-
+    SensorAvailable = true;
+    InitState = INIT_READY;
+    return(true);
 }
     
 bool CDHTTempSensor::ReadSensor()
@@ -175,53 +225,44 @@ bool CDHTTempSensor::ReadSensor()
     if (!SensorAvailable) return(readOK);
 
     ErrMsg="";
-    // For now, return hard-coded values. Need to read the values
-    Value = dht->readTemperature(); // reads degC by default
-    Humidity = dht->readHumidity();
+    if (UseReader)
+        {   // temperature and humidity from the same frame
+        int result = Reader.Poll();
+        Reader.Start();         // next frame, once it is due
+        if (result == DHT_DONE)
+            {
+            Values[CH_TEMP] = Reader.Temperature;
+            Values[CH_DHT_HUMID] = Reader.Humidity;
+            }
+        else
+            FreshSample = false;
+        readOK = (result != DHT_FAILED);
+        }
+    else
+        {
+        Values[CH_TEMP] = dht->readTemperature(); // reads degC by default
+        Values[CH_DHT_HUMID] = dht->readHumidity();
+        }
 
-    if ( isnan(Value) ) 
+    if ( isnan(Values[CH_TEMP]) ) 
         {
-        //ErrMsg = "Failed to read from DHT sensor!";
-        Value = -273.0;
+        //ErrMsg = F("Failed to read from DHT sensor!");
+        Values[CH_TEMP] = -273.0;
         readOK = false;
         }
 
     if (UseForHeaterControl)
         {
-        HeaterControl.HeaterOnOff(Value);
+        HeaterControl.HeaterOnOff(Values[CH_TEMP]);
         }
+    Values[CH_TEMP_HEATER] = UseForHeaterControl ? HeaterControl.HeaterOn : NAN;
     return (readOK);  
 }
 
-void CDHTTempSensor::GetHeader(char *buf)
-{
-    strcpy(buf, SensorName.c_str());
-    Mstrcat(buf,",HeaterOn",TheLogger.MAXLOGLINELENGTH);
-    Mstrcat(buf,",DHTHumid",TheLogger.MAXLOGLINELENGTH);
-}
-
-void CDHTTempSensor::GetLogLine(char *buf)
-{
-    char buf2[12];
-    if ((strcmp(ErrMsg.c_str() , "") != 0) || !SensorAvailable)
-        { // err - return empty string
-        strcpy(buf, "        ,        ,        ");  
-        }
-    else
-        { // good read
-        dtostrf(Value,8,2,buf);
-        Mstrcat(buf,",",TheLogger.MAXLOGLINELENGTH);
-        if (UseForHeaterControl)  
-            {
-            if (HeaterOn)
-                Mstrcat(buf, "On      ",TheLogger.MAXLOGLINELENGTH);
-            else
-                Mstrcat(buf, "Off     ",TheLogger.MAXLOGLINELENGTH);
-            }
-        else
-            Mstrcat(buf,"        ",TheLogger.MAXLOGLINELENGTH);
-        dtostrf(Humidity,8,2,buf2);
-        Mstrcat(buf,",",TheLogger.MAXLOGLINELENGTH);
-        Mstrcat(buf,buf2,TheLogger.MAXLOGLINELENGTH);
-        }
-}
+// DHT22 data sheet: -40..80 degC, 0..100 %RH
+const ChannelDesc DHTChannels[3] PROGMEM =
+    {
+    {"",         "degC", CHT_NUMBER, 8, 2, -40.0, 80.0},
+    {"HeaterOn", "",     CHT_ONOFF,  8, 0, NO_RANGE},
+    {"DHTHumid", "%",    CHT_NUMBER, 8, 2, 0.0, 100.0},
+    };
@@ -0,0 +1,302 @@
+/**************************************************
+ * Timebase
+ *
+ * Implementation of CTimebase, the GPS disciplined
+ * flight clock, and the Clock "sensor" that logs it.
+ * See Timebase.h
+ *************************************************/
+
+#include "Timebase.h"
+#include "MySensor.h"
+#include "FlightPhase.h"
+
+#define USEC_PER_DAY    86400000000LL
+
+CTimebase::CTimebase()   // constructor
+{
+    Synced = false;
+    LastOffsetUsec = 0;
+    Steps = 0;
+    PpsMicros = 0;
+    PpsSeen = false;
+    Clock = 0;
+    LastMicros = 0;
+    FreqPpb = 0;
+    SlewPpb = 0;
+    FracPpbUsec = 0;
+    UtcBase = 0;
+    WindowStart = 0;
+    WindowMsec = TB_WINDOW_MSEC;
+    HalfMin[0] = HalfMin[1] = 0;
+    HalfSamples[0] = HalfSamples[1] = 0;
+    LastSecond = 0xFF;
+    ReportMsec = 0;
+}
+
+#ifdef GPS_PPS_PIN
+static void PpsIsr()
+{
+    Timebase.PpsMicros = micros();
+    Timebase.PpsSeen = true;
+}
+#endif
+
+void CTimebase::Init()
+{
+#ifdef GPS_PPS_PIN
+    pinMode(GPS_PPS_PIN, INPUT);
+    attachInterrupt(digitalPinToInterrupt(GPS_PPS_PIN), PpsIsr, RISING);
+#endif
+}
+
+/****************************
+ * ClockUsec
+ * Advances the clock by the micros() since the last call, at the
+ * corrected rate. Must be called at least every 70 minutes (micros
+ * wraps); every loop reads it through FlightMsec().
+ */
+uint64_t CTimebase::ClockUsec()
+{
+    unsigned long now = micros();
+    unsigned long elapsed = now - LastMicros;
+    LastMicros = now;
+
+    // The correction is kept to the ppb-usec: called every few msec,
+    // a whole-usec one would round anything under ~100 ppm to 0
+    int64_t corr = (int64_t)elapsed * (FreqPpb + SlewPpb) + FracPpbUsec;
+    int64_t whole = corr / 1000000000LL;
+    FracPpbUsec = corr - whole * 1000000000LL;
+    Clock += elapsed + whole;
+    return(Clock);
+}
+
+// Days since 1970-01-01 for a civil date (proleptic Gregorian)
+long DaysFromCivil(int y, int m, int d)
+{
+    y -= m <= 2;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long doy = (153L * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return(era * 146097L + doe - 719468L);
+}
+
+void CivilFromDays(long z, int &y, int &m, int &d)
+{
+    z += 719468L;
+    long era = (z >= 0 ? z : z - 146096L) / 146097L;
+    long doe = z - era * 146097L;
+    long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096L) / 365;
+    long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = yoe + era * 400 + (m <= 2);
+}
+
+/****************************
+ * GpsTime
+ * Called by the GPS sensor with the latest NMEA time. Only the
+ * first sighting of each second is a sample.
+ */
+void CTimebase::GpsTime(uint16_t year, uint8_t month, uint8_t day,
+                        uint8_t hour, uint8_t minute, uint8_t second, uint8_t hundredths)
+{
+    if ((year < 2020) || (month == 0) || (day == 0)) return;     // no time yet
+    if (second == LastSecond) return;
+    LastSecond = second;
+
+    int64_t gps = (int64_t)DaysFromCivil(year, month, day) * USEC_PER_DAY
+                + ((hour * 60L + minute) * 60L + second) * 1000000LL
+                + hundredths * 10000L;
+    uint64_t stamp = ClockUsec();
+
+#ifdef GPS_PPS_PIN
+    // The pulse marks the top of the second the sentence reports
+    noInterrupts();
+    unsigned long pps = PpsMicros;
+    bool seen = PpsSeen;
+    PpsSeen = false;
+    interrupts();
+    unsigned long sincePps = LastMicros - pps;
+    if (seen && (hundredths == 0) && (sincePps < 1000000UL))
+        stamp -= sincePps;
+#endif
+    Sample(stamp, gps);
+}
+
+void CTimebase::Sample(uint64_t stampUsec, int64_t gpsUsec)
+{
+    if (!Synced)
+        {
+        StepTo(stampUsec, gpsUsec);
+        return;
+        }
+
+    int64_t offset = UtcBase + (int64_t)stampUsec - gpsUsec;
+    if ((offset > TB_STEP_USEC) || (offset < -TB_STEP_USEC))
+        {
+        StepTo(stampUsec, gpsUsec);
+        return;
+        }
+
+    // Take out this window's slew, so the minimum sees only the
+    // phase and the rate error
+    long since = (long)(stampUsec - WindowStart);
+    long slewed = (long)((int64_t)SlewPpb * since / 1000000000LL);
+    long raw = (long)offset - slewed;
+    int half = (since < WindowMsec * 500L) ? 0 : 1;
+    if ((HalfSamples[half] == 0) || (raw < HalfMin[half]))
+        HalfMin[half] = raw;
+    HalfSamples[half]++;
+    if (since < WindowMsec * 1000L)
+        return;
+
+    bool enough = (HalfSamples[0] >= TB_MIN_SAMPLES) && (HalfSamples[1] >= TB_MIN_SAMPLES);
+    long halfSec = WindowMsec / 2000;
+    StartWindow(stampUsec);
+    if (enough)
+        {
+        // The half minimums are about half a window apart: their
+        // difference is the rate error. Trim the rate by a share of
+        // it, and slew out the offset it leaves over the next window.
+        long errPpb = (HalfMin[1] - HalfMin[0]) * 1000L / halfSec;
+        long phase = HalfMin[1] + errPpb * halfSec / 2000 + slewed;
+        FreqPpb = constrain(FreqPpb - errPpb / TB_FREQ_SHARE, -TB_MAX_FREQ_PPB, TB_MAX_FREQ_PPB);
+        SlewPpb = constrain(-phase * 1000L / (WindowMsec / 1000), -TB_MAX_SLEW_PPB, TB_MAX_SLEW_PPB);
+        LastOffsetUsec = phase;
+        }
+}
+
+/****************************
+ * StartWindow
+ * The GPS is sampled once per sample period, so the window is
+ * stretched until each half can hold TB_MIN_SAMPLES of them at the
+ * current flight phase's period (the 10 s pad period among them).
+ */
+void CTimebase::StartWindow(uint64_t stampUsec)
+{
+    long need = 2L * (TB_MIN_SAMPLES + 1) * (long)FlightPhase.SamplePeriodMsec();
+
+    WindowMsec = max(TB_WINDOW_MSEC, need);
+    WindowStart = stampUsec;
+    HalfSamples[0] = 0;
+    HalfSamples[1] = 0;
+}
+
+// Set the UTC outright. The clock itself never jumps
+void CTimebase::StepTo(uint64_t stampUsec, int64_t gpsUsec)
+{
+    char logMsg[70];
+    char buf[25];
+
+    UtcBase = gpsUsec - (int64_t)stampUsec;
+    SlewPpb = 0;
+    StartWindow(stampUsec);
+    if (Synced)
+        Steps++;
+    Synced = true;
+
+    strcpy_P(logMsg, Steps ? PSTR("Timebase: UTC stepped to ") : PSTR("Timebase: GPS time "));
+    FormatUtc(buf);
+    strcat(logMsg, buf);
+    LogEvent(logMsg);
+}
+
+bool CTimebase::UtcMicros(int64_t &utc)
+{
+    if (!Synced) return(false);
+    utc = UtcBase + (int64_t)ClockUsec();
+    return(true);
+}
+
+void CTimebase::FormatUtc(char *buf)
+{
+    int64_t utc;
+    if (!UtcMicros(utc))
+        {
+        strcpy_P(buf, PSTR("                       "));
+        return;
+        }
+
+    long days = (long)(utc / USEC_PER_DAY);
+    long msec = (long)((utc - (int64_t)days * USEC_PER_DAY) / 1000);
+    int y, m, d;
+    CivilFromDays(days, y, m, d);
+    // 2021-06-30T14:03:09.123
+    long sec = msec / 1000;
+    sprintf_P(buf, PSTR("%04d-%02d-%02dT%02d:%02d:%02d.%03d"), y, m, d,
+              (int)(sec / 3600), (int)(sec / 60 % 60), (int)(sec % 60), (int)(msec % 1000));
+}
+
+void CTimebase::Report()
+{
+    if (millis() - ReportMsec < TB_REPORT_MSEC) return;
+    ReportMsec = millis();
+    if (!Synced) return;
+
+    char logMsg[90];
+    char buf[15];
+    strcpy_P(logMsg, PSTR("Timebase: offset "));
+    ltoa(LastOffsetUsec, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" usec, rate "));
+    dtostrf(FreqPpb / 1000.0, 1, 3, buf);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" ppm, "));
+    utoa(Steps, buf, 10);
+    strcat(logMsg, buf);
+    strcat_P(logMsg, PSTR(" steps"));
+    LogEvent(logMsg);
+}
+
+CTimebase Timebase;
+
+
+/**************************************
+ * Clock "sensor"
+ * Logs the UTC of each record (date and second of day, whole
+ * numbers so AVR floats don't round off the msec) and the rate
+ * correction. Unavailable (1970-01-01) until the GPS has given us
+ * the time.
+ **************************************/
+void CClockSensor::InitSensor()
+{
+    BasePeriodMsec = GPS_PERIOD_MSEC;
+}
+
+bool CClockSensor::ReadSensor()
+{
+    ErrMsg = "";
+    Values[CH_CLOCK_PPM] = Timebase.ClockPpb() / 1000.0;
+    return(Timebase.UtcMicros(Utc));
+}
+
+const ChannelDesc ClockChannels[3] PROGMEM =
+    {
+    {"UtcDate",  "",    CHT_CUSTOM, 8, 0, NO_RANGE},
+    {"UtcSec",   "s",   CHT_CUSTOM, 9, 3, NO_RANGE},
+    {"ClockPpm", "ppm", CHT_NUMBER, 8, 3, NO_RANGE},
+    };
+
+void CClockSensor::FormatCustom(int channel, char *buf)
+{
+    long days = (long)(Utc / USEC_PER_DAY);
+    long msec = (long)((Utc - (int64_t)days * USEC_PER_DAY) / 1000);
+    
+    if (channel == CH_CLOCK_DATE)
+        {
+        int y, m, d;
+        CivilFromDays(days, y, m, d);
+        sprintf_P(buf, PSTR("%04d%02d%02d"), y, m, d);
+        }
+    else
+        sprintf_P(buf, PSTR("%5ld.%03d"), msec / 1000, (int)(msec % 1000));
+}
+
+uint8_t CClockSensor::SampleQuality()
+{
+    if (!Timebase.Synced || !SensorAvailable)
+        return(QUAL_UNAVAILABLE);
+    return(QUAL_FRESH);
+}
@@ -0,0 +1,93 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <Arduino.h>
+
+/*********************************************
+ * CTimebase
+ *
+ * The flight clock. Counts micros() (no bus traffic) into a
+ * monotonic clock, and disciplines its rate against GPS time so
+ * samples from different streams - and from other payloads on the
+ * same flight - line up. FlightMsec() reads it.
+ *
+ * Each new GPS second (the NMEA time from CGPSSensor) is a sample:
+ * our UTC at that moment against the GPS UTC. The smallest offset
+ * in each half of a window is kept; the GPS is polled, so every
+ * sample is late by the time the sentence waited, and the smallest
+ * one waited least. The window is TB_WINDOW_MSEC, stretched when
+ * the sample period is too long for TB_MIN_SAMPLES per half. At the end of the window
+ *   - the change between the halves is the crystal's rate error
+ *     (ppb); a share of it is trimmed off the rate
+ *   - the offset left is slewed out over the next window, so the
+ *     clock never jumps or runs backwards
+ * Only the UTC is ever stepped: at the first fix, and if it is off
+ * by more than TB_STEP_USEC.
+ *
+ * With GPS_PPS_PIN wired (SystemParameters.h) the u-blox time pulse
+ * marks the top of each second in an interrupt, and the sample is
+ * taken at the pulse: sub-millisecond. Without it, UTC is as good
+ * as the shortest GPS poll delay.
+ *
+ * Until the first fix there is no UTC; the logger's RTC Timestamp
+ * column is the fallback. The Clock "sensor" (CClockSensor) puts the
+ * UTC date, second of day (msec resolution) and rate correction in
+ * each record.
+ */
+
+#define TB_WINDOW_MSEC      64000L      // shortest offset window
+#define TB_MIN_SAMPLES      4           // samples needed to trust a window
+#define TB_STEP_USEC        2000000L    // UTC further off than this is stepped
+#define TB_MAX_FREQ_PPB     5000000L    // crystal error we'll correct (5000 ppm)
+#define TB_MAX_SLEW_PPB     500000L     // fastest slew (500 ppm)
+#define TB_FREQ_SHARE       2           // 1/share of the offset goes into the rate
+#define TB_REPORT_MSEC      600000L     // log the discipline every 10 min
+
+class CTimebase
+{
+public:
+    CTimebase();
+
+    void Init();                    // PPS interrupt, if wired
+    uint64_t ClockUsec();           // monotonic, disciplined usec since boot
+    unsigned long Msec() { return((unsigned long)(ClockUsec() / 1000)); }
+    void GpsTime(uint16_t year, uint8_t month, uint8_t day,
+                 uint8_t hour, uint8_t minute, uint8_t second, uint8_t hundredths);
+    bool UtcMicros(int64_t &utc);   // usec since 1970; false until synced
+    void FormatUtc(char *buf);      // "2021-06-30T14:03:09.123", or blank
+    long ClockPpb() { return(FreqPpb); }
+    void Report();                  // log the discipline every TB_REPORT_MSEC
+
+    bool Synced;                    // have GPS time
+    long LastOffsetUsec;            // window's offset, + = we were ahead
+    unsigned int Steps;             // UTC steps since boot
+
+    volatile unsigned long PpsMicros;   // micros() at the last time pulse
+    volatile bool PpsSeen;
+
+private:
+    void Sample(uint64_t stampUsec, int64_t gpsUsec);
+    void StepTo(uint64_t stampUsec, int64_t gpsUsec);
+    void StartWindow(uint64_t stampUsec);
+
+    uint64_t Clock;                 // usec
+    unsigned long LastMicros;
+    long FreqPpb;                   // rate correction
+    long SlewPpb;                   // phase correction, this window
+    int64_t FracPpbUsec;            // correction not yet a whole usec (ppb * usec)
+    int64_t UtcBase;                // UTC (usec since 1970) at Clock = 0
+    uint64_t WindowStart;
+    long WindowMsec;                // this window, TB_WINDOW_MSEC or longer
+    long HalfMin[2];                // smallest offset in each half window (usec)
+    int  HalfSamples[2];
+    uint8_t LastSecond;             // GPS second last sampled
+    unsigned long ReportMsec;
+};
+
+extern CTimebase Timebase;
+
+// Civil dates to days since 1970-01-01 and back
+long DaysFromCivil(int y, int m, int d);
+void CivilFromDays(long z, int &y, int &m, int &d);
+
+#endif